@@ -0,0 +1,102 @@
+// Benchmark: serving templates from loose files vs. the zstd template pack.
+//
+// Usage: pack_bench <datadir> <pack> [iterations]
+// "cold" loose reads drop the file from the page cache with
+// posix_fadvise(DONTNEED) before every read, approximating slow storage.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/pack.h"
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int read_loose(const char *path, unsigned char *buffer, size_t size, int cold) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (cold) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    ssize_t n = read(fd, buffer, size);
+    close(fd);
+    return n == (ssize_t)size ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <datadir> <pack> [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *datadir = argv[1];
+    int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    if (iterations < 1) iterations = 1;
+
+    pack_t *pack = pack_open(argv[2]);
+    if (!pack) {
+        fprintf(stderr, "Cannot open pack: %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    struct stat pack_st;
+    stat(argv[2], &pack_st);
+
+    size_t count = pack_entry_count(pack);
+    size_t raw_total = 0;
+    double warm_ns = 0, cold_ns = 0, pack_ns = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const pack_entry_t *entry = pack_entry_at(pack, i);
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%s", datadir, entry->name);
+
+        unsigned char *buffer = malloc(entry->raw_size ? entry->raw_size : 1);
+        if (!buffer) return EXIT_FAILURE;
+        raw_total += entry->raw_size;
+
+        double t0 = now_ns();
+        for (int it = 0; it < iterations; it++) {
+            if (read_loose(path, buffer, entry->raw_size, 0) != 0) {
+                fprintf(stderr, "Cannot read %s\n", path);
+                return EXIT_FAILURE;
+            }
+        }
+        double t1 = now_ns();
+        for (int it = 0; it < iterations; it++) {
+            read_loose(path, buffer, entry->raw_size, 1);
+        }
+        double t2 = now_ns();
+        for (int it = 0; it < iterations; it++) {
+            if (pack_extract(pack, entry, buffer, entry->raw_size) != 0) {
+                fprintf(stderr, "Cannot extract %s\n", entry->name);
+                return EXIT_FAILURE;
+            }
+        }
+        double t3 = now_ns();
+
+        warm_ns += (t1 - t0) / iterations;
+        cold_ns += (t2 - t1) / iterations;
+        pack_ns += (t3 - t2) / iterations;
+        free(buffer);
+    }
+
+    printf("templates:          %zu\n", count);
+    printf("loose bytes:        %zu\n", raw_total);
+    printf("pack bytes:         %lld (%.1f%%)\n", (long long)pack_st.st_size,
+           raw_total ? 100.0 * (double)pack_st.st_size / (double)raw_total : 0.0);
+    printf("loose read (warm):  %.0f ns/set\n", warm_ns);
+    printf("loose read (cold):  %.0f ns/set\n", cold_ns);
+    printf("pack decompress:    %.0f ns/set\n", pack_ns);
+
+    pack_close(pack);
+    return EXIT_SUCCESS;
+}
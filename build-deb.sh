@@ -47,6 +47,9 @@ cp builddir/rpc "$PACKAGE_DIR/usr/bin/"
 echo "Installing template files..."
 cp -r .github/prompts/* "$PACKAGE_DIR/usr/share/$PACKAGE_NAME/.github/prompts/"
 cp -r .github/instructions/* "$PACKAGE_DIR/usr/share/$PACKAGE_NAME/.github/instructions/"
+if [ -f "builddir/templates.pack" ]; then
+    cp builddir/templates.pack "$PACKAGE_DIR/usr/share/$PACKAGE_NAME/"
+fi
 if [ -d ".github/responses" ]; then
     cp -r .github/responses/* "$PACKAGE_DIR/usr/share/$PACKAGE_NAME/.github/responses/" 2>/dev/null || true
 fi
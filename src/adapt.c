@@ -0,0 +1,285 @@
+// For clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "adapt.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+// Latency histogram: four buckets per power of two of microseconds
+#define ADAPT_BUCKETS 160
+
+// Decisions kept for the report
+#define ADAPT_HISTORY 256
+
+// Operations an interval needs before it is judged
+#define ADAPT_MIN_SAMPLES 8
+
+struct adapt {
+    pthread_mutex_t lock;
+    pthread_cond_t slot;  // signalled when a slot frees up or the limit grows
+    int min;
+    int max;
+    int start;
+    int limit;
+    int low;
+    int peak;
+    int in_flight;
+
+    // The interval being measured
+    long long interval_ns;
+    unsigned long long interval_ops;
+    unsigned long long interval_bytes;
+    double interval_cost;  // summed latency per unit, ms
+    int saturated;         // every slot was in use at some point
+
+    double baseline;       // lowest interval cost, aged towards recent ones
+    double last_rate;      // units per second of the previous interval
+    int raised;            // the previous interval added a slot
+
+    long long first_ns;
+    long long last_ns;
+    unsigned long long ops;
+    unsigned long long bytes;
+    unsigned long long histogram[ADAPT_BUCKETS];
+    size_t increases;
+    size_t decreases;
+    adapt_decision_t history[ADAPT_HISTORY]; // ring
+    size_t decision_count;
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int latency_bucket(unsigned long long us) {
+    if (us < 4) {
+        return (int)us;
+    }
+    int exponent = 63 - __builtin_clzll(us);
+    int bucket = 4 * (exponent - 1) + (int)((us >> (exponent - 2)) & 3);
+    return bucket < ADAPT_BUCKETS ? bucket : ADAPT_BUCKETS - 1;
+}
+
+// Lower bound of a bucket, in microseconds
+static double bucket_us(int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    return (double)((4ULL + (unsigned)(bucket % 4)) << (bucket / 4 - 1));
+}
+
+adapt_t *adapt_new(int min, int max, int start) {
+    if (min < 1) min = 1;
+    if (max < min) max = min;
+    if (start < min) start = min;
+    if (start > max) start = max;
+
+    adapt_t *adapt = calloc(1, sizeof(*adapt));
+    if (!adapt) return NULL;
+    pthread_mutex_init(&adapt->lock, NULL);
+    pthread_cond_init(&adapt->slot, NULL);
+    adapt->min = min;
+    adapt->max = max;
+    adapt->start = start;
+    adapt->limit = start;
+    adapt->low = start;
+    adapt->peak = start;
+    return adapt;
+}
+
+void adapt_free(adapt_t *adapt) {
+    if (!adapt) return;
+    pthread_mutex_destroy(&adapt->lock);
+    pthread_cond_destroy(&adapt->slot);
+    free(adapt);
+}
+
+void adapt_acquire(adapt_t *adapt) {
+    if (!adapt) {
+        return;
+    }
+    pthread_mutex_lock(&adapt->lock);
+    while (adapt->in_flight >= adapt->limit) {
+        adapt->saturated = 1;
+        pthread_cond_wait(&adapt->slot, &adapt->lock);
+    }
+    if (++adapt->in_flight >= adapt->limit) {
+        adapt->saturated = 1;
+    }
+    if (adapt->first_ns == 0) {
+        adapt->first_ns = now_ns();
+        adapt->interval_ns = adapt->first_ns;
+    }
+    pthread_mutex_unlock(&adapt->lock);
+}
+
+static void record(adapt_t *adapt, long long now, int to, double cost, double rate_ops, double rate_bytes,
+                   const char *reason) {
+    adapt_decision_t *decision = &adapt->history[adapt->decision_count++ % ADAPT_HISTORY];
+    *decision = (adapt_decision_t){
+        .at_ms = (double)(now - adapt->first_ns) / 1e6,
+        .from = adapt->limit,
+        .to = to,
+        .cost_ms = cost,
+        .baseline_ms = adapt->baseline,
+        .ops_per_sec = rate_ops,
+        .bytes_per_sec = rate_bytes,
+        .reason = reason,
+    };
+    if (to > adapt->limit) {
+        adapt->increases++;
+        pthread_cond_broadcast(&adapt->slot);
+    } else {
+        adapt->decreases++;
+    }
+    adapt->limit = to;
+    if (to < adapt->low) adapt->low = to;
+    if (to > adapt->peak) adapt->peak = to;
+}
+
+// Judges a finished interval: additive increase while latency holds and the
+// limit is what bounds the workers, multiplicative decrease when it doesn't
+static void evaluate(adapt_t *adapt, long long now) {
+    double seconds = (double)(now - adapt->interval_ns) / 1e9;
+    double cost = adapt->interval_cost / (double)adapt->interval_ops;
+    double units = (double)adapt->interval_ops + (double)adapt->interval_bytes / ADAPT_UNIT_BYTES;
+    double rate = units / seconds;
+    double rate_ops = (double)adapt->interval_ops / seconds;
+    double rate_bytes = (double)adapt->interval_bytes / seconds;
+
+    int to = adapt->limit;
+    const char *reason = NULL;
+    int cut = adapt->limit * 3 / 4 < adapt->limit - 1 ? adapt->limit * 3 / 4 : adapt->limit - 1;
+    if (adapt->baseline > 0 && cost > adapt->baseline * ADAPT_TOLERANCE) {
+        to = cut;
+        reason = "latency above tolerance";
+    } else if (adapt->raised && rate < adapt->last_rate * 0.9) {
+        to = cut;
+        reason = "throughput fell after increase";
+    } else if (adapt->saturated) {
+        to = adapt->limit + 1;
+        reason = "latency within tolerance";
+    }
+    if (to < adapt->min) to = adapt->min;
+    if (to > adapt->max) to = adapt->max;
+    adapt->raised = to > adapt->limit;
+    if (to != adapt->limit) {
+        record(adapt, now, to, cost, rate_ops, rate_bytes, reason);
+    }
+
+    // A new device or load is learned within a few dozen intervals
+    if (adapt->baseline == 0 || cost < adapt->baseline) {
+        adapt->baseline = cost;
+    } else {
+        adapt->baseline += (cost - adapt->baseline) / 32;
+    }
+    adapt->last_rate = rate;
+
+    adapt->interval_ns = now;
+    adapt->interval_ops = 0;
+    adapt->interval_bytes = 0;
+    adapt->interval_cost = 0;
+    adapt->saturated = adapt->in_flight >= adapt->limit;
+}
+
+void adapt_release(adapt_t *adapt, long long ns, long long bytes) {
+    if (!adapt) {
+        return;
+    }
+    if (ns < 0) ns = 0;
+    if (bytes < 0) bytes = 0;
+    long long now = now_ns();
+    double ms = (double)ns / 1e6;
+
+    pthread_mutex_lock(&adapt->lock);
+    adapt->in_flight--;
+    adapt->last_ns = now;
+    adapt->ops++;
+    adapt->bytes += (unsigned long long)bytes;
+    adapt->histogram[latency_bucket((unsigned long long)ns / 1000)]++;
+    adapt->interval_ops++;
+    adapt->interval_bytes += (unsigned long long)bytes;
+    adapt->interval_cost += ms / (1.0 + (double)bytes / ADAPT_UNIT_BYTES);
+
+    if (now - adapt->interval_ns >= ADAPT_INTERVAL_MS * 1000000LL && adapt->interval_ops >= ADAPT_MIN_SAMPLES) {
+        if (adapt->min < adapt->max) {
+            evaluate(adapt, now);
+        } else {
+            adapt->interval_ns = now;
+            adapt->interval_ops = 0;
+            adapt->interval_bytes = 0;
+            adapt->interval_cost = 0;
+        }
+    }
+    pthread_cond_signal(&adapt->slot);
+    pthread_mutex_unlock(&adapt->lock);
+}
+
+int adapt_adaptive(const adapt_t *adapt) {
+    return adapt && adapt->min < adapt->max;
+}
+
+static double percentile_ms(const adapt_t *adapt, double fraction) {
+    unsigned long long target = (unsigned long long)((double)adapt->ops * fraction);
+    unsigned long long seen = 0;
+    for (int i = 0; i < ADAPT_BUCKETS; i++) {
+        seen += adapt->histogram[i];
+        if (seen > target) {
+            return bucket_us(i) / 1000.0;
+        }
+    }
+    return 0;
+}
+
+void adapt_stats(adapt_t *adapt, adapt_stats_t *stats) {
+    pthread_mutex_lock(&adapt->lock);
+    *stats = (adapt_stats_t){
+        .min = adapt->min,
+        .max = adapt->max,
+        .start = adapt->start,
+        .limit = adapt->limit,
+        .low = adapt->low,
+        .peak = adapt->peak,
+        .ops = adapt->ops,
+        .bytes = adapt->bytes,
+        .ms = (double)(adapt->last_ns - adapt->first_ns) / 1e6,
+        .p50_ms = percentile_ms(adapt, 0.50),
+        .p90_ms = percentile_ms(adapt, 0.90),
+        .p99_ms = percentile_ms(adapt, 0.99),
+        .increases = adapt->increases,
+        .decreases = adapt->decreases,
+    };
+    pthread_mutex_unlock(&adapt->lock);
+}
+
+size_t adapt_decisions(adapt_t *adapt, adapt_decision_t *out, size_t max) {
+    pthread_mutex_lock(&adapt->lock);
+    size_t kept = adapt->decision_count < ADAPT_HISTORY ? adapt->decision_count : ADAPT_HISTORY;
+    size_t count = kept < max ? kept : max;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = adapt->history[(adapt->decision_count - count + i) % ADAPT_HISTORY];
+    }
+    pthread_mutex_unlock(&adapt->lock);
+    return count;
+}
+
+int adapt_parse_bounds(const char *text, int *min, int *max) {
+    char *end;
+    errno = 0;
+    long low = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != ':') {
+        return -1;
+    }
+    const char *rest = end + 1;
+    long high = strtol(rest, &end, 10);
+    if (errno != 0 || end == rest || *end != '\0' || low < 1 || high < low || high > 1024) {
+        return -1;
+    }
+    *min = (int)low;
+    *max = (int)high;
+    return 0;
+}
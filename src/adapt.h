@@ -0,0 +1,74 @@
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include <stddef.h>
+
+// Adaptive concurrency for copy workers (--adaptive). Every file copy takes
+// an in-flight slot first, and the number of slots follows an AIMD rule:
+// every ADAPT_INTERVAL_MS the controller compares the interval's latency per
+// operation (scaled by size, per ADAPT_UNIT_BYTES) with the lowest it has
+// seen. Within ADAPT_TOLERANCE of it, and with every slot in use, one slot is
+// added; above it, or when throughput dropped after the last increase, the
+// limit is cut to three quarters. The pool runs at the upper bound and
+// workers beyond the limit wait for a slot.
+//
+// With min == max nothing is adjusted and the controller only measures, which
+// is what --stats reports for a fixed --jobs.
+
+#define ADAPT_INTERVAL_MS 100
+#define ADAPT_UNIT_BYTES (64 * 1024)
+#define ADAPT_TOLERANCE 2.0
+
+typedef struct adapt adapt_t;
+
+// A change of the limit and the interval that caused it
+typedef struct {
+    double at_ms;         // since the first operation
+    int from;
+    int to;
+    double cost_ms;       // mean latency per operation and ADAPT_UNIT_BYTES
+    double baseline_ms;   // the lowest cost seen before this interval
+    double ops_per_sec;
+    double bytes_per_sec;
+    const char *reason;
+} adapt_decision_t;
+
+typedef struct {
+    int min;
+    int max;
+    int start;
+    int limit;            // at the end
+    int low;              // lowest limit reached
+    int peak;             // highest limit reached
+    unsigned long long ops;
+    unsigned long long bytes;
+    double ms;            // first operation to last
+    double p50_ms;        // latency percentiles over all operations
+    double p90_ms;
+    double p99_ms;
+    size_t increases;
+    size_t decreases;
+} adapt_stats_t;
+
+// start is clamped to [min, max]. Returns NULL on allocation failure.
+adapt_t *adapt_new(int min, int max, int start);
+void adapt_free(adapt_t *adapt);
+
+// Waits for an in-flight slot. NULL is unlimited.
+void adapt_acquire(adapt_t *adapt);
+
+// Returns the slot of an operation that took ns and moved bytes, and
+// re-evaluates the limit once an interval is complete
+void adapt_release(adapt_t *adapt, long long ns, long long bytes);
+
+int adapt_adaptive(const adapt_t *adapt);
+void adapt_stats(adapt_t *adapt, adapt_stats_t *stats);
+
+// Copies up to max of the most recent decisions, oldest first, and returns
+// how many were copied; older ones are only counted in adapt_stats()
+size_t adapt_decisions(adapt_t *adapt, adapt_decision_t *out, size_t max);
+
+// Parses "MIN:MAX" bounds for --adaptive
+int adapt_parse_bounds(const char *text, int *min, int *max);
+
+#endif // ADAPT_H
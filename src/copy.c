@@ -1,655 +1,1833 @@
+// For openat()/mkdirat() and the *at() family used by the tree walker
+#define _GNU_SOURCE
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 #include "copy.h"
 #include "cli_utils.h"
+#include "journal.h"
+#include "pack.h"
+#include "perf.h"
+#include "prefetch.h"
+#include "render.h"
+#include "roots.h"
+#include "transform.h"
+#include "walk.h"
+#include "plan.h"
+#include "pool.h"
+#include "store.h"
+#include "strategy.h"
+#include "templates.h"
+#include "throttle.h"
 
 #ifndef REPLICA_DATADIR
 #warning "REPLICA_DATADIR is not defined. Using a default relative path for local development."
 #define REPLICA_DATADIR "." // Fallback for local development (assumes running from project root)
 #endif
 
-static void construct_source_path(char *path_buffer, size_t buffer_size, const char *sub_path) {
+#ifndef REPLICA_VERSION
+#define REPLICA_VERSION "dev"
+#endif
+
+void construct_source_path(char *path_buffer, size_t buffer_size, const char *sub_path) {
     snprintf(path_buffer, buffer_size, "%s%s", REPLICA_DATADIR, sub_path);
 }
 
-int copy_file(const char *src_full_path, const char *dest_dir) {
-    struct stat st = {0};
-    if (stat(dest_dir, &st) == -1) {
-        if (mkdir(dest_dir, 0755) != 0) {
-            perror("Error creating destination directory");
-            return -1;
-        }
+static copy_options_t copy_options;
+
+// Set from signal handlers; lock-free, so async-signal-safe
+static atomic_int cancel_requested;
+
+void copy_cancel(void) {
+    atomic_store(&cancel_requested, 1);
+}
+
+int copy_cancelled(void) {
+    return atomic_load_explicit(&cancel_requested, memory_order_relaxed);
+}
+
+void copy_set_options(const copy_options_t *options) {
+    copy_options = *options;
+}
+
+static pack_t *options_pack(const copy_options_t *options) {
+    return options->pack ? options->pack : pack_default();
+}
+
+static const pack_entry_t *find_packed(const copy_options_t *options, const char *src_full_path) {
+    size_t datadir_len = strlen(REPLICA_DATADIR);
+    if (strncmp(src_full_path, REPLICA_DATADIR, datadir_len) != 0) {
+        return NULL;
     }
+    return pack_find(options_pack(options), src_full_path + datadir_len);
+}
 
-    const char *filename_ptr = strrchr(src_full_path, '/');
-    if (filename_ptr != NULL) {
-        filename_ptr++;
-    } else {
-        filename_ptr = src_full_path; // No '/' found, so src_full_path is just the filename
+// Serializes writers of one file across processes. OFD locks belong to the
+// open file description, so threads of one process exclude each other too;
+// flock() covers kernels without them.
+static int lock_destination(int fd) {
+    struct flock lock = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    while (fcntl(fd, F_OFD_SETLKW, &lock) != 0) {
+        if (errno == EINVAL) {
+            while (flock(fd, LOCK_EX) != 0) {
+                if (errno != EINTR) return -1;
+            }
+            return 0;
+        }
+        if (errno != EINTR) return -1;
     }
+    return 0;
+}
 
-    char dest_full_path[1024];
-    // Ensure dest_dir is not empty and handle potential trailing slash if necessary
-    if (dest_dir == NULL || dest_dir[0] == '\0') {
-        snprintf(dest_full_path, sizeof(dest_full_path), "%s", filename_ptr);
-    } else {
-        snprintf(dest_full_path, sizeof(dest_full_path), "%s/%s", dest_dir, filename_ptr);
+// Opens a destination for rewriting. Truncation happens under the file's
+// lock, which is held until the caller closes it, so concurrent installs to
+// the same path write one after another instead of interleaving.
+static int open_destination(const char *dest_full_path) {
+    int fd = open(dest_full_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("Error opening destination file (open)");
+        fprintf(stderr, "Failed to open for writing: %s\n", dest_full_path);
+        return -1;
+    }
+    if (lock_destination(fd) != 0 || ftruncate(fd, 0) != 0) {
+        perror("Error locking destination file");
+        fprintf(stderr, "Failed to lock for writing: %s\n", dest_full_path);
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
+// Serves a datadir file from the template pack when one is installed.
+// Returns 1 when the file is not packed and the caller should read it from disk.
+static int copy_from_pack(const copy_options_t *options, const char *src_full_path, const char *dest_full_path) {
+    const pack_entry_t *entry = find_packed(options, src_full_path);
+    if (!entry) {
+        return 1;
+    }
 
-    FILE *source = fopen(src_full_path, "rb");
-    if (!source) {
-        perror("Error opening source file (fopen)");
-        fprintf(stderr, "Failed to open: %s\n", src_full_path);
+    int fd = open_destination(dest_full_path);
+    if (fd < 0) {
         return -1;
     }
 
-    FILE *destination_file = fopen(dest_full_path, "wb");
-    if (!destination_file) {
-        perror("Error opening destination file (fopen)");
-        fprintf(stderr, "Failed to open for writing: %s\n", dest_full_path);
-        fclose(source);
-        return -1;
+    throttle_acquire(options->throttle, entry->raw_size, 1);
+    int result = pack_extract_to_fd(options_pack(options), entry, fd);
+    if (result != 0) {
+        perror("Error writing to destination file (pack)");
+    }
+    if (close(fd) != 0) {
+        perror("Error closing destination file");
+        result = -1;
     }
+    return result;
+}
 
-    char buffer[1024];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), source)) > 0) {
-        if (fwrite(buffer, 1, bytes_read, destination_file) != bytes_read) {
-            perror("Error writing to destination file (fwrite)");
-            fclose(source);
-            fclose(destination_file);
+static int write_all(int fd, const char *buffer, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t w = offset < 0 ? write(fd, buffer + done, size - done)
+                               : pwrite(fd, buffer + done, size - done, offset + (off_t)done);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("Error writing to destination file (write)");
             return -1;
         }
+        done += (size_t)w;
     }
+    return 0;
+}
 
-    if (ferror(source)) {
-        perror("Error reading from source file (ferror)");
-        fclose(source);
-        fclose(destination_file);
-        return -1; // Indicate read error
+// A template's bytes in memory: extracted from the pack, or a mapped file
+typedef struct {
+    const char *data;
+    size_t size;
+    char *buffer;
+    void *map;
+} source_view_t;
+
+// Returns 1 when the source is empty or can't be mapped, so the caller
+// keeps the plain copy path
+static int view_source(const copy_options_t *options, const char *src_full_path, const pack_entry_t *entry,
+                       source_view_t *view) {
+    *view = (source_view_t){0};
+    if (entry) {
+        view->size = entry->raw_size;
+        view->buffer = malloc(view->size ? view->size : 1);
+        if (!view->buffer || pack_extract(options_pack(options), entry, view->buffer, view->size) != 0) {
+            fprintf(stderr, "Failed to extract: %s\n", src_full_path);
+            free(view->buffer);
+            return -1;
+        }
+        view->data = view->buffer;
+        return 0;
     }
 
-    fclose(source);
-    fclose(destination_file);
-    
-    char success_msg[512];
-    snprintf(success_msg, sizeof(success_msg), "Copied '%s'", strrchr(src_full_path, '/') ? strrchr(src_full_path, '/') + 1 : src_full_path);
-    cli_print_step(success_msg);
-    
+    int in = open(src_full_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (in < 0 || fstat(in, &st) != 0) {
+        perror("Error opening source file (open)");
+        fprintf(stderr, "Failed to open: %s\n", src_full_path);
+        if (in >= 0) close(in);
+        return -1;
+    }
+    view->size = (size_t)st.st_size;
+    if (view->size == 0) {
+        close(in);
+        return 1;
+    }
+    view->map = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, in, 0);
+    close(in);
+    if (view->map == MAP_FAILED) {
+        view->map = NULL;
+        return 1;
+    }
+    view->data = view->map;
     return 0;
 }
 
-int copy_directory(const char *src, const char *dest) {
-    DIR *dir = opendir(src);
-    if (!dir) {
-        perror("Error opening source directory");
-        return -1;
+static void release_source(source_view_t *view) {
+    if (view->map) munmap(view->map, view->size);
+    free(view->buffer);
+}
+
+static void report_invalid_text(const char *src_full_path, const char *dest_full_path) {
+    fprintf(stderr, "Not valid UTF-8, not copied: %s\n", src_full_path);
+    unlink(dest_full_path);
+    errno = EILSEQ;
+}
+
+// Copies while substituting {{key}} placeholders. Returns 1 when the source
+// has no placeholders, so the caller keeps the plain copy path.
+static int copy_rendered(const copy_options_t *options, const char *src_full_path, const char *dest_full_path) {
+    const pack_entry_t *entry = find_packed(options, src_full_path);
+    if (entry && !(entry->flags & PACK_F_PLACEHOLDERS)) {
+        return 1;
+    }
+    source_view_t view;
+    int loaded = view_source(options, src_full_path, entry, &view);
+    if (loaded != 0) {
+        return loaded;
+    }
+    if (!entry && !render_has_placeholders(view.data, view.size)) {
+        release_source(&view);
+        return 1;
     }
 
-    struct stat st_dest = {0};
-    if (stat(dest, &st_dest) == -1) {
-        if (mkdir(dest, 0755) != 0 && errno != EEXIST) { // Create it, ignore if it already exists
-            perror("Error creating destination directory");
-            closedir(dir);
-            return -1;
+    // Line endings and the BOM are fixed before rendering, so values
+    // substituted from the command line are left as given
+    const char *data = view.data;
+    size_t size = view.size;
+    char *transformed = NULL;
+    size_t clean;
+    int scan = options->transform ? transform_scan(options->transform, data, size, &clean) : 1;
+    if (scan == 0) {
+        transformed = transform_to_buffer(options->transform, data, size, clean, &size);
+        data = transformed;
+    }
+    if (scan < 0 || (scan == 0 && !transformed)) {
+        if (errno == EILSEQ) {
+            report_invalid_text(src_full_path, dest_full_path);
         }
+        release_source(&view);
+        return -1;
     }
 
-
-    struct dirent *entry;
-    int result = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
-            char src_path_item[1024];
-            char dest_path_item[1024];
-            snprintf(src_path_item, sizeof(src_path_item), "%s/%s", src, entry->d_name);
-            snprintf(dest_path_item, sizeof(dest_path_item), "%s/%s", dest, entry->d_name);
-
-            struct stat entry_stat;
-            if (stat(src_path_item, &entry_stat) == 0) {
-                if (S_ISDIR(entry_stat.st_mode)) {
-                    if (copy_directory(src_path_item, dest_path_item) != 0)
-                        result = -1; // Propagate error
-                } else {
-                    if (copy_file(src_path_item, dest) != 0) { // Pass 'dest' as the target directory
-                        result = -1; // Propagate error
-                    }
-                }
-            } else {
-                perror("Error getting stat for source item");
-                result = -1; // Error stating item
-            }
+    int result = -1;
+    int out = open_destination(dest_full_path);
+    if (out >= 0) {
+        throttle_acquire(options->throttle, size, 1);
+        perf_phase_t phase = perf_enter(PERF_PHASE_RENDER);
+        result = render_to_fd(out, data, size, options->vars);
+        perf_leave(phase);
+        if (result != 0) {
+            perror("Error writing to destination file (writev)");
+        }
+        if (close(out) != 0) {
+            perror("Error closing destination file");
+            result = -1;
         }
     }
 
-    closedir(dir);
+    free(transformed);
+    release_source(&view);
     return result;
 }
 
+// Converts line endings and the BOM and checks UTF-8 while copying.
+// Returns 1 when the file comes out unchanged, so the caller keeps the
+// plain (zero-copy) path.
+static int copy_transformed(const copy_options_t *options, const char *src_full_path, const char *dest_full_path) {
+    const transform_t *transform = options->transform;
+    if (!transform || transform_is_identity(transform)) {
+        return 1;
+    }
+    const pack_entry_t *entry = find_packed(options, src_full_path);
+    source_view_t view;
+    int loaded = view_source(options, src_full_path, entry, &view);
+    if (loaded != 0) {
+        return loaded;
+    }
 
-static int create_directories(const char *path) {
-    char temp_path[1024];
-    char *p = NULL;
-    size_t len;
-
-    snprintf(temp_path, sizeof(temp_path), "%s", path);
-    len = strlen(temp_path);
-    if (temp_path[len - 1] == '/') {
-        temp_path[len - 1] = 0;
+    size_t clean;
+    int scan = transform_scan(transform, view.data, view.size, &clean);
+    if (scan < 0) {
+        report_invalid_text(src_full_path, dest_full_path);
+        release_source(&view);
+        return -1;
+    }
+    // An unchanged packed file is already extracted; write that instead
+    if (scan == 1 && !entry) {
+        release_source(&view);
+        return 1;
     }
 
-    for (p = temp_path + 1; *p; p++) {
-        if (*p == '/') {
-            *p = 0;
-            if (mkdir(temp_path, 0755) != 0 && errno != EEXIST) {
-                return -1;
-            }
-            *p = '/';
+    int result = -1;
+    int out = open_destination(dest_full_path);
+    if (out >= 0) {
+        throttle_acquire(options->throttle, view.size, 1);
+        result = scan == 1 ? write_all(out, view.data, view.size, -1)
+                           : transform_write(out, transform, view.data, view.size, clean);
+        int error = errno;
+        if (close(out) != 0) {
+            perror("Error closing destination file");
+            result = -1;
+        } else if (result != 0 && error == EILSEQ) {
+            report_invalid_text(src_full_path, dest_full_path);
+        } else if (result != 0) {
+            errno = error;
+            perror("Error writing to destination file (transform)");
         }
     }
-    if (mkdir(temp_path, 0755) != 0 && errno != EEXIST) {
-        return -1;
-    }
-    return 0;
+    release_source(&view);
+    return result;
 }
 
-int copy_readme(const char *dest) {
-    // Create .github/prompts/ directory
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+// --no-cache: files at least this large are written back in windows and
+// dropped from the page cache once on disk, so bulk copies don't evict the
+// working set of everything else on the host. Smaller files keep the
+// normal path.
+#define COPY_NO_CACHE_MIN (8 * 1024 * 1024)
+#define COPY_NO_CACHE_WINDOW (8 * 1024 * 1024)
+
+// Starts writeback of [start, end), then waits for the previous window
+// [done, start), whose writeback is already under way, and drops it from the
+// cache of both files
+static void writeback_window(int in, int out, off_t done, off_t start, off_t end) {
+    if (end > start) {
+        sync_file_range(out, start, end - start, SYNC_FILE_RANGE_WRITE);
     }
-
-    // Create .github/instructions/ directory  
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    if (start > done) {
+        sync_file_range(out, done, start - done,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(out, done, start - done, POSIX_FADV_DONTNEED);
+        posix_fadvise(in, done, start - done, POSIX_FADV_DONTNEED);
     }
-
-    // Copy files to their respective directories
-    char src_path[1024];
-    char dest_path[1024];
-    
-    // Copy prompt file
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/generate-readme.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/generate-readme.prompt.md", dest);
-    
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    // Copy instructions file
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/readme.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/readme.instructions.md", dest);
-    
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
 }
 
-int copy_release_notes(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
-    }
+// Copies [start, end) with positional I/O, or to EOF when end is negative
+static int copy_range(int in, int out, off_t start, off_t end, int no_cache, throttle_t *throttle) {
+    char buffer[64 * 1024];
+    off_t pos = start;
+    off_t done = start;   // no_cache: written back and dropped
+    off_t window = start; // no_cache: writeback started
+    while (end < 0 || pos < end) {
+        if (copy_cancelled()) {
+            errno = ECANCELED;
+            return -1;
+        }
+        size_t want = sizeof(buffer);
+        if (end >= 0 && (off_t)want > end - pos) {
+            want = (size_t)(end - pos);
+        }
+        throttle_acquire(throttle, want, 2);
+        ssize_t n = pread(in, buffer, want, pos);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error reading from source file (read)");
+            return -1;
+        }
+        if (write_all(out, buffer, (size_t)n, pos) != 0) {
+            return -1;
+        }
+        pos += n;
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+        if (no_cache && pos - window >= COPY_NO_CACHE_WINDOW) {
+            writeback_window(in, out, done, window, pos);
+            done = window;
+            window = pos;
+        }
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/generate-release-notes.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/generate-release-notes.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/release-notes.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/release-notes.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    if (no_cache) {
+        writeback_window(in, out, done, pos, pos);
+    }
+    return 0;
 }
 
-int copy_post(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+// Walks the data extents with SEEK_DATA/SEEK_HOLE and copies only those, so
+// the cost follows the allocated size instead of the apparent size
+static int copy_sparse(int in, int out, off_t size, int no_cache, throttle_t *throttle) {
+    // Only a destination that already has blocks (e.g. preallocated) needs
+    // its holes punched; a freshly truncated file is all hole already
+    struct stat out_st;
+    int punch = fstat(out, &out_st) == 0 && out_st.st_blocks > 0;
+
+    off_t pos = 0;
+    while (pos < size) {
+        off_t data = lseek(in, pos, SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) {
+                data = size; // Only a trailing hole is left
+            } else {
+                return copy_range(in, out, pos, -1, no_cache, throttle); // No SEEK_DATA support here
+            }
+        }
+        if (punch && data > pos) {
+            fallocate(out, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos, data - pos);
+        }
+        if (data >= size) {
+            break;
+        }
+
+        off_t hole = lseek(in, data, SEEK_HOLE);
+        if (hole < 0) {
+            hole = size;
+        }
+        if (copy_range(in, out, data, hole, no_cache, throttle) != 0) {
+            return -1;
+        }
+        pos = hole;
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
+    if (ftruncate(out, size) != 0) {
+        perror("Error extending destination file (ftruncate)");
         return -1;
     }
-
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/generate-linkedin.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/generate-linkedin.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/linkedin.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/linkedin.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    return 0;
 }
 
-int copy_contributing(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
+// Reads a small file in one call and writes it in one more
+static int copy_buffer(int in, int out, off_t size, throttle_t *throttle) {
+    throttle_acquire(throttle, (size_t)size, 2);
+    char stack_buffer[64 * 1024];
+    char *buffer = size <= (off_t)sizeof(stack_buffer) ? stack_buffer : malloc((size_t)size);
+    if (!buffer) {
+        perror("Error allocating copy buffer");
         return -1;
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    off_t pos = 0;
+    int result = 0;
+    while (pos < size) {
+        ssize_t n = pread(in, buffer + pos, (size_t)(size - pos), pos);
+        if (n == 0) {
+            break; // Shrunk since fstat
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error reading from source file (read)");
+            result = -1;
+            break;
+        }
+        pos += n;
+    }
+    if (result == 0 && pos > 0) {
+        result = write_all(out, buffer, (size_t)pos, 0);
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/CONTRIBUTING.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/CONTRIBUTING.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/CONTRIBUTING.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/CONTRIBUTING.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    if (buffer != stack_buffer) {
+        free(buffer);
+    }
+    return result;
 }
 
-int copy_license_template(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+// errno values meaning a primitive isn't available for this pair of files,
+// rather than that the copy failed
+static int unsupported_errno(int error) {
+    return error == EOPNOTSUPP || error == ENOTSUP || error == EXDEV || error == EINVAL ||
+           error == ENOSYS || error == ENOTTY;
+}
+
+// Shares the source's extents with the destination. Returns 1 when the
+// filesystems can't clone.
+static int copy_reflink(int in, int out) {
+    if (ioctl(out, FICLONE, in) == 0) {
+        return 0;
     }
+    if (unsupported_errno(errno)) {
+        return 1;
+    }
+    perror("Error cloning source file (FICLONE)");
+    return -1;
+}
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+// Copies in the kernel with copy_file_range, or sendfile when range is 0.
+// Returns 1 when the primitive is refused before anything was written.
+static int copy_kernel(int in, int out, off_t size, int range) {
+    off_t pos = 0;
+    while (pos < size) {
+        if (copy_cancelled()) {
+            errno = ECANCELED;
+            return -1;
+        }
+        size_t want = size - pos > (off_t)(1 << 30) ? (size_t)(1 << 30) : (size_t)(size - pos);
+        off_t in_pos = pos;
+        off_t out_pos = pos;
+        ssize_t n = range ? copy_file_range(in, &in_pos, out, &out_pos, want, 0)
+                          : sendfile(out, in, &in_pos, want);
+        if (n == 0) {
+            break; // Shrunk since fstat
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (pos == 0 && unsupported_errno(errno)) {
+                return 1;
+            }
+            perror(range ? "Error copying file data (copy_file_range)" : "Error copying file data (sendfile)");
+            return -1;
+        }
+        pos += n;
     }
+    return 0;
+}
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/LICENSE.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/LICENSE.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/LICENSE.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/LICENSE.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+// Writes straight from a read-only mapping of the source. Returns 1 when the
+// source can't be mapped.
+static int copy_mmap(int in, int out, off_t size) {
+    void *map = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, in, 0);
+    if (map == MAP_FAILED) {
+        return 1;
+    }
+    madvise(map, (size_t)size, MADV_SEQUENTIAL);
+    int result = write_all(out, map, (size_t)size, 0);
+    munmap(map, (size_t)size);
+    return result;
 }
 
-int copy_security(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+#define COPY_DIRECT_ALIGN 4096
+#define COPY_DIRECT_CHUNK (1024 * 1024)
+
+// Copies the block-aligned bulk of the file with O_DIRECT on both ends and
+// the unaligned tail through the page cache, which --no-cache then drops.
+// Returns 1 when either filesystem refuses O_DIRECT.
+static int copy_direct(int in, int out, off_t size, throttle_t *throttle) {
+    int in_flags = fcntl(in, F_GETFL);
+    int out_flags = fcntl(out, F_GETFL);
+    if (in_flags < 0 || out_flags < 0 || fcntl(in, F_SETFL, in_flags | O_DIRECT) != 0) {
+        return 1;
+    }
+    if (fcntl(out, F_SETFL, out_flags | O_DIRECT) != 0) {
+        fcntl(in, F_SETFL, in_flags);
+        return 1;
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    void *buffer = NULL;
+    int result = posix_memalign(&buffer, COPY_DIRECT_ALIGN, COPY_DIRECT_CHUNK) == 0 ? 0 : -1;
+    off_t aligned = size & ~(off_t)(COPY_DIRECT_ALIGN - 1);
+    off_t pos = 0;
+    while (result == 0 && pos < aligned) {
+        if (copy_cancelled()) {
+            errno = ECANCELED;
+            result = -1;
+            break;
+        }
+        size_t want = aligned - pos > COPY_DIRECT_CHUNK ? COPY_DIRECT_CHUNK : (size_t)(aligned - pos);
+        throttle_acquire(throttle, want, 2);
+        ssize_t n = pread(in, buffer, want, pos);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n >= 0) {
+            // A short read leaves the rest to the buffered tail
+            n &= ~(ssize_t)(COPY_DIRECT_ALIGN - 1);
+            if (n > 0 && pwrite(out, buffer, (size_t)n, pos) != n) {
+                n = -1;
+            }
+        }
+        if (n < 0) {
+            if (pos == 0 && errno == EINVAL) {
+                result = 1; // Alignment not accepted after all
+            } else {
+                perror("Error copying file data (O_DIRECT)");
+                result = -1;
+            }
+        } else if ((size_t)n < want) {
+            pos += n;
+            break;
+        } else {
+            pos += n;
+        }
     }
+    free(buffer);
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/SECURITY.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/SECURITY.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/SECURITY.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/SECURITY.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    fcntl(in, F_SETFL, in_flags);
+    fcntl(out, F_SETFL, out_flags);
+    if (result != 0) {
+        return result;
+    }
+    return copy_range(in, out, pos, -1, 1, throttle);
 }
 
-int copy_code_of_conduct(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+static unsigned strategy_cap(copy_strategy_t strategy) {
+    switch (strategy) {
+    case COPY_REFLINK: return STRATEGY_CAP_REFLINK;
+    case COPY_RANGE: return STRATEGY_CAP_RANGE;
+    case COPY_SENDFILE: return STRATEGY_CAP_SENDFILE;
+    case COPY_MMAP: return STRATEGY_CAP_MMAP;
+    case COPY_DIRECT: return STRATEGY_CAP_DIRECT;
+    default: return 0;
     }
+}
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+// --verbose: copy decisions go to stderr, one line per call so lines from
+// different workers don't mix
+static void trace(const copy_options_t *options, const char *format, ...) {
+    if (!options || !options->verbose) {
+        return;
     }
+    char line[2048];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(line, sizeof(line), format, ap);
+    va_end(ap);
+    fprintf(stderr, "[trace] %s\n", line);
+}
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/CODE_OF_CONDUCT.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/CODE_OF_CONDUCT.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/CODE_OF_CONDUCT.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/CODE_OF_CONDUCT.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+static void trace_probe(const copy_options_t *options, const strategy_pair_t *pair) {
+    unsigned caps = pair->caps;
+    trace(options, "probe %s -> %s: reflink %s, copy_file_range %s, sendfile %s, O_DIRECT %s, fallocate %s",
+          strategy_fs_name(pair->src_type), strategy_fs_name(pair->dest_type),
+          caps & STRATEGY_CAP_REFLINK ? "yes" : "no", caps & STRATEGY_CAP_RANGE ? "yes" : "no",
+          caps & STRATEGY_CAP_SENDFILE ? "yes" : "no", caps & STRATEGY_CAP_DIRECT ? "yes" : "no",
+          caps & STRATEGY_CAP_FALLOCATE ? "yes" : "no");
 }
 
-int copy_issue_template(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+// Reserves the whole output up front so large files are laid out in few
+// extents. Skipped for clones, for copy_file_range where the filesystem
+// may share extents instead of writing them, and for O_DIRECT, which ext4
+// turns back into buffered writes past EOF of a preallocated file.
+static void preallocate(const copy_options_t *options, strategy_pair_t *pair, copy_strategy_t strategy, int out, off_t size) {
+    if (size < STRATEGY_PREALLOC_MIN || !(pair->caps & STRATEGY_CAP_FALLOCATE) ||
+        strategy == COPY_REFLINK || strategy == COPY_SPARSE || strategy == COPY_DIRECT ||
+        (strategy == COPY_RANGE && pair->shares_extents)) {
+        return;
     }
-
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    if (fallocate(out, FALLOC_FL_KEEP_SIZE, 0, size) != 0 && unsupported_errno(errno)) {
+        strategy_forget(pair, STRATEGY_CAP_FALLOCATE);
+        trace(options, "fallocate unsupported on %s", strategy_fs_name(pair->dest_type));
     }
+}
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/ISSUE_TEMPLATE.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/ISSUE_TEMPLATE.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/ISSUE_TEMPLATE.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/ISSUE_TEMPLATE.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+static int run_strategy(copy_strategy_t strategy, int in, int out, const struct stat *st, int no_cache,
+                        throttle_t *throttle) {
+    switch (strategy) {
+    case COPY_BUFFER: return copy_buffer(in, out, st->st_size, throttle);
+    case COPY_STREAM: return copy_range(in, out, 0, -1, no_cache, throttle);
+    case COPY_SPARSE: return copy_sparse(in, out, st->st_size, no_cache, throttle);
+    case COPY_REFLINK:
+        throttle_acquire(throttle, 0, 1); // Shares extents; no data moves
+        return copy_reflink(in, out);
+    case COPY_RANGE: return copy_kernel(in, out, st->st_size, 1);
+    case COPY_SENDFILE: return copy_kernel(in, out, st->st_size, 0);
+    case COPY_MMAP: return copy_mmap(in, out, st->st_size);
+    case COPY_DIRECT: return copy_direct(in, out, st->st_size, throttle);
+    }
+    return -1;
 }
 
-int copy_pr_template(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+// Picks a strategy from the file's size and what the filesystem pair
+// supports. Small files are copied through a buffer without probing; a
+// primitive that turns out to be unsupported is dropped and the next choice
+// runs instead.
+static int copy_fd_data(const copy_options_t *options, int in, int out, const struct stat *st, const char *dest_full_path) {
+    int no_cache = options && options->no_cache && st->st_size >= COPY_NO_CACHE_MIN;
+    if (no_cache) {
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    if (!S_ISREG(st->st_mode)) {
+        return copy_range(in, out, 0, -1, no_cache, options ? options->throttle : NULL);
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    // Fewer allocated blocks than the apparent size means the file has holes
+    int sparse = st->st_size > 0 && (off_t)st->st_blocks * 512 < st->st_size;
+
+    strategy_pair_t pair;
+    strategy_pair_t *probed = NULL;
+    if (sparse || st->st_size > STRATEGY_BUFFER_MAX) {
+        int fresh = strategy_probe(in, out, st, &pair);
+        if (fresh >= 0) {
+            probed = &pair;
+        }
+        if (fresh > 0) {
+            trace_probe(options, &pair);
+        }
+        // Under I/O limits, data has to pass through the chunked loops that
+        // take from the buckets; kernel-side copies would move it in one call
+        if (fresh >= 0 && options && options->throttle) {
+            pair.caps &= ~(unsigned)(STRATEGY_CAP_RANGE | STRATEGY_CAP_SENDFILE | STRATEGY_CAP_MMAP);
+        }
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/PULL_REQUEST_TEMPLATE.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/PULL_REQUEST_TEMPLATE.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/PULL_REQUEST_TEMPLATE.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/PULL_REQUEST_TEMPLATE.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
-}
+    int preallocated = 0;
+    for (;;) {
+        copy_strategy_t strategy = strategy_pick(probed, st->st_size, sparse, no_cache);
+        if (probed && !preallocated) {
+            preallocate(options, probed, strategy, out, st->st_size);
+            preallocated = 1;
+        }
 
-int copy_architecture(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+        int result = run_strategy(strategy, in, out, st, no_cache, options ? options->throttle : NULL);
+        if (result <= 0) {
+            trace(options, "%s %lld bytes -> %s", strategy_name(strategy), (long long)st->st_size, dest_full_path);
+            return result;
+        }
+
+        // Only strategies with a capability bit report themselves unsupported
+        strategy_forget(probed, strategy_cap(strategy));
+        trace(options, "%s unsupported from %s to %s, falling back", strategy_name(strategy),
+              strategy_fs_name(probed->src_type), strategy_fs_name(probed->dest_type));
     }
+}
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
+int copy_path_data(const copy_options_t *options, const char *src_full_path, const char *dest_full_path) {
+    int in = open(src_full_path, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        perror("Error opening source file (open)");
+        fprintf(stderr, "Failed to open: %s\n", src_full_path);
         return -1;
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/ARCHITECTURE.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/ARCHITECTURE.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/ARCHITECTURE.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/ARCHITECTURE.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
-}
-
-int copy_roadmap(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        perror("Error getting stat for source file");
+        close(in);
         return -1;
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
+    int out = open_destination(dest_full_path);
+    if (out < 0) {
+        close(in);
         return -1;
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/ROADMAP.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/ROADMAP.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/ROADMAP.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/ROADMAP.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
-}
+    int result = copy_fd_data(options, in, out, &st, dest_full_path);
 
-int copy_support(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
-        return -1;
+    // Keep non-default permissions such as executable bits
+    if (result == 0 && (st.st_mode & 07777) != 0644 && fchmod(out, st.st_mode & 07777) != 0) {
+        perror("Error setting permissions on destination file");
+        result = -1;
     }
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
-        return -1;
+    close(in);
+    if (close(out) != 0) {
+        perror("Error closing destination file");
+        result = -1;
     }
+    return result;
+}
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/SUPPORT.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/SUPPORT.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/SUPPORT.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/SUPPORT.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
+int copy_file(const char *src_full_path, const char *dest_dir) {
+    struct stat st = {0};
+    if (stat(dest_dir, &st) == -1) {
+        if (mkdir(dest_dir, 0755) != 0) {
+            perror("Error creating destination directory");
+            return -1;
+        }
+    }
+
+    const char *filename_ptr = strrchr(src_full_path, '/');
+    if (filename_ptr != NULL) {
+        filename_ptr++;
+    } else {
+        filename_ptr = src_full_path; // No '/' found, so src_full_path is just the filename
+    }
+
+    char dest_full_path[1024];
+    // Ensure dest_dir is not empty and handle potential trailing slash if necessary
+    if (dest_dir == NULL || dest_dir[0] == '\0') {
+        snprintf(dest_full_path, sizeof(dest_full_path), "%s", filename_ptr);
+    } else {
+        snprintf(dest_full_path, sizeof(dest_full_path), "%s/%s", dest_dir, filename_ptr);
+    }
+
+
+    if (copy_path_data(&copy_options, src_full_path, dest_full_path) != 0) {
+        return -1;
+    }
+
+    char success_msg[512];
+    snprintf(success_msg, sizeof(success_msg), "Copied '%s'", strrchr(src_full_path, '/') ? strrchr(src_full_path, '/') + 1 : src_full_path);
+    cli_print_step(success_msg);
     
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    return 0;
 }
 
-int copy_install(const char *dest) {
-    // Create directories
-    char prompts_dir[1024];
-    snprintf(prompts_dir, sizeof(prompts_dir), "%s/.github/prompts", dest);
-    if (create_directories(prompts_dir) != 0) {
-        perror("Error creating prompts directory");
+static pool_t *copy_pool(const copy_options_t *options) {
+    static pool_t *pool = NULL;
+    if (options->pool) {
+        return options->pool;
+    }
+    if (options->jobs == 1) {
+        return NULL;
+    }
+    if (!pool) {
+        pool = pool_new(options->jobs);
+    }
+    return pool;
+}
+
+int create_directories(const char *path) {
+    char temp_path[1024];
+    char *p = NULL;
+    size_t len;
+
+    snprintf(temp_path, sizeof(temp_path), "%s", path);
+    len = strlen(temp_path);
+    if (temp_path[len - 1] == '/') {
+        temp_path[len - 1] = 0;
+    }
+
+    for (p = temp_path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = 0;
+            if (mkdir(temp_path, 0755) != 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(temp_path, 0755) != 0 && errno != EEXIST) {
         return -1;
     }
+    return 0;
+}
+
+// Reports a finished file to the caller's callback, or prints it
+static void report_file(const copy_options_t *options, const char *path, int error, void *tag) {
+    if (options->on_file) {
+        perf_phase_t phase = perf_enter(PERF_PHASE_UI);
+        options->on_file(path, error, tag, options->event_ctx);
+        perf_leave(phase);
+    }
+}
 
-    char instructions_dir[1024];
-    snprintf(instructions_dir, sizeof(instructions_dir), "%s/.github/instructions", dest);
-    if (create_directories(instructions_dir) != 0) {
-        perror("Error creating instructions directory");
+// Copies one file into an existing directory, preferring placeholder
+// rendering, then the template pack, then the plain copy core
+static int install_file(const copy_options_t *options, const char *src_full_path, const char *dest_full_path, void *tag) {
+    if (copy_cancelled()) {
+        errno = ECANCELED;
         return -1;
     }
 
-    // Copy files
-    char src_path[1024];
-    char dest_path[1024];
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/prompts/INSTALL.prompt.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/prompts/INSTALL.prompt.md", dest);
-    int r1 = copy_file_to_file(src_path, dest_path);
-    
-    construct_source_path(src_path, sizeof(src_path), "/.github/instructions/INSTALL.instructions.md");
-    snprintf(dest_path, sizeof(dest_path), "%s/.github/instructions/INSTALL.instructions.md", dest);
-    int r2 = copy_file_to_file(src_path, dest_path);
-    
-    return (r1 == 0 && r2 == 0) ? 0 : -1;
+    // A resumed run skips files the journal shows as already copied
+    struct stat src_st;
+    if (options->journal && stat(src_full_path, &src_st) == 0) {
+        if (journal_done(options->journal, dest_full_path, &src_st)) {
+            report_file(options, dest_full_path, 0, tag);
+            return 0;
+        }
+    } else if (options->journal) {
+        fprintf(stderr, "Error getting stat for '%s': %s\n", src_full_path, strerror(errno));
+        return -1;
+    }
+
+    int result = 1;
+    errno = 0;
+    if (options->vars && options->vars->count > 0) {
+        result = copy_rendered(options, src_full_path, dest_full_path);
+    }
+    if (result > 0) {
+        result = copy_transformed(options, src_full_path, dest_full_path);
+    }
+    if (result > 0) {
+        result = copy_from_pack(options, src_full_path, dest_full_path);
+    }
+    if (result > 0) {
+        result = copy_path_data(options, src_full_path, dest_full_path);
+    }
+    if (result == 0 && options->journal) {
+        journal_add(options->journal, dest_full_path, &src_st);
+    }
+
+    if (options->on_file) {
+        report_file(options, dest_full_path, result == 0 ? 0 : (errno ? errno : EIO), tag);
+    } else if (result == 0) {
+        perf_phase_t phase = perf_enter(PERF_PHASE_UI);
+        char success_msg[512];
+        // Named after the destination, since store objects are named by hash
+        snprintf(success_msg, sizeof(success_msg), "Copied '%s'", strrchr(dest_full_path, '/') ? strrchr(dest_full_path, '/') + 1 : dest_full_path);
+        cli_print_step(success_msg);
+        perf_leave(phase);
+    }
+    return result;
 }
 
-int copy_all_templates(const char *dest) {
-    // Copy all available templates
-    int results[13];
-    
-    results[0] = copy_readme(dest);
-    results[1] = copy_release_notes(dest);
-    results[2] = copy_post(dest);
-    results[3] = copy_contributing(dest);
-    results[4] = copy_license_template(dest);
-    results[5] = copy_security(dest);
-    results[6] = copy_code_of_conduct(dest);
-    results[7] = copy_issue_template(dest);
-    results[8] = copy_pr_template(dest);
-    results[9] = copy_architecture(dest);
-    results[10] = copy_roadmap(dest);
-    results[11] = copy_support(dest);
-    results[12] = copy_install(dest);
-    
-    // Check if all operations succeeded
-    for (int i = 0; i < 13; i++) {
-        if (results[i] != 0) {
+static int make_link(const plan_node_t *node) {
+    if (node->op == PLAN_LINK) {
+        return linkat(AT_FDCWD, node->src, AT_FDCWD, node->dest, 0);
+    }
+    return symlink(node->src, node->dest);
+}
+
+// Creates a hard link or symlink, replacing a file already at the destination
+static int install_link(const copy_options_t *options, const plan_node_t *node) {
+    if (copy_cancelled()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    int result = make_link(node);
+    if (result != 0 && errno == EEXIST && unlink(node->dest) == 0) {
+        result = make_link(node);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error linking '%s': %s\n", node->dest, strerror(errno));
+    }
+
+    if (options->on_file) {
+        report_file(options, node->dest, result == 0 ? 0 : errno, node->tag);
+    } else if (result == 0) {
+        perf_phase_t phase = perf_enter(PERF_PHASE_UI);
+        char success_msg[512];
+        snprintf(success_msg, sizeof(success_msg), "Linked '%s'", strrchr(node->dest, '/') ? strrchr(node->dest, '/') + 1 : node->dest);
+        cli_print_step(success_msg);
+        perf_leave(phase);
+    }
+    return result;
+}
+
+typedef struct {
+    const copy_options_t *options;
+    prefetch_t *prefetch;
+} plan_run_t;
+
+static int run_plan_op(const plan_run_t *run, const plan_node_t *node) {
+    const copy_options_t *options = run->options;
+
+    switch (node->op) {
+    case PLAN_MKDIR:
+        if (node->flags & PLAN_F_PARENTS) {
+            if (create_directories(node->dest) != 0) {
+                fprintf(stderr, "Error creating directory '%s': %s\n", node->dest, strerror(errno));
+                report_file(options, node->dest, errno, node->tag);
+                return -1;
+            }
+        } else if (mkdir(node->dest, node->mode) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Error creating directory '%s': %s\n", node->dest, strerror(errno));
+            report_file(options, node->dest, errno, node->tag);
+            return -1;
+        }
+        return 0;
+    case PLAN_COPY:
+        if (!(node->flags & PLAN_F_PACKED)) {
+            prefetch_advance(run->prefetch);
+        }
+        return install_file(options, node->src, node->dest, node->tag);
+    case PLAN_META:
+        if (chmod(node->dest, node->mode) != 0) {
+            fprintf(stderr, "Error setting permissions on '%s': %s\n", node->dest, strerror(errno));
+            report_file(options, node->dest, errno, node->tag);
             return -1;
         }
+        return 0;
+    case PLAN_LINK:
+    case PLAN_SYMLINK:
+        return install_link(options, node);
     }
-    
+    return -1;
+}
+
+static long long elapsed_ns(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (long long)(end.tv_sec - start->tv_sec) * 1000000000LL + (end.tv_nsec - start->tv_nsec);
+}
+
+// Charges the node's work to its phase under --perf-counters, and holds an
+// in-flight slot for each copy when the concurrency is limited
+static int run_plan_node(const plan_node_t *node, void *ctx) {
+    const plan_run_t *run = ctx;
+    adapt_t *adapt = node->op == PLAN_COPY ? run->options->adapt : NULL;
+    struct timespec start;
+    if (adapt) {
+        adapt_acquire(adapt);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    perf_phase_t phase = perf_enter(node->op == PLAN_COPY ? PERF_PHASE_COPY : PERF_PHASE_MKDIR);
+    int result = run_plan_op(run, node);
+    perf_leave(phase);
+
+    if (adapt) {
+        adapt_release(adapt, elapsed_ns(&start), node->size);
+    }
+    return result;
+}
+
+// Executes a plan, or only lists it and adds up its cost under --dry-run
+static int run_plan(const copy_options_t *options, plan_t *plan, plan_estimate_t *estimate) {
+    if (options->dry_run) {
+        plan_print(plan);
+        plan_estimate(plan, estimate);
+        return 0;
+    }
+
+    // Read ahead of the workers, in plan order. Not under --no-cache, which
+    // keeps the data out of the cache anyway, nor when throttled, where it
+    // would read past the limit.
+    const char **sources = NULL;
+    size_t source_count = 0;
+    if (options->prefetch > 0 && !options->no_cache && !options->throttle) {
+        sources = malloc(sizeof(*sources) * plan_size(plan));
+        for (size_t i = 0; sources && i < plan_size(plan); i++) {
+            const plan_node_t *node = plan_node_at(plan, i);
+            if (node->op == PLAN_COPY && !(node->flags & PLAN_F_PACKED)) {
+                sources[source_count++] = node->src;
+            }
+        }
+    }
+    plan_run_t run = {
+        .options = options,
+        .prefetch = source_count > 1 ? prefetch_start(sources, source_count, (size_t)options->prefetch) : NULL,
+    };
+
+    perf_phase_t phase = perf_enter(PERF_PHASE_WAIT);
+    int result = plan_execute(plan, copy_pool(options), run_plan_node, &run);
+    perf_leave(phase);
+    size_t prefetched = prefetch_stop(run.prefetch);
+    if (options->verbose && prefetched > 0) {
+        fprintf(stderr, "Prefetched %zu of %zu source files\n", prefetched, source_count);
+    }
+    free(sources);
+    return result;
+}
+
+static void print_plan_header(const copy_options_t *options) {
+    if (options->dry_run) {
+        cli_print_header("Install Plan (dry run)");
+    }
+}
+
+static void print_plan_footer(const copy_options_t *options, const plan_estimate_t *estimate) {
+    if (options->dry_run) {
+        plan_print_estimate(estimate);
+    }
+}
+
+// Tree copies are planned and executed in windows of this many nodes, which
+// keeps memory bounded on huge trees
+#define COPY_TREE_WINDOW 4096
+
+typedef struct {
+    char *path;
+    mode_t mode;
+} deferred_meta_t;
+
+// First destination of each multi-link source inode, so that later names of
+// the inode become hard links to it. Open addressing over 24-byte slots;
+// the paths live in one arena.
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    size_t path; // arena offset + 1, 0 for an empty slot
+} inode_slot_t;
+
+typedef struct {
+    inode_slot_t *slots;
+    size_t cap; // a power of two
+    size_t count;
+    char *arena;
+    size_t arena_used;
+    size_t arena_cap;
+} inode_table_t;
+
+// A later name of an inode, linked once the window's copies are done
+typedef struct {
+    char *first;
+    char *dest;
+} deferred_link_t;
+
+// A file held back under physical_order until its window is sorted
+typedef struct {
+    char *src;
+    char *dest;
+    long long size;
+    unsigned long long physical; // byte offset of the first extent on the device
+    unsigned long long ino;
+} ordered_copy_t;
+
+typedef struct {
+    const copy_options_t *options;
+    plan_t *plan;
+    const char *src;
+    const char *dest;
+    void *tag;
+    plan_estimate_t estimate;
+    deferred_meta_t *metas;
+    size_t meta_count;
+    size_t meta_cap;
+    ordered_copy_t *ordered;
+    size_t ordered_count;
+    size_t ordered_cap;
+    int ordered_unmapped; // some file of the window has no extent map
+    inode_table_t inodes;
+    deferred_link_t *links;
+    size_t link_count;
+    size_t link_cap;
+    int result;
+} tree_plan_t;
+
+static size_t inode_hash(dev_t dev, ino_t ino) {
+    uint64_t h = ((uint64_t)ino ^ ((uint64_t)dev << 32 | (uint64_t)dev >> 32)) * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ h >> 29);
+}
+
+static int inode_table_grow(inode_table_t *table) {
+    size_t cap = table->cap ? table->cap * 2 : 256;
+    inode_slot_t *slots = calloc(cap, sizeof(inode_slot_t));
+    if (!slots) return -1;
+    for (size_t i = 0; i < table->cap; i++) {
+        if (table->slots[i].path == 0) continue;
+        size_t j = inode_hash(table->slots[i].dev, table->slots[i].ino) & (cap - 1);
+        while (slots[j].path != 0) j = (j + 1) & (cap - 1);
+        slots[j] = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->cap = cap;
     return 0;
 }
 
-int copy_file_to_file(const char *src_full_path, const char *dest_full_path) {
-    // Create parent directories for dest_full_path if needed
-    char dest_dir[1024];
-    strncpy(dest_dir, dest_full_path, sizeof(dest_dir));
-    dest_dir[sizeof(dest_dir) - 1] = '\0';
-    char *last_slash = strrchr(dest_dir, '/');
-    if (last_slash) {
-        *last_slash = '\0';
-        struct stat st = {0};
-        if (stat(dest_dir, &st) == -1) {
-            if (mkdir(dest_dir, 0755) != 0 && errno != EEXIST) {
-                perror("Error creating parent directory for destination file");
+// Returns the destination first recorded for the inode (valid until the
+// next call), or records dest for it and returns NULL. *error is set when
+// it could not be recorded.
+static const char *inode_table_first(inode_table_t *table, const struct stat *st, const char *dest, int *error) {
+    *error = 0;
+    if (table->count * 2 >= table->cap && inode_table_grow(table) != 0) {
+        *error = 1;
+        return NULL;
+    }
+    size_t i = inode_hash(st->st_dev, st->st_ino) & (table->cap - 1);
+    for (; table->slots[i].path != 0; i = (i + 1) & (table->cap - 1)) {
+        if (table->slots[i].dev == st->st_dev && table->slots[i].ino == st->st_ino) {
+            return table->arena + table->slots[i].path - 1;
+        }
+    }
+
+    size_t len = strlen(dest) + 1;
+    if (table->arena_used + len > table->arena_cap) {
+        size_t cap = table->arena_cap ? table->arena_cap * 2 : 16384;
+        while (cap < table->arena_used + len) cap *= 2;
+        char *arena = realloc(table->arena, cap);
+        if (!arena) {
+            *error = 1;
+            return NULL;
+        }
+        table->arena = arena;
+        table->arena_cap = cap;
+    }
+    memcpy(table->arena + table->arena_used, dest, len);
+    table->slots[i] = (inode_slot_t){ .dev = st->st_dev, .ino = st->st_ino, .path = table->arena_used + 1 };
+    table->arena_used += len;
+    table->count++;
+    return NULL;
+}
+
+static void inode_table_free(inode_table_t *table) {
+    free(table->slots);
+    free(table->arena);
+}
+
+static int compare_physical(const void *a, const void *b) {
+    const ordered_copy_t *x = a;
+    const ordered_copy_t *y = b;
+    return x->physical < y->physical ? -1 : x->physical > y->physical;
+}
+
+static int compare_ino(const void *a, const void *b) {
+    const ordered_copy_t *x = a;
+    const ordered_copy_t *y = b;
+    return x->ino < y->ino ? -1 : x->ino > y->ino;
+}
+
+// Offset of the file's first extent. Returns -1 where the filesystem has no
+// FIEMAP; an empty or inline file has no extent and sorts first.
+static int first_extent(int dirfd, const char *name, unsigned long long *physical) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    union {
+        struct fiemap map;
+        char bytes[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.map.fm_length = FIEMAP_MAX_OFFSET;
+    request.map.fm_extent_count = 1;
+    int result = ioctl(fd, FS_IOC_FIEMAP, &request.map);
+    close(fd);
+    if (result != 0) {
+        return -1;
+    }
+    *physical = request.map.fm_mapped_extents > 0 ? request.map.fm_extents[0].fe_physical : 0;
+    return 0;
+}
+
+// Adds the held-back copies of the window in on-disk order. Their
+// directories were created by the plan just run, so they have no
+// dependencies and, run inline, are read in exactly this order.
+static int plan_ordered_copies(tree_plan_t *tree) {
+    qsort(tree->ordered, tree->ordered_count, sizeof(ordered_copy_t),
+          tree->ordered_unmapped ? compare_ino : compare_physical);
+    if (tree->options->verbose) {
+        fprintf(stderr, "[trace] %zu files ordered by %s\n", tree->ordered_count,
+                tree->ordered_unmapped ? "inode (no FIEMAP)" : "first extent");
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < tree->ordered_count; i++) {
+        plan_node_t node = {
+            .op = PLAN_COPY,
+            .src = tree->ordered[i].src,
+            .dest = tree->ordered[i].dest,
+            .size = tree->ordered[i].size,
+            .tag = tree->tag,
+        };
+        if (plan_add(tree->plan, &node) < 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+static void free_ordered(tree_plan_t *tree) {
+    for (size_t i = 0; i < tree->ordered_count; i++) {
+        free(tree->ordered[i].src);
+        free(tree->ordered[i].dest);
+    }
+    tree->ordered_count = 0;
+    tree->ordered_unmapped = 0;
+}
+
+// Hard links go last in their window: the names they link to were copied
+// in this window or an earlier one
+static int plan_deferred_links(tree_plan_t *tree) {
+    int result = 0;
+    for (size_t i = 0; i < tree->link_count; i++) {
+        plan_node_t node = {
+            .op = PLAN_LINK,
+            .src = tree->links[i].first,
+            .dest = tree->links[i].dest,
+            .tag = tree->tag,
+        };
+        if (plan_add(tree->plan, &node) < 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+static void free_links(tree_plan_t *tree) {
+    for (size_t i = 0; i < tree->link_count; i++) {
+        free(tree->links[i].first);
+        free(tree->links[i].dest);
+    }
+    tree->link_count = 0;
+}
+
+// Under preserve_hardlinks: returns 1 when dest is a later name of an inode
+// already planned and was queued as a link, 0 when it is to be copied
+static int defer_hardlink(tree_plan_t *tree, const struct stat *st, const char *dest) {
+    int error;
+    const char *first = inode_table_first(&tree->inodes, st, dest, &error);
+    if (error) return -1;
+    if (!first) return 0;
+
+    if (tree->link_count == tree->link_cap) {
+        size_t cap = tree->link_cap ? tree->link_cap * 2 : 64;
+        deferred_link_t *links = realloc(tree->links, cap * sizeof(deferred_link_t));
+        if (!links) return -1;
+        tree->links = links;
+        tree->link_cap = cap;
+    }
+    deferred_link_t *link = &tree->links[tree->link_count];
+    link->first = strdup(first);
+    link->dest = strdup(dest);
+    if (!link->first || !link->dest) {
+        free(link->first);
+        free(link->dest);
+        return -1;
+    }
+    tree->link_count++;
+    return 1;
+}
+
+static int plan_symlink(tree_plan_t *tree, const walk_entry_t *entry, const char *dest, int parent) {
+    char target[4096];
+    ssize_t len = readlinkat(entry->dirfd, entry->name, target, sizeof(target) - 1);
+    if (len < 0) {
+        fprintf(stderr, "Error reading symlink '%s': %s\n", entry->path, strerror(errno));
+        report_file(tree->options, dest, errno, tree->tag);
+        tree->result = -1;
+        return 0;
+    }
+    target[len] = '\0';
+    plan_node_t node = {
+        .op = PLAN_SYMLINK,
+        .src = target,
+        .dest = dest,
+        .tag = tree->tag,
+    };
+    int id = plan_add(tree->plan, &node);
+    return id < 0 ? -1 : plan_add_dep(tree->plan, id, parent);
+}
+
+static int tree_flush(tree_plan_t *tree) {
+    int result = run_plan(tree->options, tree->plan, &tree->estimate);
+    plan_reset(tree->plan);
+    if (tree->ordered_count > 0) {
+        // One reader: concurrent workers would seek between their files
+        // and break the sweep up again
+        copy_options_t serial = *tree->options;
+        serial.jobs = 1;
+        serial.pool = NULL;
+        if (plan_ordered_copies(tree) != 0 || run_plan(&serial, tree->plan, &tree->estimate) != 0) {
+            result = -1;
+        }
+        plan_reset(tree->plan);
+        free_ordered(tree);
+    }
+    if (tree->link_count > 0) {
+        if (plan_deferred_links(tree) != 0 || run_plan(tree->options, tree->plan, &tree->estimate) != 0) {
+            result = -1;
+        }
+        plan_reset(tree->plan);
+        free_links(tree);
+    }
+    if (result != 0) {
+        tree->result = -1;
+    }
+    return result;
+}
+
+static int hold_ordered(tree_plan_t *tree, const walk_entry_t *entry, const char *src, const char *dest,
+                        long long size) {
+    if (tree->ordered_count == tree->ordered_cap) {
+        size_t cap = tree->ordered_cap ? tree->ordered_cap * 2 : 256;
+        ordered_copy_t *ordered = realloc(tree->ordered, cap * sizeof(ordered_copy_t));
+        if (!ordered) return -1;
+        tree->ordered = ordered;
+        tree->ordered_cap = cap;
+    }
+    ordered_copy_t *copy = &tree->ordered[tree->ordered_count];
+    copy->src = strdup(src);
+    copy->dest = strdup(dest);
+    copy->size = size;
+    copy->ino = (unsigned long long)entry->ino;
+    copy->physical = 0;
+    if (!copy->src || !copy->dest) {
+        free(copy->src);
+        free(copy->dest);
+        return -1;
+    }
+    if (!tree->ordered_unmapped && first_extent(entry->dirfd, entry->name, &copy->physical) != 0) {
+        tree->ordered_unmapped = 1;
+    }
+    tree->ordered_count++;
+    return 0;
+}
+
+static int defer_meta(tree_plan_t *tree, const char *path, mode_t mode) {
+    if (tree->meta_count == tree->meta_cap) {
+        size_t cap = tree->meta_cap ? tree->meta_cap * 2 : 16;
+        deferred_meta_t *metas = realloc(tree->metas, cap * sizeof(deferred_meta_t));
+        if (!metas) return -1;
+        tree->metas = metas;
+        tree->meta_cap = cap;
+    }
+    tree->metas[tree->meta_count].path = strdup(path);
+    tree->metas[tree->meta_count].mode = mode;
+    if (!tree->metas[tree->meta_count].path) return -1;
+    tree->meta_count++;
+    return 0;
+}
+
+static int plan_tree_entry(const walk_entry_t *entry, void *ctx) {
+    tree_plan_t *tree = ctx;
+    if (copy_cancelled()) {
+        return WALK_STOP;
+    }
+    char src_path[2048];
+    char dest_path[2048];
+    snprintf(src_path, sizeof(src_path), "%s/%s", tree->src, entry->path);
+    snprintf(dest_path, sizeof(dest_path), "%s/%s", tree->dest, entry->path);
+
+    // The parent is only in the plan while its window is pending; otherwise
+    // it has already been created
+    char parent_path[2048];
+    snprintf(parent_path, sizeof(parent_path), "%s", dest_path);
+    *strrchr(parent_path, '/') = '\0';
+    int parent = plan_find_dir(tree->plan, parent_path);
+
+    if (entry->type == WALK_DIR) {
+        int id = plan_mkdir(tree->plan, dest_path, 0755, 0);
+        plan_set_tag(tree->plan, id, tree->tag);
+        if (id < 0 || plan_add_dep(tree->plan, id, parent) != 0) {
+            return -1;
+        }
+
+        // Directory permissions are applied after the whole tree is written,
+        // so read-only directories can still be filled
+        struct stat st;
+        if (fstatat(entry->dirfd, entry->name, &st, AT_SYMLINK_NOFOLLOW) == 0 && (st.st_mode & 07777) != 0755) {
+            if (defer_meta(tree, dest_path, st.st_mode & 07777) != 0) {
                 return -1;
             }
         }
+        return WALK_CONTINUE;
     }
 
-    FILE *source = fopen(src_full_path, "rb");
-    if (!source) {
-        perror("Error opening source file (fopen)");
-        fprintf(stderr, "Failed to open: %s\n", src_full_path);
+    struct stat st = {0};
+    if (entry->type == WALK_SYMLINK && tree->options->preserve_symlinks) {
+        if (plan_symlink(tree, entry, dest_path, parent) != 0) {
+            return -1;
+        }
+    } else if (entry->type == WALK_SYMLINK) {
+        // Links to regular files are copied as files; directory links are not
+        // followed, which keeps link cycles from looping forever
+        if (fstatat(entry->dirfd, entry->name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+            fprintf(stderr, "Skipping symlink '%s'\n", entry->path);
+            return WALK_CONTINUE;
+        }
+    } else if (entry->type != WALK_FILE) {
+        fprintf(stderr, "Skipping special file '%s'\n", entry->path);
+        return WALK_CONTINUE;
+    } else if (tree->options->dry_run || tree->options->preserve_hardlinks || tree->options->adapt) {
+        fstatat(entry->dirfd, entry->name, &st, AT_SYMLINK_NOFOLLOW);
+    }
+
+    int linked = 0;
+    if (entry->type == WALK_FILE && tree->options->preserve_hardlinks && st.st_nlink > 1) {
+        linked = defer_hardlink(tree, &st, dest_path);
+        if (linked < 0) {
+            return -1;
+        }
+    }
+
+    long long size = st.st_size > 0 ? (long long)st.st_size : (tree->options->dry_run ? 0 : -1);
+    if (linked || (entry->type == WALK_SYMLINK && tree->options->preserve_symlinks)) {
+        // Planned above
+    } else if (tree->options->physical_order) {
+        if (hold_ordered(tree, entry, src_path, dest_path, size) != 0) {
+            return -1;
+        }
+    } else {
+        plan_node_t node = {
+            .op = PLAN_COPY,
+            .src = src_path,
+            .dest = dest_path,
+            .size = size,
+            .tag = tree->tag,
+        };
+        int id = plan_add(tree->plan, &node);
+        if (id < 0 || plan_add_dep(tree->plan, id, parent) != 0) {
+            return -1;
+        }
+    }
+
+    if (plan_size(tree->plan) + tree->ordered_count + tree->link_count >= COPY_TREE_WINDOW) {
+        tree_flush(tree);
+    }
+    return WALK_CONTINUE;
+}
+
+int copy_directory_with(const copy_options_t *options, const char *src, const char *dest, void *tag) {
+    tree_plan_t tree = {
+        .options = options,
+        .plan = plan_new(),
+        .src = src,
+        .dest = dest,
+        .tag = tag,
+    };
+    if (!tree.plan) {
         return -1;
     }
 
-    FILE *destination_file = fopen(dest_full_path, "wb");
-    if (!destination_file) {
-        perror("Error opening destination file (fopen)");
-        fprintf(stderr, "Failed to open for writing: %s\n", dest_full_path);
-        fclose(source);
+    print_plan_header(options);
+
+    // Create it, ignore if it already exists
+    int root = plan_mkdir(tree.plan, dest, 0755, 0);
+    if (root < 0) {
+        plan_free(tree.plan);
         return -1;
     }
+    plan_set_tag(tree.plan, root, tag);
+
+    // Each full window is run from inside the walk, under its own phases
+    walk_options_t walk_options = { .mem_limit = options->walk_mem_limit };
+    perf_phase_t phase = perf_enter(PERF_PHASE_PLAN);
+    int result = walk_tree(src, &walk_options, plan_tree_entry, &tree);
+    perf_leave(phase);
+    if (tree_flush(&tree) != 0 || tree.result != 0) {
+        result = -1;
+    }
 
-    char buffer[1024];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), source)) > 0) {
-        if (fwrite(buffer, 1, bytes_read, destination_file) != bytes_read) {
-            perror("Error writing to destination file (fwrite)");
-            fclose(source);
-            fclose(destination_file);
-            return -1;
+    // Deepest directories first, so parents stay searchable until the end
+    for (size_t i = tree.meta_count; i > 0; i--) {
+        plan_node_t meta = {
+            .op = PLAN_META,
+            .dest = tree.metas[i - 1].path,
+            .mode = tree.metas[i - 1].mode,
+            .tag = tag,
+        };
+        if (plan_add(tree.plan, &meta) < 0) {
+            result = -1;
+        }
+        free(tree.metas[i - 1].path);
+    }
+    if (tree.meta_count > 0 && tree_flush(&tree) != 0) {
+        result = -1;
+    }
+
+    print_plan_footer(options, &tree.estimate);
+
+    free_ordered(&tree);
+    free(tree.ordered);
+    free_links(&tree);
+    free(tree.links);
+    inode_table_free(&tree.inodes);
+    free(tree.metas);
+    plan_free(tree.plan);
+    return result;
+}
+
+int copy_directory(const char *src, const char *dest) {
+    return copy_directory_with(&copy_options, src, dest, NULL);
+}
+
+// Where template files are read from: the datadir's own trees, or the
+// objects of a store manifest
+typedef struct {
+    const char *store_root;
+    const store_manifest_t *manifest; // NULL for the datadir
+} template_source_t;
+
+// The datadir holds the version replica was built with, served from its
+// pack or loose files. Any other version, pinned or current in the store,
+// resolves through that version's manifest.
+static int resolve_template_source(const copy_options_t *options, template_source_t *source) {
+    char current[STORE_VERSION_MAX];
+    const char *version = options->template_version;
+    source->store_root = store_default_root();
+    source->manifest = NULL;
+
+    if (!version) {
+        if (store_current(source->store_root, current, sizeof(current)) != 0) {
+            return 0; // No store, or nothing selected in it
         }
+        version = current;
+    }
+    if (strcmp(version, REPLICA_VERSION) == 0) {
+        return 0;
     }
 
-    if (ferror(source)) {
-        perror("Error reading from source file (ferror)");
-        fclose(source);
-        fclose(destination_file);
+    source->manifest = store_manifest_get(source->store_root, version);
+    if (!source->manifest) {
+        fprintf(stderr, "Template version '%s' is not in the store at %s\n", version, source->store_root);
         return -1;
     }
+    return 0;
+}
 
-    fclose(source);
-    fclose(destination_file);
-    
-    char success_msg[512];
-    snprintf(success_msg, sizeof(success_msg), "Copied '%s'", strrchr(src_full_path, '/') ? strrchr(src_full_path, '/') + 1 : src_full_path);
-    cli_print_step(success_msg);
-    
+// Plans the prompt and instructions files of one template set
+static int plan_template_set(const copy_options_t *options, const template_source_t *source, plan_t *plan,
+                             const template_set_t *set, const char *dest, void *tag) {
+    const char *subdirs[] = {TEMPLATE_PROMPTS_DIR, TEMPLATE_INSTRUCTIONS_DIR};
+    const char *files[] = {set->prompt, set->instructions};
+
+    for (int i = 0; i < 2; i++) {
+        char dir[1024];
+        char sub_path[512];
+        char src_path[1024];
+        char dest_path[1280];
+        snprintf(dir, sizeof(dir), "%s%s", dest, subdirs[i]);
+        snprintf(sub_path, sizeof(sub_path), "%s/%s", subdirs[i], files[i]);
+        snprintf(dest_path, sizeof(dest_path), "%s/%s", dir, files[i]);
+
+        // An overlay root replaces the file whichever version is selected
+        const store_entry_t *stored = NULL;
+        if (roots_find(sub_path, src_path, sizeof(src_path))) {
+            // Read from the overlay as a loose file
+        } else if (source->manifest) {
+            stored = store_manifest_find(source->manifest, sub_path);
+            if (!stored) {
+                fprintf(stderr, "Template '%s' is missing from the selected version\n", sub_path);
+                errno = ENOENT;
+                return -1;
+            }
+            store_object_path(source->store_root, stored->hash, src_path, sizeof(src_path));
+        } else {
+            construct_source_path(src_path, sizeof(src_path), sub_path);
+        }
+
+        int dir_id = plan_mkdir(plan, dir, 0755, PLAN_F_PARENTS);
+        plan_set_tag(plan, dir_id, tag);
+
+        plan_node_t node = {
+            .op = PLAN_COPY,
+            .src = src_path,
+            .dest = dest_path,
+            .size = -1,
+            .tag = tag,
+        };
+        const pack_entry_t *entry = stored ? NULL : find_packed(options, src_path);
+        struct stat st;
+        if (stored) {
+            node.size = stored->size;
+        } else if (entry) {
+            node.flags |= PLAN_F_PACKED;
+            node.size = (long long)entry->raw_size;
+        } else if (options->dry_run && stat(src_path, &st) == 0) {
+            node.size = (long long)st.st_size;
+        }
+
+        int id = plan_add(plan, &node);
+        if (dir_id < 0 || id < 0 || plan_add_dep(plan, id, dir_id) != 0) {
+            return -1;
+        }
+    }
     return 0;
 }
+
+#define COPY_STREAM_CHUNK (1 << 30)
+
+// Writes all of in to out, which need not be seekable: splice into pipes and
+// sendfile into sockets and files move the data without a user-space copy;
+// anything else gets one large write from a mapping
+static int stream_to_fd(int in, off_t size, int out) {
+    struct stat out_st;
+    int pipe_out = fstat(out, &out_st) == 0 && S_ISFIFO(out_st.st_mode);
+    int kernel = pipe_out || S_ISSOCK(out_st.st_mode) || S_ISREG(out_st.st_mode);
+
+    off_t pos = 0;
+    while (kernel && pos < size) {
+        size_t want = size - pos > COPY_STREAM_CHUNK ? COPY_STREAM_CHUNK : (size_t)(size - pos);
+        loff_t in_pos = pos;
+        ssize_t n = pipe_out ? splice(in, &in_pos, out, NULL, want, SPLICE_F_MORE)
+                             : sendfile(out, in, &in_pos, want);
+        if (n == 0) {
+            return 0; // Shrunk since fstat
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (pos == 0 && unsupported_errno(errno)) {
+                break; // e.g. an O_APPEND file
+            }
+            perror(pipe_out ? "Error writing output (splice)" : "Error writing output (sendfile)");
+            return -1;
+        }
+        pos += n;
+    }
+    if (pos >= size) {
+        return 0;
+    }
+
+    void *map = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, in, 0);
+    if (map != MAP_FAILED) {
+        int result = write_all(out, map, (size_t)size, -1);
+        munmap(map, (size_t)size);
+        return result;
+    }
+    char buffer[256 * 1024];
+    for (;;) {
+        ssize_t n = read(in, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("Error reading from source file (read)");
+            return -1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (write_all(out, buffer, (size_t)n, -1) != 0) {
+            return -1;
+        }
+    }
+}
+
+int copy_template_to_fd(const copy_options_t *options, const char *sub_path, int fd) {
+    template_source_t source;
+    if (resolve_template_source(options, &source) != 0) {
+        return -1;
+    }
+
+    char src_path[1024];
+    if (roots_find(sub_path, src_path, sizeof(src_path))) {
+        // Overlay file
+    } else if (source.manifest) {
+        const store_entry_t *stored = store_manifest_find(source.manifest, sub_path);
+        if (!stored) {
+            fprintf(stderr, "Template '%s' is missing from the selected version\n", sub_path);
+            errno = ENOENT;
+            return -1;
+        }
+        store_object_path(source.store_root, stored->hash, src_path, sizeof(src_path));
+    } else {
+        construct_source_path(src_path, sizeof(src_path), sub_path);
+        const pack_entry_t *entry = find_packed(options, src_path);
+        if (entry) {
+            return pack_extract_to_fd(options_pack(options), entry, fd);
+        }
+    }
+
+    int in = open(src_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (in < 0 || fstat(in, &st) != 0) {
+        perror("Error opening source file (open)");
+        fprintf(stderr, "Failed to open: %s\n", src_path);
+        if (in >= 0) close(in);
+        return -1;
+    }
+    int result = st.st_size > 0 ? stream_to_fd(in, st.st_size, fd) : 0;
+    close(in);
+    return result;
+}
+
+// Installs several template sets as a single plan, so shared directories
+// are created once and the copies run in parallel
+int copy_templates_with(const copy_options_t *options, const copy_request_t *requests, int count) {
+    plan_t *plan = plan_new();
+    if (!plan) {
+        return -1;
+    }
+
+    template_source_t source;
+    perf_phase_t phase = perf_enter(PERF_PHASE_PLAN);
+    int result = resolve_template_source(options, &source);
+    for (int i = 0; i < count && result == 0; i++) {
+        result = plan_template_set(options, &source, plan, requests[i].set, requests[i].dest, requests[i].tag);
+    }
+    perf_leave(phase);
+
+    if (result == 0) {
+        plan_estimate_t estimate = {0};
+        print_plan_header(options);
+        result = run_plan(options, plan, &estimate);
+        print_plan_footer(options, &estimate);
+    }
+
+    plan_free(plan);
+    return result;
+}
+
+static int install_named_set(const char *name, const char *dest) {
+    copy_request_t request = { .set = template_set_find(name), .dest = dest };
+    if (!request.set) {
+        return -1;
+    }
+    return copy_templates_with(&copy_options, &request, 1);
+}
+
+int copy_readme(const char *dest) {
+    return install_named_set("readme", dest);
+}
+
+int copy_release_notes(const char *dest) {
+    return install_named_set("release-notes", dest);
+}
+
+int copy_post(const char *dest) {
+    return install_named_set("post", dest);
+}
+
+int copy_contributing(const char *dest) {
+    return install_named_set("contributing", dest);
+}
+
+int copy_license_template(const char *dest) {
+    return install_named_set("license", dest);
+}
+
+int copy_security(const char *dest) {
+    return install_named_set("security", dest);
+}
+
+int copy_code_of_conduct(const char *dest) {
+    return install_named_set("code-of-conduct", dest);
+}
+
+int copy_issue_template(const char *dest) {
+    return install_named_set("issue-template", dest);
+}
+
+int copy_pr_template(const char *dest) {
+    return install_named_set("pr-template", dest);
+}
+
+int copy_architecture(const char *dest) {
+    return install_named_set("architecture", dest);
+}
+
+int copy_roadmap(const char *dest) {
+    return install_named_set("roadmap", dest);
+}
+
+int copy_support(const char *dest) {
+    return install_named_set("support", dest);
+}
+
+int copy_install(const char *dest) {
+    return install_named_set("install", dest);
+}
+
+int copy_all_templates(const char *dest) {
+    // Copy all available templates
+    copy_request_t *requests = malloc(sizeof(*requests) * (size_t)template_set_count);
+    if (!requests) {
+        return -1;
+    }
+    for (int i = 0; i < template_set_count; i++) {
+        requests[i] = (copy_request_t){ .set = &template_sets[i], .dest = dest };
+    }
+
+    int result = copy_templates_with(&copy_options, requests, template_set_count);
+    free(requests);
+    return result;
+}
+
+int copy_file_to_file(const char *src_full_path, const char *dest_full_path) {
+    // Create parent directories for dest_full_path if needed
+    char dest_dir[1024];
+    strncpy(dest_dir, dest_full_path, sizeof(dest_dir));
+    dest_dir[sizeof(dest_dir) - 1] = '\0';
+    char *last_slash = strrchr(dest_dir, '/');
+    if (last_slash) {
+        *last_slash = '\0';
+        struct stat st = {0};
+        if (stat(dest_dir, &st) == -1) {
+            if (mkdir(dest_dir, 0755) != 0 && errno != EEXIST) {
+                perror("Error creating parent directory for destination file");
+                return -1;
+            }
+        }
+    }
+
+    return install_file(&copy_options, src_full_path, dest_full_path, NULL) == 0 ? 0 : -1;
+}
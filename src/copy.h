@@ -2,6 +2,65 @@
 #define COPY_H
 
 #include <stdio.h>
+#include "adapt.h"
+#include "journal.h"
+#include "pack.h"
+#include "pool.h"
+#include "render.h"
+#include "templates.h"
+#include "throttle.h"
+#include "transform.h"
+
+// Called once per file written, with error 0, or with an errno value when the
+// file or its directory could not be written. May run on worker threads.
+typedef void (*copy_event_fn)(const char *path, int error, void *tag, void *ctx);
+
+typedef struct {
+    const render_vars_t *vars; // {{key}} substitutions, NULL copies verbatim
+    size_t walk_mem_limit;     // cap on copy_directory traversal state, 0 for the default
+    int jobs;                  // copy workers, 0 picks one per CPU, 1 runs inline
+    int dry_run;               // print the install plan instead of executing it
+    int no_cache;              // keep large copies out of the page cache
+    int verbose;               // trace filesystem probes and per-file copy strategies to stderr
+    pool_t *pool;              // run copies here instead of on copy's own pool
+    pack_t *pack;              // template pack to serve from, NULL for pack_default()
+    const char *template_version; // store version to install, NULL for the store's current one
+    journal_t *journal;        // record finished files here and skip those it already holds
+    throttle_t *throttle;      // bytes/s and IOPS limits shared by all workers, NULL for none
+    adapt_t *adapt;            // in-flight copy slots and their latency, NULL for no limit
+    int prefetch;              // source files to read ahead of the workers, 0 for none
+    const transform_t *transform; // line ending, BOM and UTF-8 rules, NULL copies bytes as they are
+    int physical_order;        // tree copies: start each window's files in on-disk order (FIEMAP, else inode)
+    int preserve_hardlinks;    // tree copies: names of one source inode become hard links to one copy
+    int preserve_symlinks;     // tree copies: recreate symlinks instead of copying the files they point to
+    copy_event_fn on_file;     // per-file completion; NULL prints a step line instead
+    void *event_ctx;
+} copy_options_t;
+
+// Read-ahead window 'rpc copy' uses unless --prefetch says otherwise
+#define COPY_DEFAULT_PREFETCH 32
+
+// One template set to install into dest; tag is handed to on_file
+typedef struct {
+    const template_set_t *set;
+    const char *dest;
+    void *tag;
+} copy_request_t;
+
+void copy_set_options(const copy_options_t *options);
+
+// Stops copies in progress and any not yet started; they fail with
+// ECANCELED. Safe to call from a signal handler.
+void copy_cancel(void);
+int copy_cancelled(void);
+
+// Entry points taking explicit options instead of the copy_set_options() ones
+int copy_templates_with(const copy_options_t *options, const copy_request_t *requests, int count);
+int copy_directory_with(const copy_options_t *options, const char *source, const char *dest, void *tag);
+
+// Writes one template, e.g. "/.github/prompts/SECURITY.prompt.md", to fd from
+// the selected version: spliced into pipes, sent to sockets and files
+int copy_template_to_fd(const copy_options_t *options, const char *sub_path, int fd);
 
 int copy_file(const char *source, const char *destination);
 int copy_directory(const char *source, const char *destination);
@@ -21,4 +80,9 @@ int copy_install(const char *dest);
 int copy_all_templates(const char *dest);
 int copy_file_to_file(const char *src_full_path, const char *dest_full_path);
 
+// Building blocks shared with sync
+void construct_source_path(char *path_buffer, size_t buffer_size, const char *sub_path);
+int copy_path_data(const copy_options_t *options, const char *src_full_path, const char *dest_full_path);
+int create_directories(const char *path);
+
 #endif // COPY_H
@@ -0,0 +1,199 @@
+// For syscall() and fstatat
+#define _GNU_SOURCE
+
+#include "discover.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DISCOVER_BUFFER_SIZE (32 * 1024)
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Dependency and cache trees: large, and never home to a clone
+static const char *pruned_names[] = {
+    "node_modules", "bower_components", "__pycache__", "venv",
+};
+
+typedef struct {
+    pool_t *pool;
+    discover_fn fn;
+    void *ctx;
+    atomic_size_t dirs;
+    atomic_size_t repos;
+    atomic_size_t pruned;
+    atomic_size_t errors;
+} discover_t;
+
+typedef struct {
+    discover_t *walk;
+    int is_root; // may be a symlink, e.g. ~/src pointing to another disk
+    char path[];
+} dir_task_t;
+
+static int is_pruned(const char *name) {
+    if (name[0] == '.') {
+        return 1; // .git is checked before this; other dot directories are caches and tool state
+    }
+    for (size_t i = 0; i < sizeof(pruned_names) / sizeof(pruned_names[0]); i++) {
+        if (strcmp(name, pruned_names[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void read_dir_task(void *arg);
+
+static void submit_dir(discover_t *walk, const char *parent, const char *name) {
+    size_t len = strlen(parent) + strlen(name) + 2;
+    dir_task_t *task = malloc(sizeof(dir_task_t) + len);
+    if (!task) {
+        atomic_fetch_add(&walk->errors, 1);
+        return;
+    }
+    task->walk = walk;
+    task->is_root = name[0] == '\0';
+    if (task->is_root) {
+        snprintf(task->path, len, "%s", parent);
+    } else {
+        snprintf(task->path, len, "%s%s%s", parent, parent[strlen(parent) - 1] == '/' ? "" : "/", name);
+    }
+    if (pool_submit(walk->pool, read_dir_task, task) != 0) {
+        read_dir_task(task);
+    }
+}
+
+static void read_dir_task(void *arg) {
+    dir_task_t *task = arg;
+    discover_t *walk = task->walk;
+    atomic_fetch_add(&walk->dirs, 1);
+
+    int fd = open(task->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (task->is_root ? 0 : O_NOFOLLOW));
+    char *buffer = fd >= 0 ? malloc(DISCOVER_BUFFER_SIZE) : NULL;
+    if (!buffer) {
+        fprintf(stderr, "Error opening directory '%s': %s\n", task->path, strerror(errno));
+        atomic_fetch_add(&walk->errors, 1);
+        if (fd >= 0) close(fd);
+        free(task);
+        return;
+    }
+
+    // Subdirectories are only descended into once the whole directory has
+    // been read, since .git may come after them
+    char *children = NULL;
+    size_t children_len = 0;
+    size_t children_cap = 0;
+    int is_repo = 0;
+    int failed = 0;
+    size_t pruned = 0;
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buffer, DISCOVER_BUFFER_SIZE);
+        if (n <= 0) {
+            if (n < 0) {
+                fprintf(stderr, "Error reading directory '%s': %s\n", task->path, strerror(errno));
+                failed = 1;
+            }
+            break;
+        }
+        for (long off = 0; off < n; off += ((struct linux_dirent64 *)(void *)(buffer + off))->d_reclen) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(void *)(buffer + off);
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) {
+                continue;
+            }
+            if (strcmp(d->d_name, ".git") == 0) {
+                is_repo = 1;
+                continue;
+            }
+
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                type = fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+            }
+            if (type != DT_DIR) {
+                continue;
+            }
+            if (is_pruned(d->d_name)) {
+                pruned++;
+                continue;
+            }
+
+            size_t len = strlen(d->d_name) + 1;
+            if (children_len + len > children_cap) {
+                size_t cap = children_cap ? children_cap * 2 : 4096;
+                while (cap < children_len + len) cap *= 2;
+                char *grown = realloc(children, cap);
+                if (!grown) {
+                    failed = 1;
+                    break;
+                }
+                children = grown;
+                children_cap = cap;
+            }
+            memcpy(children + children_len, d->d_name, len);
+            children_len += len;
+        }
+    }
+    close(fd);
+    free(buffer);
+
+    if (is_repo) {
+        atomic_fetch_add(&walk->repos, 1);
+        walk->fn(task->path, walk->ctx);
+    } else {
+        atomic_fetch_add(&walk->pruned, pruned);
+        for (size_t off = 0; off < children_len; off += strlen(children + off) + 1) {
+            submit_dir(walk, task->path, children + off);
+        }
+    }
+    if (failed) {
+        atomic_fetch_add(&walk->errors, 1);
+    }
+    free(children);
+    free(task);
+}
+
+int discover_repos(pool_t *pool, const char *root, discover_fn fn, void *ctx, discover_stats_t *stats) {
+    struct stat st;
+    int error = stat(root, &st) != 0 ? errno : !S_ISDIR(st.st_mode) ? ENOTDIR : 0;
+    if (error) {
+        fprintf(stderr, "Error opening directory '%s': %s\n", root, strerror(error));
+        return -1;
+    }
+
+    discover_t walk = {
+        .pool = pool,
+        .fn = fn,
+        .ctx = ctx,
+    };
+    atomic_init(&walk.dirs, 0);
+    atomic_init(&walk.repos, 0);
+    atomic_init(&walk.pruned, 0);
+    atomic_init(&walk.errors, 0);
+
+    submit_dir(&walk, root, "");
+    pool_wait(pool);
+
+    if (stats) {
+        stats->dirs = atomic_load(&walk.dirs);
+        stats->repos = atomic_load(&walk.repos);
+        stats->pruned = atomic_load(&walk.pruned);
+        stats->errors = atomic_load(&walk.errors);
+    }
+    return atomic_load(&walk.errors) == 0 ? 0 : -1;
+}
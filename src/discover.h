@@ -0,0 +1,31 @@
+#ifndef DISCOVER_H
+#define DISCOVER_H
+
+#include <stddef.h>
+#include "pool.h"
+
+// Parallel discovery of git repositories under a root. Every directory is
+// read by its own pool task, so the walk fans out across the workers. A
+// directory holding a .git entry (a directory, or a file for worktrees and
+// submodules) is reported and not descended into. Symlinks are not
+// followed, and hidden and dependency directories (node_modules and the
+// like) are pruned unread.
+
+typedef struct {
+    size_t dirs;   // directories read
+    size_t repos;  // repositories reported
+    size_t pruned; // directories skipped by name
+    size_t errors; // directories that could not be read
+} discover_stats_t;
+
+// Called on a worker thread for each repository, as soon as it is found.
+// It may submit more tasks to the same pool; discover_repos() waits for
+// those too.
+typedef void (*discover_fn)(const char *repo, void *ctx);
+
+// Walks root on pool and returns once the walk and every task submitted
+// from fn have finished. Returns -1 if root can't be read or a directory
+// failed; stats may be NULL.
+int discover_repos(pool_t *pool, const char *root, discover_fn fn, void *ctx, discover_stats_t *stats);
+
+#endif // DISCOVER_H
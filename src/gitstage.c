@@ -0,0 +1,1016 @@
+// For strcasestr, strncasecmp and realpath
+#define _GNU_SOURCE
+
+#include "gitstage.h"
+#include "sha1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INDEX_HEADER_SIZE 12
+#define ENTRY_FIXED_SIZE 62   // stat data, object id and flags
+#define ENTRY_F_EXTENDED 0x4000
+#define ENTRY_F_STAGE 0x3000
+#define ENTRY_F_NAME 0x0FFF
+#define ENTRY_XF_INTENT_TO_ADD 0x2000
+#define STORED_BLOCK_MAX 65535 // largest stored deflate block
+#define WRITER_BUFFER_SIZE (1024 * 1024)
+#define CONFIG_INCLUDE_DEPTH 10
+#define ATTR_MACRO_MAX 32
+
+typedef struct {
+    char work_tree[PATH_MAX];
+    char git_dir[PATH_MAX];
+    char common_dir[PATH_MAX]; // objects and config; differs from git_dir in linked worktrees
+} repo_t;
+
+typedef struct {
+    char *name;        // relative to the work tree
+    size_t name_len;
+    struct stat st;
+    unsigned char oid[SHA1_DIGEST_SIZE];
+    uint32_t mode;
+    size_t start;      // index bytes this entry replaces: [start, end)
+    size_t end;
+    const unsigned char *old; // the stage 0 entry being replaced, if any
+    int changed;       // contents, mode or conflict stages differ from the index
+} staged_t;
+
+static uint32_t get_be32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint16_t get_be16(const unsigned char *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void put_be16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+// Reads a one-line file such as .git or commondir, without the newline
+static int read_line_file(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    int result = fgets(buf, (int)size, f) ? 0 : -1;
+    fclose(f);
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return result;
+}
+
+// Resolves target against base unless it is absolute
+static int resolve_from(const char *base, const char *target, char *out) {
+    char joined[PATH_MAX * 2];
+    if (target[0] == '/') {
+        snprintf(joined, sizeof(joined), "%s", target);
+    } else {
+        snprintf(joined, sizeof(joined), "%s/%s", base, target);
+    }
+    return realpath(joined, out) ? 0 : -1;
+}
+
+// Finds the work tree containing dir and its git directories, following
+// gitdir files (submodules, linked worktrees) and commondir
+static int find_repo(const char *dir, repo_t *repo) {
+    if (!realpath(dir, repo->work_tree)) {
+        return -1;
+    }
+    for (;;) {
+        char dot_git[PATH_MAX];
+        struct stat st;
+        if (snprintf(dot_git, sizeof(dot_git), "%s/.git", repo->work_tree) >= (int)sizeof(dot_git)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        if (stat(dot_git, &st) == 0 && S_ISDIR(st.st_mode)) {
+            snprintf(repo->git_dir, sizeof(repo->git_dir), "%s", dot_git);
+            break;
+        }
+        char line[PATH_MAX + 16];
+        if (stat(dot_git, &st) == 0 && S_ISREG(st.st_mode) && read_line_file(dot_git, line, sizeof(line)) == 0 &&
+            strncmp(line, "gitdir: ", 8) == 0) {
+            if (resolve_from(repo->work_tree, line + 8, repo->git_dir) != 0) {
+                return -1;
+            }
+            break;
+        }
+        char *slash = strrchr(repo->work_tree, '/');
+        if (!slash || slash == repo->work_tree) {
+            errno = ENOENT;
+            return -1;
+        }
+        *slash = '\0';
+    }
+
+    char commondir_file[PATH_MAX + 16];
+    char line[PATH_MAX];
+    snprintf(commondir_file, sizeof(commondir_file), "%s/commondir", repo->git_dir);
+    if (read_line_file(commondir_file, line, sizeof(line)) == 0) {
+        return resolve_from(repo->git_dir, line, repo->common_dir);
+    }
+    snprintf(repo->common_dir, sizeof(repo->common_dir), "%s", repo->git_dir);
+    return 0;
+}
+
+// extensions.objectFormat = sha256 changes every object id
+static int uses_sha256(const repo_t *repo) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/config", repo->common_dir);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    char line[512];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), f)) {
+        found = strcasestr(line, "objectformat") && strcasestr(line, "sha256");
+    }
+    fclose(f);
+    return found;
+}
+
+// What git add would do to contents on their way into the object database
+typedef struct {
+    int autocrlf;                        // core.autocrlf is true or input
+    char attributes_file[PATH_MAX];      // core.attributesFile, "" for the default
+    char macros[ATTR_MACRO_MAX][64];     // [attr] macros that set a conversion
+    size_t macro_count;
+} conversions_t;
+
+// Attributes that change contents on add: line endings, filters such as
+// LFS, $Id$ expansion and re-encoding
+static const char *conversion_attrs[] = {"text", "eol", "crlf", "filter", "ident", "working-tree-encoding"};
+
+// "~/x" relative to $HOME
+static void expand_home(const char *path, char *out, size_t size) {
+    const char *home = getenv("HOME");
+    if (path[0] == '~' && path[1] == '/' && home) {
+        snprintf(out, size, "%s%s", home, path + 1);
+    } else {
+        snprintf(out, size, "%s", path);
+    }
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    size_t len = strcspn(s, "\r\n");
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t')) len--;
+    s[len] = '\0';
+    return s;
+}
+
+// Reads core.autocrlf and core.attributesFile from one config file. Every
+// include and includeIf is followed, conditions or not: a file that might
+// turn on autocrlf is taken to do so.
+static void read_config(const char *path, conversions_t *conv, int depth) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+    char section[64] = "";
+    char line[PATH_MAX + 64];
+    while (fgets(line, sizeof(line), f)) {
+        char *p = trim(line);
+        if (*p == '[') {
+            size_t len = strcspn(p + 1, " \t\"]");
+            snprintf(section, sizeof(section), "%.*s", (int)len, p + 1);
+            char *rest = strchr(p, ']');
+            if (!rest) continue;
+            p = trim(rest + 1);
+        }
+        if (*p == '\0' || *p == '#' || *p == ';') {
+            continue;
+        }
+
+        size_t key_len = strcspn(p, " \t=");
+        char *value = p + key_len;
+        value += strspn(value, " \t");
+        value = *value == '=' ? trim(value + 1) : (char *)"true";
+        size_t value_len = strlen(value);
+        if (value_len >= 2 && value[0] == '"' && value[value_len - 1] == '"') {
+            value[value_len - 1] = '\0';
+            value++;
+        }
+
+        if (strcasecmp(section, "core") == 0 && key_len == 8 && strncasecmp(p, "autocrlf", 8) == 0) {
+            conv->autocrlf = strcasecmp(value, "false") != 0 && strcasecmp(value, "no") != 0 &&
+                             strcasecmp(value, "off") != 0 && strcmp(value, "0") != 0 && *value != '\0';
+        } else if (strcasecmp(section, "core") == 0 && key_len == 14 && strncasecmp(p, "attributesfile", 14) == 0) {
+            expand_home(value, conv->attributes_file, sizeof(conv->attributes_file));
+        } else if ((strcasecmp(section, "include") == 0 || strcasecmp(section, "includeif") == 0) && key_len == 4 &&
+                   strncasecmp(p, "path", 4) == 0 && depth < CONFIG_INCLUDE_DEPTH) {
+            // Relative includes are relative to the including file
+            char included[PATH_MAX];
+            char joined[PATH_MAX * 2];
+            expand_home(value, included, sizeof(included));
+            const char *slash = strrchr(path, '/');
+            if (included[0] != '/' && slash) {
+                snprintf(joined, sizeof(joined), "%.*s/%s", (int)(slash - path), path, included);
+            } else {
+                snprintf(joined, sizeof(joined), "%s", included);
+            }
+            read_config(joined, conv, depth + 1);
+        }
+    }
+    fclose(f);
+}
+
+// The config files git reads, lowest priority first
+static void read_git_config(const repo_t *repo, conversions_t *conv) {
+    char path[PATH_MAX + 32];
+    const char *xdg = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    const char *global = getenv("GIT_CONFIG_GLOBAL");
+
+    if (!getenv("GIT_CONFIG_NOSYSTEM")) {
+        read_config(getenv("GIT_CONFIG_SYSTEM") ? getenv("GIT_CONFIG_SYSTEM") : "/etc/gitconfig", conv, 0);
+    }
+    if (global) {
+        read_config(global, conv, 0);
+    } else {
+        if (xdg && *xdg) {
+            snprintf(path, sizeof(path), "%s/git/config", xdg);
+            read_config(path, conv, 0);
+        } else if (home) {
+            snprintf(path, sizeof(path), "%s/.config/git/config", home);
+            read_config(path, conv, 0);
+        }
+        if (home) {
+            snprintf(path, sizeof(path), "%s/.gitconfig", home);
+            read_config(path, conv, 0);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/config", repo->common_dir);
+    read_config(path, conv, 0);
+    snprintf(path, sizeof(path), "%s/config.worktree", repo->git_dir);
+    read_config(path, conv, 0);
+
+    if (!conv->attributes_file[0]) {
+        if (xdg && *xdg) {
+            snprintf(conv->attributes_file, sizeof(conv->attributes_file), "%s/git/attributes", xdg);
+        } else if (home) {
+            snprintf(conv->attributes_file, sizeof(conv->attributes_file), "%s/.config/git/attributes", home);
+        }
+    }
+}
+
+// Whether an attribute list (after the pattern) sets a conversion. Unset
+// (-text) and unspecified (!text) ones don't.
+static int sets_conversion(char *attrs, const conversions_t *conv) {
+    char *save;
+    for (char *attr = strtok_r(attrs, " \t", &save); attr; attr = strtok_r(NULL, " \t", &save)) {
+        if (*attr == '-' || *attr == '!') {
+            continue;
+        }
+        size_t len = strcspn(attr, "=");
+        for (size_t i = 0; i < sizeof(conversion_attrs) / sizeof(conversion_attrs[0]); i++) {
+            if (strlen(conversion_attrs[i]) == len && strncmp(attr, conversion_attrs[i], len) == 0) {
+                return 1;
+            }
+        }
+        for (size_t i = 0; i < conv->macro_count; i++) {
+            if (strlen(conv->macros[i]) == len && strncmp(attr, conv->macros[i], len) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Whether a gitattributes pattern from the file in directory dir ("" for the
+// top and the global files) matches name. Errs towards a match: "**" and
+// quoted patterns are taken to match everything.
+static int attr_pattern_matches(const char *pattern, const char *dir, const char *name) {
+    size_t dir_len = strlen(dir);
+    if (strncmp(name, dir, dir_len) != 0) {
+        return 0;
+    }
+    const char *relative = name + dir_len;
+    size_t len = strlen(pattern);
+    if (len > 0 && pattern[len - 1] == '/') {
+        return 0; // directories only; attributes don't recurse into them
+    }
+    if (strstr(pattern, "**") || pattern[0] == '"') {
+        return 1;
+    }
+    if (!strchr(pattern, '/')) {
+        const char *base = strrchr(relative, '/');
+        return fnmatch(pattern, base ? base + 1 : relative, 0) == 0;
+    }
+    return fnmatch(pattern[0] == '/' ? pattern + 1 : pattern, relative, FNM_PATHNAME) == 0;
+}
+
+// Whether any line of an attributes file sets a conversion for name. Later
+// lines that unset it again are not weighed, so this may refuse a file git
+// would leave alone, never the other way around.
+static int attributes_convert(const char *path, const char *dir, const char *name, conversions_t *conv) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    int found = 0;
+    char line[4096];
+    while (!found && fgets(line, sizeof(line), f)) {
+        char *p = trim(line);
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        size_t pattern_len = strcspn(p, " \t");
+        char *attrs = p + pattern_len;
+        if (*attrs) *attrs++ = '\0';
+
+        if (strncmp(p, "[attr]", 6) == 0) {
+            if (conv->macro_count < ATTR_MACRO_MAX && sets_conversion(attrs, conv)) {
+                snprintf(conv->macros[conv->macro_count++], sizeof(conv->macros[0]), "%s", p + 6);
+            }
+        } else if (attr_pattern_matches(p, dir, name)) {
+            found = sets_conversion(attrs, conv);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+// Whether git add would convert name: the global attributes file, then
+// .gitattributes from the top of the work tree down to the file, then
+// info/attributes
+static int path_converts(const repo_t *repo, const char *name, conversions_t *conv) {
+    conv->macro_count = 0;
+    if (conv->attributes_file[0] && attributes_convert(conv->attributes_file, "", name, conv)) {
+        return 1;
+    }
+    char dir[PATH_MAX];
+    char path[PATH_MAX * 2];
+    size_t len = 0;
+    for (;;) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)len, name);
+        snprintf(path, sizeof(path), "%s/%s.gitattributes", repo->work_tree, dir);
+        if (attributes_convert(path, dir, name, conv)) {
+            return 1;
+        }
+        const char *slash = strchr(name + len, '/');
+        if (!slash) break;
+        len = (size_t)(slash - name) + 1;
+    }
+    snprintf(path, sizeof(path), "%s/info/attributes", repo->common_dir);
+    return attributes_convert(path, "", name, conv);
+}
+
+// Git's order: bytes, then the shorter name first
+static int compare_names(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (c != 0) return c;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+static int compare_staged(const void *a, const void *b) {
+    const staged_t *x = a;
+    const staged_t *y = b;
+    return compare_names(x->name, x->name_len, y->name, y->name_len);
+}
+
+static uint32_t adler32_update(uint32_t adler, const unsigned char *data, size_t size) {
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t n = size < 5552 ? size : 5552; // the most bytes before b can overflow
+        size -= n;
+        while (n-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+static int write_fully(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+// Writes the file as a loose blob. Objects are zlib streams; they are
+// written as stored (uncompressed) deflate blocks, which every git reads and
+// `git gc` compresses into a pack later, so no compression library is needed.
+static int write_blob(const repo_t *repo, int in, const struct stat *st, unsigned char oid[SHA1_DIGEST_SIZE]) {
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s/objects/tmp_obj_XXXXXX", repo->common_dir);
+    int out = mkstemp(tmp);
+    if (out < 0) {
+        return -1;
+    }
+
+    unsigned char *block = malloc(5 + STORED_BLOCK_MAX);
+    sha1_t sha;
+    sha1_init(&sha);
+    uint32_t adler = 1;
+    static const unsigned char zlib_header[2] = {0x78, 0x01};
+    int result = block ? write_fully(out, zlib_header, sizeof(zlib_header)) : -1;
+
+    // "blob <size>\0" and the contents, cut into stored blocks
+    int header = block ? snprintf((char *)block + 5, 32, "blob %lld", (long long)st->st_size) + 1 : 0;
+    unsigned long long remaining = (unsigned long long)st->st_size + (unsigned long long)header;
+    size_t used = (size_t)header;
+    while (result == 0) {
+        while (used < STORED_BLOCK_MAX && used < remaining) {
+            size_t want = STORED_BLOCK_MAX - used;
+            if (want > remaining - used) want = (size_t)(remaining - used);
+            ssize_t n = read(in, block + 5 + used, want);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                errno = n == 0 ? EIO : errno; // the file shrank underneath us
+                result = -1;
+                break;
+            }
+            used += (size_t)n;
+        }
+        if (result != 0) break;
+        int last = used == remaining;
+        block[0] = last ? 1 : 0;
+        block[1] = (unsigned char)(used & 0xff); // LEN and NLEN are little-endian
+        block[2] = (unsigned char)(used >> 8);
+        block[3] = (unsigned char)(~used & 0xff);
+        block[4] = (unsigned char)((~used >> 8) & 0xff);
+        sha1_update(&sha, block + 5, used);
+        adler = adler32_update(adler, block + 5, used);
+        result = write_fully(out, block, 5 + used);
+        remaining -= used;
+        used = 0;
+        if (last) break;
+    }
+    unsigned char trailer[4];
+    put_be32(trailer, adler);
+    if (result == 0) {
+        result = write_fully(out, trailer, sizeof(trailer));
+    }
+    free(block);
+    if (fchmod(out, 0444) != 0) result = -1;
+    if (close(out) != 0) result = -1;
+    if (result != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+
+    sha1_final(&sha, oid);
+    char hex[SHA1_HEX_SIZE];
+    sha1_to_hex(oid, hex);
+    char path[PATH_MAX + 64];
+    snprintf(path, sizeof(path), "%s/objects/%.2s", repo->common_dir, hex);
+    if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+        unlink(tmp);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/objects/%.2s/%s", repo->common_dir, hex, hex + 2);
+    // Like git: never replace an object that is already there
+    if (link(tmp, path) != 0 && errno != EEXIST && rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    unlink(tmp);
+    return 0;
+}
+
+// Finds an installed file's name in the work tree. Returns 1 when it lies
+// outside the work tree.
+static int resolve_name(const repo_t *repo, const char *path, staged_t *staged) {
+    char full[PATH_MAX];
+    if (!realpath(path, full)) {
+        return -1;
+    }
+    size_t root_len = strlen(repo->work_tree);
+    if (strncmp(full, repo->work_tree, root_len) != 0 || full[root_len] != '/') {
+        return 1;
+    }
+    staged->name = strdup(full + root_len + 1);
+    if (!staged->name) {
+        return -1;
+    }
+    staged->name_len = strlen(staged->name);
+    return 0;
+}
+
+// Writes the blob for one installed file and records its index entry
+static int stage_file(const repo_t *repo, staged_t *staged) {
+    char full[PATH_MAX * 2];
+    snprintf(full, sizeof(full), "%s/%s", repo->work_tree, staged->name);
+    int in = open(full, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return -1;
+    }
+    int result = fstat(in, &staged->st) == 0 && S_ISREG(staged->st.st_mode) ? 0 : -1;
+    if (result == 0) {
+        result = write_blob(repo, in, &staged->st, staged->oid);
+    }
+    close(in);
+    staged->mode = staged->st.st_mode & 0111 ? 0100755 : 0100644;
+    return result;
+}
+
+// The parsed index: entries in [entries, extensions), then extensions up to
+// the trailing checksum
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    uint32_t version;
+    uint32_t count;
+    size_t entries;
+    size_t extensions;
+    int skip_hash; // index.skipHash: the checksum is left zero
+} index_file_t;
+
+static size_t entry_name_offset(const unsigned char *entry) {
+    return ENTRY_FIXED_SIZE + (get_be16(entry + 60) & ENTRY_F_EXTENDED ? 2 : 0);
+}
+
+static size_t entry_name_len(const unsigned char *entry, const unsigned char *end) {
+    size_t len = get_be16(entry + 60) & ENTRY_F_NAME;
+    if (len < ENTRY_F_NAME) {
+        return len;
+    }
+    const unsigned char *name = entry + entry_name_offset(entry);
+    const unsigned char *nul = memchr(name, '\0', (size_t)(end - name));
+    return nul ? (size_t)(nul - name) : (size_t)(end - name);
+}
+
+// Entries are NUL-padded to a multiple of 8 bytes, with at least one NUL
+static size_t entry_size(const unsigned char *entry, const unsigned char *end) {
+    return (entry_name_offset(entry) + entry_name_len(entry, end) + 8) & ~(size_t)7;
+}
+
+static int parse_index(index_file_t *index) {
+    const unsigned char *p = index->data;
+    if (index->size < INDEX_HEADER_SIZE + SHA1_DIGEST_SIZE || memcmp(p, "DIRC", 4) != 0) {
+        fprintf(stderr, "Not a git index (bad signature)\n");
+        return -1;
+    }
+    index->version = get_be32(p + 4);
+    index->count = get_be32(p + 8);
+    if (index->version != 2 && index->version != 3) {
+        fprintf(stderr, "Index version %u is not supported; stage the files with git add\n", index->version);
+        return -1;
+    }
+
+    const unsigned char *end = p + index->size - SHA1_DIGEST_SIZE;
+    size_t offset = INDEX_HEADER_SIZE;
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (offset + ENTRY_FIXED_SIZE + 2 > index->size - SHA1_DIGEST_SIZE) {
+            fprintf(stderr, "Index is truncated\n");
+            return -1;
+        }
+        offset += entry_size(p + offset, end);
+    }
+    index->entries = INDEX_HEADER_SIZE;
+    index->extensions = offset;
+
+    // Extensions whose signature does not start with a capital letter must
+    // be understood by whoever writes the index (split index "link",
+    // sparse index "sdir"); none of those can be carried through
+    while (offset + 8 <= index->size - SHA1_DIGEST_SIZE) {
+        uint32_t size = get_be32(p + offset + 4);
+        if (p[offset] < 'A' || p[offset] > 'Z') {
+            fprintf(stderr, "Index uses the '%.4s' extension, which is not supported; stage the files with git add\n",
+                    (const char *)(p + offset));
+            return -1;
+        }
+        offset += 8 + (size_t)size;
+    }
+    if (offset != index->size - SHA1_DIGEST_SIZE) {
+        fprintf(stderr, "Index extensions are corrupt\n");
+        return -1;
+    }
+
+    static const unsigned char zero[SHA1_DIGEST_SIZE];
+    index->skip_hash = memcmp(p + index->size - SHA1_DIGEST_SIZE, zero, SHA1_DIGEST_SIZE) == 0;
+    return 0;
+}
+
+// Finds where each staged path goes: the bytes of the entries it replaces
+// (every stage of its name), or the spot where it is inserted
+static void place_staged(const index_file_t *index, staged_t *staged, size_t count) {
+    const unsigned char *end = index->data + index->size - SHA1_DIGEST_SIZE;
+    size_t offset = index->entries;
+    size_t j = 0;
+    for (uint32_t i = 0; i < index->count && j < count; i++) {
+        const unsigned char *entry = index->data + offset;
+        size_t size = entry_size(entry, end);
+        const char *name = (const char *)entry + entry_name_offset(entry);
+        size_t name_len = entry_name_len(entry, end);
+
+        while (j < count && compare_names(staged[j].name, staged[j].name_len, name, name_len) < 0) {
+            if (staged[j].end == 0) {
+                staged[j].start = staged[j].end = offset;
+            }
+            j++;
+        }
+        if (j < count && compare_names(staged[j].name, staged[j].name_len, name, name_len) == 0) {
+            if (staged[j].end == 0) {
+                staged[j].start = offset;
+            }
+            staged[j].end = offset + size;
+            if ((get_be16(entry + 60) & ENTRY_F_STAGE) == 0) {
+                staged[j].old = entry;
+            } else {
+                staged[j].changed = 1; // resolves a conflict
+            }
+        }
+        offset += size;
+    }
+    for (; j < count; j++) {
+        if (staged[j].end == 0) {
+            staged[j].start = staged[j].end = index->extensions;
+        }
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        const unsigned char *old = staged[k].old;
+        if (!old || get_be32(old + 24) != staged[k].mode || memcmp(old + 40, staged[k].oid, SHA1_DIGEST_SIZE) != 0) {
+            staged[k].changed = 1;
+        }
+    }
+}
+
+// Buffered output to index.lock that checksums what it writes
+typedef struct {
+    int fd;
+    int hash;
+    sha1_t sha;
+    unsigned char *buf;
+    size_t used;
+    int failed;
+} index_writer_t;
+
+static void writer_flush(index_writer_t *w) {
+    if (!w->failed && w->used > 0 && write_fully(w->fd, w->buf, w->used) != 0) {
+        w->failed = 1;
+    }
+    w->used = 0;
+}
+
+static void writer_put(index_writer_t *w, const void *data, size_t size) {
+    if (w->hash) {
+        sha1_update(&w->sha, data, size);
+    }
+    if (w->used + size > WRITER_BUFFER_SIZE) {
+        writer_flush(w);
+        if (size > WRITER_BUFFER_SIZE / 2) {
+            if (!w->failed && write_fully(w->fd, data, size) != 0) {
+                w->failed = 1;
+            }
+            return;
+        }
+    }
+    memcpy(w->buf + w->used, data, size);
+    w->used += size;
+}
+
+static void write_entry(index_writer_t *w, const index_file_t *index, const staged_t *staged) {
+    unsigned char fixed[ENTRY_FIXED_SIZE + 2];
+    const struct stat *st = &staged->st;
+    put_be32(fixed, (uint32_t)st->st_ctim.tv_sec);
+    put_be32(fixed + 4, (uint32_t)st->st_ctim.tv_nsec);
+    put_be32(fixed + 8, (uint32_t)st->st_mtim.tv_sec);
+    put_be32(fixed + 12, (uint32_t)st->st_mtim.tv_nsec);
+    put_be32(fixed + 16, (uint32_t)st->st_dev);
+    put_be32(fixed + 20, (uint32_t)st->st_ino);
+    put_be32(fixed + 24, staged->mode);
+    put_be32(fixed + 28, (uint32_t)st->st_uid);
+    put_be32(fixed + 32, (uint32_t)st->st_gid);
+    put_be32(fixed + 36, (uint32_t)st->st_size);
+    memcpy(fixed + 40, staged->oid, SHA1_DIGEST_SIZE);
+
+    // Keep skip-worktree and the like from the entry being replaced, but
+    // not intent-to-add, which the new contents fulfil
+    uint16_t extended = 0;
+    if (index->version >= 3 && staged->old && (get_be16(staged->old + 60) & ENTRY_F_EXTENDED)) {
+        extended = get_be16(staged->old + ENTRY_FIXED_SIZE) & (uint16_t)~ENTRY_XF_INTENT_TO_ADD;
+    }
+    uint16_t flags = (uint16_t)(staged->name_len < ENTRY_F_NAME ? staged->name_len : ENTRY_F_NAME);
+    size_t fixed_size = ENTRY_FIXED_SIZE;
+    if (extended) {
+        flags |= ENTRY_F_EXTENDED;
+        put_be16(fixed + ENTRY_FIXED_SIZE, extended);
+        fixed_size += 2;
+    }
+    put_be16(fixed + 60, flags);
+
+    static const unsigned char padding[8];
+    size_t total = (fixed_size + staged->name_len + 8) & ~(size_t)7;
+    writer_put(w, fixed, fixed_size);
+    writer_put(w, staged->name, staged->name_len);
+    writer_put(w, padding, total - fixed_size - staged->name_len);
+}
+
+// Whether a changed path lies under the directory path/ ("" is the root)
+static int under_changed(const char *path, size_t len, const staged_t *staged, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (staged[i].changed &&
+            (len == 0 || (staged[i].name_len > len && memcmp(staged[i].name, path, len) == 0 && staged[i].name[len] == '/'))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Copies one cache-tree node and its subtrees, invalidating (entry count -1,
+// no object id) every directory that contains a changed path. Returns the
+// end of the node, or NULL when the extension does not parse.
+static const unsigned char *rewrite_tree(const unsigned char *p, const unsigned char *end, char *path, size_t len,
+                                         const staged_t *staged, size_t count, unsigned char **out) {
+    const unsigned char *nul = memchr(p, '\0', (size_t)(end - p));
+    if (!nul) return NULL;
+    size_t name_len = (size_t)(nul - p);
+    size_t path_len = len + (len && name_len ? 1 : 0) + name_len;
+    if (path_len >= PATH_MAX) return NULL;
+    if (len && name_len) path[len] = '/';
+    memcpy(path + path_len - name_len, p, name_len);
+
+    char *rest;
+    const unsigned char *counts = nul + 1;
+    long entries = strtol((const char *)counts, &rest, 10);
+    if (*rest != ' ') return NULL;
+    long subtrees = strtol(rest + 1, &rest, 10);
+    if (*rest != '\n' || subtrees < 0) return NULL;
+    p = (const unsigned char *)rest + 1;
+    if (entries >= 0) {
+        if (end - p < SHA1_DIGEST_SIZE) return NULL;
+        p += SHA1_DIGEST_SIZE;
+    }
+
+    int invalid = entries >= 0 && under_changed(path, path_len, staged, count);
+    memcpy(*out, nul - name_len, name_len + 1);
+    *out += name_len + 1;
+    *out += sprintf((char *)*out, "%ld %ld\n", invalid ? -1L : entries, subtrees);
+    if (entries >= 0 && !invalid) {
+        memcpy(*out, p - SHA1_DIGEST_SIZE, SHA1_DIGEST_SIZE);
+        *out += SHA1_DIGEST_SIZE;
+    }
+
+    for (long i = 0; i < subtrees && p; i++) {
+        p = rewrite_tree(p, end, path, path_len, staged, count, out);
+    }
+    return p;
+}
+
+static void write_extensions(index_writer_t *w, const index_file_t *index, const staged_t *staged, size_t count,
+                             int shifted) {
+    size_t offset = index->extensions;
+    while (offset + 8 <= index->size - SHA1_DIGEST_SIZE) {
+        const unsigned char *ext = index->data + offset;
+        size_t size = get_be32(ext + 4);
+        offset += 8 + size;
+
+        // Byte offsets of entries, and fsmonitor bits by entry position
+        if (memcmp(ext, "EOIE", 4) == 0 || memcmp(ext, "IEOT", 4) == 0 || (shifted && memcmp(ext, "FSMN", 4) == 0)) {
+            continue;
+        }
+        if (memcmp(ext, "TREE", 4) != 0) {
+            writer_put(w, ext, 8 + size);
+            continue;
+        }
+
+        // A node grows by at most one byte ("-1" for a one-digit count)
+        unsigned char *tree = malloc(size * 2 + 64);
+        char *path = malloc(PATH_MAX);
+        unsigned char *out = tree;
+        const unsigned char *data = ext + 8;
+        const unsigned char *end = data + size;
+        const unsigned char *p = tree && path ? data : NULL;
+        while (p && p < end) {
+            p = rewrite_tree(p, end, path, 0, staged, count, &out);
+        }
+        // A cache tree that can't be followed is dropped; git rebuilds it
+        if (p == end) {
+            unsigned char header[8];
+            memcpy(header, "TREE", 4);
+            put_be32(header + 4, (uint32_t)(out - tree));
+            writer_put(w, header, sizeof(header));
+            writer_put(w, tree, (size_t)(out - tree));
+        }
+        free(tree);
+        free(path);
+    }
+}
+
+// Rewrites the index with the staged entries under index.lock
+static int update_index(const repo_t *repo, staged_t *staged, size_t count, git_stage_stats_t *stats) {
+    char index_path[PATH_MAX + 16];
+    char lock_path[PATH_MAX + 16];
+    snprintf(index_path, sizeof(index_path), "%s/index", repo->git_dir);
+    snprintf(lock_path, sizeof(lock_path), "%s/index.lock", repo->git_dir);
+
+    int lock = open(lock_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (lock < 0) {
+        if (errno == EEXIST) {
+            fprintf(stderr, "Cannot stage: '%s' exists. Another git process seems to be running in this "
+                            "repository; if not, remove the file.\n", lock_path);
+        } else {
+            perror("Error creating index.lock");
+        }
+        return -1;
+    }
+
+    // A repository without an index yet starts from an empty one
+    static const unsigned char empty[INDEX_HEADER_SIZE + SHA1_DIGEST_SIZE] = {'D', 'I', 'R', 'C', 0, 0, 0, 2};
+    index_file_t index = { .data = empty, .size = sizeof(empty) };
+    void *map = NULL;
+    int in = open(index_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    int result = 0;
+    if (in >= 0 && fstat(in, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+            result = -1;
+        } else {
+            index.data = map;
+            index.size = (size_t)st.st_size;
+        }
+    } else if (in < 0 && errno != ENOENT) {
+        result = -1;
+    }
+    if (in >= 0) close(in);
+    if (result != 0) {
+        perror("Error reading the index");
+    } else {
+        result = parse_index(&index);
+        index.skip_hash = index.skip_hash && map;
+    }
+
+    index_writer_t w = { .fd = lock, .hash = !index.skip_hash, .buf = malloc(WRITER_BUFFER_SIZE) };
+    if (result == 0 && !w.buf) {
+        result = -1;
+    }
+    if (result == 0) {
+        place_staged(&index, staged, count);
+
+        // Every stage of a replaced name goes; one stage 0 entry comes back
+        long long entries = index.count;
+        int shifted = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t removed = 0;
+            for (size_t offset = staged[i].start; offset < staged[i].end; removed++) {
+                offset += entry_size(index.data + offset, index.data + index.size - SHA1_DIGEST_SIZE);
+            }
+            entries += 1 - (long long)removed;
+            shifted |= removed != 1;
+            if (staged[i].changed) {
+                stats->staged++;
+            } else {
+                stats->unchanged++;
+            }
+        }
+
+        if (w.hash) sha1_init(&w.sha);
+        unsigned char header[INDEX_HEADER_SIZE];
+        memcpy(header, "DIRC", 4);
+        put_be32(header + 4, index.version);
+        put_be32(header + 8, (uint32_t)entries);
+        writer_put(&w, header, sizeof(header));
+
+        // Untouched entries are copied through in runs between the staged ones
+        size_t cursor = index.entries;
+        for (size_t i = 0; i < count; i++) {
+            writer_put(&w, index.data + cursor, staged[i].start - cursor);
+            write_entry(&w, &index, &staged[i]);
+            cursor = staged[i].end;
+        }
+        writer_put(&w, index.data + cursor, index.extensions - cursor);
+        write_extensions(&w, &index, staged, count, shifted);
+
+        unsigned char checksum[SHA1_DIGEST_SIZE] = {0};
+        if (w.hash) {
+            sha1_final(&w.sha, checksum);
+        }
+        w.hash = 0;
+        writer_put(&w, checksum, sizeof(checksum));
+        writer_flush(&w);
+        result = w.failed ? -1 : 0;
+        if (result != 0) {
+            perror("Error writing index.lock");
+        }
+    }
+
+    free(w.buf);
+    if (map) munmap(map, index.size);
+    if (close(lock) != 0 && result == 0) {
+        perror("Error writing index.lock");
+        result = -1;
+    }
+    if (result == 0 && rename(lock_path, index_path) != 0) {
+        perror("Error replacing the index");
+        result = -1;
+    }
+    if (result != 0) {
+        unlink(lock_path);
+    }
+    return result;
+}
+
+int git_stage_paths(const char *dir, const char *const *paths, size_t count, git_stage_stats_t *stats) {
+    *stats = (git_stage_stats_t){0};
+    repo_t repo;
+    if (find_repo(dir, &repo) != 0) {
+        fprintf(stderr, "Cannot stage: %s is not inside a git work tree\n", dir);
+        return -1;
+    }
+    if (uses_sha256(&repo)) {
+        fprintf(stderr, "Cannot stage: SHA-256 repositories are not supported; stage the files with git add\n");
+        return -1;
+    }
+
+    staged_t *staged = calloc(count ? count : 1, sizeof(staged_t));
+    if (!staged) {
+        return -1;
+    }
+    size_t used = 0;
+    int result = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        int resolved = resolve_name(&repo, paths[i], &staged[used]);
+        if (resolved < 0) {
+            fprintf(stderr, "Error resolving '%s': %s\n", paths[i], strerror(errno));
+            result = -1;
+        } else if (resolved > 0) {
+            stats->skipped++;
+        } else {
+            used++;
+        }
+    }
+
+    // The same file reported twice is staged once
+    qsort(staged, used, sizeof(staged_t), compare_staged);
+    size_t unique = 0;
+    for (size_t i = 0; i < used; i++) {
+        if (unique > 0 && compare_staged(&staged[unique - 1], &staged[i]) == 0) {
+            free(staged[unique - 1].name);
+            staged[unique - 1] = staged[i];
+        } else {
+            staged[unique++] = staged[i];
+        }
+    }
+
+    // Raw bytes are only what git add would store when nothing converts them
+    conversions_t *conv = calloc(1, sizeof(conversions_t));
+    if (!conv) {
+        result = -1;
+    } else if (result == 0 && unique > 0) {
+        read_git_config(&repo, conv);
+        if (conv->autocrlf) {
+            fprintf(stderr, "Cannot stage: core.autocrlf converts line endings; stage the files with git add\n");
+            result = -1;
+        }
+    }
+    for (size_t i = 0; i < unique && result == 0; i++) {
+        if (path_converts(&repo, staged[i].name, conv)) {
+            fprintf(stderr, "Cannot stage: '%s' has text, eol, filter, ident or encoding attributes; "
+                            "stage the files with git add\n", staged[i].name);
+            result = -1;
+        }
+    }
+    free(conv);
+
+    for (size_t i = 0; i < unique && result == 0; i++) {
+        if (stage_file(&repo, &staged[i]) != 0) {
+            fprintf(stderr, "Error writing a blob for '%s': %s\n", staged[i].name, strerror(errno));
+            result = -1;
+        }
+    }
+    if (result == 0 && unique > 0) {
+        result = update_index(&repo, staged, unique, stats);
+    }
+    for (size_t i = 0; i < unique; i++) {
+        free(staged[i].name);
+    }
+    free(staged);
+    return result;
+}
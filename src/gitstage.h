@@ -0,0 +1,30 @@
+#ifndef GITSTAGE_H
+#define GITSTAGE_H
+
+#include <stddef.h>
+
+// Stages installed files in the git repository around them without running
+// git (init --git-stage). Each file becomes a loose blob in the object
+// database, and only its own entry in .git/index is added or replaced: the
+// other entries and the extensions are copied through as they are, so a
+// huge index is neither re-read entry by entry nor refreshed against the
+// work tree. The cache tree (TREE) is invalidated along the changed paths,
+// and the offset tables (EOIE, IEOT) are dropped for git to rebuild.
+//
+// The index is rewritten under index.lock like git does. Index version 4,
+// split and sparse indexes (required extensions) and SHA-256 repositories
+// are refused, leaving the files for a regular `git add`. So is any file git
+// add would convert: with core.autocrlf set, or a text, eol, filter, ident
+// or working-tree-encoding attribute matching it.
+
+typedef struct {
+    size_t staged;    // entries added or given new contents
+    size_t unchanged; // already staged with these contents; stat data refreshed
+    size_t skipped;   // paths outside the work tree
+} git_stage_stats_t;
+
+// Stages paths (files, as given to open) in the repository containing dir.
+// Returns 0, or -1 after printing why nothing was staged.
+int git_stage_paths(const char *dir, const char *const *paths, size_t count, git_stage_stats_t *stats);
+
+#endif // GITSTAGE_H
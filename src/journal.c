@@ -0,0 +1,260 @@
+// For clock_gettime and strdup
+#define _POSIX_C_SOURCE 200809L
+
+#include "journal.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+#define JOURNAL_FLUSH_MS 1000
+
+typedef struct {
+    const char *path; // points into journal->data
+    long long size;
+    long long mtime_sec;
+    long mtime_nsec;
+} journal_record_t;
+
+struct journal {
+    int fd;
+    char *path;
+    pthread_mutex_t lock; // guards the append buffer
+    char buffer[JOURNAL_BUFFER_SIZE];
+    size_t used;
+    long long last_flush_ms;
+
+    // Records of the previous run, in an open-addressing table by path
+    char *data;
+    journal_record_t *table;
+    size_t table_size; // power of two, 0 when nothing was loaded
+    size_t loaded;
+    atomic_size_t skipped;
+};
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t fnv1a(const char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static journal_record_t *table_slot(const journal_t *journal, const char *path) {
+    size_t mask = journal->table_size - 1;
+    size_t i = (size_t)fnv1a(path, strlen(path)) & mask;
+    while (journal->table[i].path && strcmp(journal->table[i].path, path) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &journal->table[i];
+}
+
+// Parses one line in place. Returns 0 for a valid record.
+static int parse_record(char *line, size_t len, journal_record_t *record) {
+    char *body = memchr(line, ' ', len);
+    if (!body || body - line != 16) {
+        return -1;
+    }
+    body++;
+    size_t body_len = len - (size_t)(body - line);
+    if (strtoull(line, NULL, 16) != fnv1a(body, body_len)) {
+        return -1;
+    }
+
+    line[len] = '\0';
+    char *end;
+    record->size = strtoll(body, &end, 10);
+    if (*end != ' ') return -1;
+    record->mtime_sec = strtoll(end + 1, &end, 10);
+    if (*end != '.') return -1;
+    record->mtime_nsec = strtol(end + 1, &end, 10);
+    if (*end != ' ' || end[1] == '\0') return -1;
+    record->path = end + 1;
+    return 0;
+}
+
+// Loads the previous run's records and drops a torn last line, so appends
+// start on a line of their own
+static int journal_load(journal_t *journal) {
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) {
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    journal->data = malloc(size + 1);
+    if (!journal->data) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(journal->fd, journal->data + done, size - done, (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += (size_t)n;
+    }
+
+    size_t lines = 0;
+    size_t complete = 0; // bytes up to the last newline
+    for (size_t i = 0; i < size; i++) {
+        if (journal->data[i] == '\n') {
+            lines++;
+            complete = i + 1;
+        }
+    }
+    if (complete < size && ftruncate(journal->fd, (off_t)complete) != 0) {
+        return -1;
+    }
+
+    journal->table_size = 16;
+    while (journal->table_size < lines * 2) {
+        journal->table_size *= 2;
+    }
+    journal->table = calloc(journal->table_size, sizeof(journal_record_t));
+    if (!journal->table) {
+        return -1;
+    }
+
+    for (size_t start = 0; start < complete;) {
+        char *line = journal->data + start;
+        size_t len = (size_t)((char *)memchr(line, '\n', complete - start) - line);
+        start += len + 1;
+
+        journal_record_t record;
+        if (parse_record(line, len, &record) != 0) {
+            continue;
+        }
+        // Later records of a path replace earlier ones
+        journal_record_t *slot = table_slot(journal, record.path);
+        if (!slot->path) {
+            journal->loaded++;
+        }
+        *slot = record;
+    }
+    return 0;
+}
+
+journal_t *journal_open(const char *path, int resume) {
+    journal_t *journal = calloc(1, sizeof(*journal));
+    if (!journal) {
+        return NULL;
+    }
+    journal->path = strdup(path);
+    journal->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC | (resume ? 0 : O_TRUNC), 0644);
+    pthread_mutex_init(&journal->lock, NULL);
+    journal->last_flush_ms = now_ms();
+
+    if (!journal->path || journal->fd < 0 || (resume && journal_load(journal) != 0)) {
+        fprintf(stderr, "Error opening journal '%s': %s\n", path, strerror(errno));
+        journal_close(journal, 0);
+        return NULL;
+    }
+    return journal;
+}
+
+static int flush_locked(journal_t *journal) {
+    size_t done = 0;
+    while (done < journal->used) {
+        ssize_t n = write(journal->fd, journal->buffer + done, journal->used - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("Error writing journal");
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    journal->used = 0;
+    journal->last_flush_ms = now_ms();
+    return 0;
+}
+
+int journal_flush(journal_t *journal) {
+    pthread_mutex_lock(&journal->lock);
+    int result = flush_locked(journal);
+    pthread_mutex_unlock(&journal->lock);
+    return result;
+}
+
+int journal_close(journal_t *journal, int completed) {
+    if (!journal) return 0;
+
+    int result = 0;
+    if (journal->fd >= 0) {
+        result = flush_locked(journal);
+        if (close(journal->fd) != 0) {
+            result = -1;
+        }
+        if (completed && result == 0 && journal->path) {
+            unlink(journal->path);
+        }
+    }
+    pthread_mutex_destroy(&journal->lock);
+    free(journal->table);
+    free(journal->data);
+    free(journal->path);
+    free(journal);
+    return result;
+}
+
+int journal_done(journal_t *journal, const char *dest, const struct stat *src_st) {
+    if (journal->table_size == 0) {
+        return 0;
+    }
+    const journal_record_t *record = table_slot(journal, dest);
+    struct stat dest_st;
+    if (!record->path || record->size != (long long)src_st->st_size ||
+        record->mtime_sec != (long long)src_st->st_mtim.tv_sec || record->mtime_nsec != src_st->st_mtim.tv_nsec ||
+        stat(dest, &dest_st) != 0 || dest_st.st_size != src_st->st_size) {
+        return 0;
+    }
+    atomic_fetch_add(&journal->skipped, 1);
+    return 1;
+}
+
+void journal_add(journal_t *journal, const char *dest, const struct stat *src_st) {
+    if (strchr(dest, '\n')) {
+        return; // Can't be journaled; copied again on resume
+    }
+
+    char body[4200];
+    int body_len = snprintf(body, sizeof(body), "%lld %lld.%09ld %s\n", (long long)src_st->st_size,
+                            (long long)src_st->st_mtim.tv_sec, (long)src_st->st_mtim.tv_nsec, dest);
+    if (body_len < 0 || (size_t)body_len >= sizeof(body)) {
+        return;
+    }
+    char line[4300];
+    int len = snprintf(line, sizeof(line), "%016llx %s",
+                       (unsigned long long)fnv1a(body, (size_t)body_len - 1), body);
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->used + (size_t)len > sizeof(journal->buffer)) {
+        flush_locked(journal);
+    }
+    memcpy(journal->buffer + journal->used, line, (size_t)len);
+    journal->used += (size_t)len;
+    if (now_ms() - journal->last_flush_ms >= JOURNAL_FLUSH_MS) {
+        flush_locked(journal);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+size_t journal_loaded(const journal_t *journal) {
+    return journal->loaded;
+}
+
+size_t journal_skipped(const journal_t *journal) {
+    return atomic_load(&((journal_t *)journal)->skipped);
+}
@@ -0,0 +1,44 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+// Append-only journal of completed copies, so an interrupted run can be
+// resumed without redoing finished work. Each record holds the destination
+// path and the size and mtime of the source it was copied from, protected
+// by a checksum; a torn last record is ignored when the journal is loaded.
+//
+// Records are buffered and appended in batches: when the buffer fills, once
+// a second has passed since the last append, and on journal_flush(). A crash
+// loses at most the unflushed records, whose files are then copied again.
+//
+// Line format: "<fnv1a64 hex> <size> <mtime sec>.<mtime nsec> <dest path>\n",
+// the checksum covering everything after it.
+
+#define JOURNAL_SUFFIX ".rpc-journal"
+
+typedef struct journal journal_t;
+
+// Opens the journal at path. With resume, earlier records are loaded and
+// new ones appended; otherwise the journal starts empty.
+journal_t *journal_open(const char *path, int resume);
+
+// Flushes and closes. With completed, the journal is deleted: a finished
+// run leaves nothing to resume.
+int journal_close(journal_t *journal, int completed);
+
+// True when a previous run recorded dest as copied from a source with this
+// size and mtime, and dest still has that size
+int journal_done(journal_t *journal, const char *dest, const struct stat *src_st);
+
+// Records a finished copy. Safe to call from worker threads.
+void journal_add(journal_t *journal, const char *dest, const struct stat *src_st);
+
+int journal_flush(journal_t *journal);
+
+// Records loaded from the previous run, and how many files they let skip
+size_t journal_loaded(const journal_t *journal);
+size_t journal_skipped(const journal_t *journal);
+
+#endif // JOURNAL_H
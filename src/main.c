@@ -1,9 +1,29 @@
+// For sigaction
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "adapt.h"
 #include "copy.h"
+#include "discover.h"
+#include "gitstage.h"
+#include "journal.h"
+#include "perf.h"
+#include "roots.h"
+#include "search.h"
+#include "store.h"
+#include "sync.h"
+#include "templates.h"
+#include "throttle.h"
+#include "transform.h"
+#include "walk.h"
 #include "print_utils.h"
 #include "cli_utils.h"
 
@@ -43,7 +63,13 @@ static void print_version(void) {
     cli_print_info("Use 'rpc help' to see available commands and templates");
 }
 
-static int execute_template_operation(const char *template_name, const char *dest) {
+static void print_dry_run_notice(void) {
+    cli_print_panel("Dry Run",
+        "🔍 Nothing was written. Run the same command without --dry-run to install",
+        THEME_INFO);
+}
+
+static int execute_template_operation(const char *template_name, const char *dest, bool dry_run) {
     if (!template_name || !dest) return -1;
     
     // Enhanced operation feedback
@@ -141,7 +167,9 @@ static int execute_template_operation(const char *template_name, const char *des
     printf("\n");
     
     // Enhanced result reporting
-    if (result == 0) {
+    if (result == 0 && dry_run) {
+        print_dry_run_notice();
+    } else if (result == 0) {
         if (cli_supports_color()) {
             printf("  %s %s%sSuccess!%s %s installed to %s%s%s\n", 
                    operation_icon, THEME_SUCCESS, BOLD, RESET,
@@ -173,6 +201,1132 @@ static int execute_template_operation(const char *template_name, const char *des
     return result;
 }
 
+// --io-limit, --iops-limit and --ioprio, shared by init, sync and copy
+typedef struct {
+    long long bytes_per_sec;
+    long long ops_per_sec;
+    const char *ioprio;
+} io_args_t;
+
+// Consumes argv[*i] (and its value) when it is an I/O option. Returns 1 when
+// it was one, 0 when not and -1 when its value is invalid. Values must come
+// before end, so init's trailing destination is never taken as one.
+static int parse_io_option(int end, char *argv[], int *i, io_args_t *io) {
+    static const char *names[] = {"--io-limit", "--iops-limit", "--ioprio"};
+    for (int n = 0; n < 3; n++) {
+        size_t len = strlen(names[n]);
+        const char *value = NULL;
+        if (strcmp(argv[*i], names[n]) == 0 && *i + 1 < end) {
+            value = argv[++*i];
+        } else if (strncmp(argv[*i], names[n], len) == 0 && argv[*i][len] == '=') {
+            value = argv[*i] + len + 1;
+        } else {
+            continue;
+        }
+
+        if (n == 2) {
+            io->ioprio = value;
+            return 1;
+        }
+        return throttle_parse_rate(value, n == 0 ? &io->bytes_per_sec : &io->ops_per_sec) == 0 ? 1 : -1;
+    }
+    return 0;
+}
+
+// Applies --ioprio before any worker starts, so they inherit it, and builds
+// the shared limiter. Returns -1 when the priority is invalid or refused.
+static int apply_io_args(const io_args_t *io, throttle_t **throttle) {
+    int ioprio;
+    if (io->ioprio && throttle_parse_ioprio(io->ioprio, &ioprio) != 0) {
+        cli_print_banner("Error", "Invalid Argument");
+        cli_print_panel("Problem", 
+            "🚫 Expected --ioprio idle, be:N or rt:N with N from 0 to 7", 
+            THEME_ERROR);
+        printf("\n  Argument: %s\n\n", io->ioprio);
+        return -1;
+    }
+    if (io->ioprio && throttle_set_ioprio(ioprio) != 0) {
+        char message[256];
+        snprintf(message, sizeof(message), "🚫 Could not set I/O priority %s: %s%s", io->ioprio, strerror(errno),
+                 errno == EPERM ? " (the rt class needs root or CAP_SYS_ADMIN)" : "");
+        cli_print_banner("Error", "I/O Priority Not Set");
+        cli_print_panel("Problem", message, THEME_ERROR);
+        printf("\n");
+        return -1;
+    }
+    *throttle = throttle_new(io->bytes_per_sec, io->ops_per_sec);
+    return 0;
+}
+
+static void print_io_limits(const throttle_t *throttle, const io_args_t *io) {
+    if (!throttle && !io->ioprio) {
+        return;
+    }
+    char limits[128];
+    throttle_describe(throttle, limits, sizeof(limits));
+    if (cli_supports_color()) {
+        printf("  ⏱  %sI/O limits:%s %s%s%s%s%s\n", THEME_INFO, RESET, THEME_ACCENT, limits,
+               io->ioprio ? ", ioprio " : "", io->ioprio ? io->ioprio : "", RESET);
+    } else {
+        printf("  I/O limits: %s%s%s\n", limits, io->ioprio ? ", ioprio " : "", io->ioprio ? io->ioprio : "");
+    }
+}
+
+static void print_io_waited(const throttle_t *throttle) {
+    if (throttle && throttle_waited_ms(throttle) > 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "Throttled for %.1f s across all workers",
+                 (double)throttle_waited_ms(throttle) / 1000.0);
+        cli_print_step(message);
+    }
+}
+
+// Why some counters are missing, from perf_enable()
+static int perf_error;
+
+static void start_perf_counters(void) {
+    if (perf_enable() < PERF_COUNTER_COUNT) {
+        perf_error = errno;
+    }
+}
+
+// --perf-counters summary: one row per phase that ran, counts summed over
+// all threads
+static void print_perf_counters(void) {
+    if (!perf_enabled()) {
+        return;
+    }
+    cli_print_header("Performance Counters");
+    printf("  %-7s %8s %10s", "phase", "entries", "ms");
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        printf(" %16s", perf_counter_name((perf_counter_t)c));
+    }
+    printf(" %6s\n", "IPC");
+
+    for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+        perf_totals_t totals;
+        perf_totals((perf_phase_t)p, &totals);
+        if (totals.entries == 0) {
+            continue;
+        }
+        printf("  %-7s %8llu %10.1f", perf_phase_name((perf_phase_t)p), totals.entries, totals.ms);
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (perf_available((perf_counter_t)c)) {
+                printf(" %16llu", totals.value[c]);
+            } else {
+                printf(" %16s", "n/a");
+            }
+        }
+        if (perf_available(PERF_CYCLES) && perf_available(PERF_INSTRUCTIONS) && totals.value[PERF_CYCLES] > 0) {
+            printf(" %6.2f\n", (double)totals.value[PERF_INSTRUCTIONS] / (double)totals.value[PERF_CYCLES]);
+        } else {
+            printf(" %6s\n", "n/a");
+        }
+    }
+    printf("\n");
+
+    char message[256];
+    if (perf_error == ENOENT || perf_error == EOPNOTSUPP) {
+        cli_print_info("n/a: this CPU or hypervisor exposes no such counter");
+    } else if (perf_error) {
+        snprintf(message, sizeof(message), "n/a: not permitted (%s); see /proc/sys/kernel/perf_event_paranoid",
+                 strerror(perf_error));
+        cli_print_info(message);
+    }
+    if (perf_multiplexed()) {
+        cli_print_info("Counters were time-shared with other users of the PMU; counts are scaled estimates");
+    }
+}
+
+// --adaptive[=MIN:MAX] and --stats, shared by init and copy
+typedef struct {
+    int adaptive;
+    int min; // 0 for the defaults
+    int max;
+    int stats;
+} concurrency_args_t;
+
+// Same contract as parse_io_option(), for the single argument argv[i]
+static int parse_concurrency_option(char *argv[], int i, concurrency_args_t *args) {
+    if (strcmp(argv[i], "--adaptive") == 0) {
+        args->adaptive = 1;
+        return 1;
+    } else if (strncmp(argv[i], "--adaptive=", 11) == 0) {
+        args->adaptive = 1;
+        return adapt_parse_bounds(argv[i] + 11, &args->min, &args->max) == 0 ? 1 : -1;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+        args->stats = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static void print_invalid_concurrency_option(const char *arg) {
+    cli_print_banner("Error", "Invalid Argument");
+    cli_print_panel("Problem", 
+        "🚫 --adaptive expects MIN:MAX worker bounds with 1 <= MIN <= MAX <= 1024", 
+        THEME_ERROR);
+    printf("\n  Argument: %s\n\n", arg);
+}
+
+// --jobs and --prefetch, shared by init and copy. Same contract as
+// parse_io_option().
+static int parse_count_option(int end, char *argv[], int *i, copy_options_t *options) {
+    static const char *names[] = {"--jobs", "--prefetch"};
+    for (int n = 0; n < 2; n++) {
+        size_t len = strlen(names[n]);
+        const char *value = NULL;
+        if (strcmp(argv[*i], names[n]) == 0 && *i + 1 < end) {
+            value = argv[++*i];
+        } else if (strncmp(argv[*i], names[n], len) == 0 && argv[*i][len] == '=') {
+            value = argv[*i] + len + 1;
+        } else {
+            continue;
+        }
+
+        char *rest;
+        errno = 0;
+        long count = strtol(value, &rest, 10);
+        if (errno != 0 || rest == value || *rest != '\0' || count < 0 || count > 1024) {
+            return -1;
+        }
+        *(n == 0 ? &options->jobs : &options->prefetch) = (int)count;
+        return 1;
+    }
+    return 0;
+}
+
+static void print_invalid_count_option(const char *arg) {
+    cli_print_banner("Error", "Invalid Argument");
+    cli_print_panel("Problem", 
+        "🚫 --jobs and --prefetch expect a whole number from 0 to 1024", 
+        THEME_ERROR);
+    printf("\n  Argument: %s\n\n", arg);
+}
+
+// Starts the controller where --jobs (or one worker per CPU) would have put
+// the workers, and sizes the pool for its upper bound: 1 to four workers per
+// CPU unless bounded. --stats alone measures at the fixed worker count.
+static int apply_concurrency_args(const concurrency_args_t *args, copy_options_t *options) {
+    if (!args->adaptive && !args->stats) {
+        return 0;
+    }
+    int start = options->jobs > 0 ? options->jobs : pool_default_size();
+    int min = start;
+    int max = start;
+    if (args->adaptive) {
+        min = args->min ? args->min : 1;
+        max = args->max ? args->max : (start > pool_default_size() * 4 ? start : pool_default_size() * 4);
+    }
+    options->adapt = adapt_new(min, max, start);
+    if (!options->adapt) {
+        perror("Error starting the concurrency controller");
+        return -1;
+    }
+    options->jobs = max;
+    return 0;
+}
+
+// Decisions shown by --stats; earlier ones are only counted
+#define STATS_DECISIONS 20
+
+static void print_concurrency_stats(adapt_t *adapt, const concurrency_args_t *args) {
+    if (!adapt || !args->stats) {
+        return;
+    }
+    adapt_stats_t stats;
+    adapt_stats(adapt, &stats);
+    cli_print_header("Concurrency");
+    if (adapt_adaptive(adapt)) {
+        printf("  Workers:   adaptive %d-%d, started at %d, ended at %d (low %d, peak %d)\n",
+               stats.min, stats.max, stats.start, stats.limit, stats.low, stats.peak);
+    } else {
+        printf("  Workers:   fixed at %d\n", stats.limit);
+    }
+    double seconds = stats.ms / 1e3;
+    printf("  Copies:    %llu files, %.1f MiB in %.2f s", stats.ops, (double)stats.bytes / (1024.0 * 1024.0), seconds);
+    if (seconds > 0) {
+        printf(" (%.0f files/s, %.1f MiB/s)", (double)stats.ops / seconds,
+               (double)stats.bytes / (1024.0 * 1024.0) / seconds);
+    }
+    printf("\n  Latency:   p50 %.2f ms, p90 %.2f ms, p99 %.2f ms per file\n", stats.p50_ms, stats.p90_ms, stats.p99_ms);
+
+    if (adapt_adaptive(adapt)) {
+        printf("  Decisions: %zu up, %zu down\n", stats.increases, stats.decreases);
+        adapt_decision_t decisions[STATS_DECISIONS];
+        size_t count = adapt_decisions(adapt, decisions, STATS_DECISIONS);
+        if (count > 0) {
+            printf("\n  %9s %9s %9s %9s %9s %9s  %s\n", "ms", "workers", "cost ms", "baseline", "files/s", "MiB/s", "reason");
+        }
+        for (size_t i = 0; i < count; i++) {
+            char change[32];
+            char baseline[32] = "-"; // none before the first interval
+            snprintf(change, sizeof(change), "%d->%d", decisions[i].from, decisions[i].to);
+            if (decisions[i].baseline_ms > 0) {
+                snprintf(baseline, sizeof(baseline), "%.3f", decisions[i].baseline_ms);
+            }
+            printf("  %9.0f %9s %9.3f %9s %9.0f %9.1f  %s\n", decisions[i].at_ms, change, decisions[i].cost_ms,
+                   baseline, decisions[i].ops_per_sec, decisions[i].bytes_per_sec / (1024.0 * 1024.0),
+                   decisions[i].reason);
+        }
+        if (stats.increases + stats.decreases > count) {
+            char message[128];
+            snprintf(message, sizeof(message), "%zu earlier decisions not shown", stats.increases + stats.decreases - count);
+            cli_print_info(message);
+        }
+    }
+    printf("\n");
+}
+
+static void print_invalid_io_option(const char *arg) {
+    cli_print_banner("Error", "Invalid Argument");
+    cli_print_panel("Problem", 
+        "🚫 --io-limit and --iops-limit expect a positive count, optionally with a K, M or G suffix", 
+        THEME_ERROR);
+    printf("\n  Argument: %s\n\n", arg);
+}
+
+// --eol, --bom and --check-utf8, shared by init and copy. Same contract as
+// parse_io_option().
+static int parse_transform_option(int end, char *argv[], int *i, transform_t *transform) {
+    static const char *names[] = {"--eol", "--bom"};
+    if (strcmp(argv[*i], "--check-utf8") == 0) {
+        transform->check_utf8 = 1;
+        return 1;
+    }
+    for (int n = 0; n < 2; n++) {
+        size_t len = strlen(names[n]);
+        const char *value = NULL;
+        if (strcmp(argv[*i], names[n]) == 0 && *i + 1 < end) {
+            value = argv[++*i];
+        } else if (strncmp(argv[*i], names[n], len) == 0 && argv[*i][len] == '=') {
+            value = argv[*i] + len + 1;
+        } else {
+            continue;
+        }
+        int parsed = n == 0 ? transform_parse_eol(value, &transform->eol) : transform_parse_bom(value, &transform->bom);
+        return parsed == 0 ? 1 : -1;
+    }
+    return 0;
+}
+
+static void print_invalid_transform_option(const char *arg) {
+    cli_print_banner("Error", "Invalid Argument");
+    cli_print_panel("Problem", 
+        "🚫 Expected --eol lf, crlf or keep and --bom strip, add or keep", 
+        THEME_ERROR);
+    printf("\n  Argument: %s\n\n", arg);
+}
+
+static int run_sync(int argc, char *argv[]) {
+    sync_options_t options = {0};
+    io_args_t io = {0};
+    const char *source = NULL;
+    const char **dests = calloc((size_t)argc, sizeof(*dests));
+    if (!dests) {
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        int io_option = parse_io_option(argc, argv, &i, &io);
+        if (io_option < 0) {
+            print_invalid_io_option(argv[i]);
+            free(dests);
+            return EXIT_FAILURE;
+        } else if (io_option > 0) {
+            continue;
+        }
+
+        if (strcmp(argv[i], "--watch") == 0) {
+            options.watch = 1;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            options.no_cache = 1;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            options.verbose = 1;
+        } else if (strcmp(argv[i], "--debounce") == 0 && i + 1 < argc) {
+            options.debounce_ms = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--debounce=", 11) == 0) {
+            options.debounce_ms = atoi(argv[i] + 11);
+        } else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            source = argv[++i];
+        } else if (strncmp(argv[i], "--source=", 9) == 0) {
+            source = argv[i] + 9;
+        } else if (argv[i][0] == '-') {
+            cli_print_banner("Error", "Invalid Argument");
+            cli_print_panel("Problem", 
+                "🚫 Expected --watch, --debounce MS, --source DIR, --no-cache, --verbose and destinations", 
+                THEME_ERROR);
+            printf("\n  Argument: %s\n\n", argv[i]);
+            free(dests);
+            return EXIT_FAILURE;
+        } else {
+            dests[options.dest_count++] = argv[i];
+        }
+    }
+
+    if (options.dest_count == 0) {
+        cli_print_banner("Error", "Missing Required Argument");
+        cli_print_panel("Problem", 
+            "🚫 No destination directory specified", 
+            THEME_ERROR);
+        printf("\nCorrect usage: %s sync [--watch] <destination>...\n\n", argv[0]);
+        free(dests);
+        return EXIT_FAILURE;
+    }
+
+    // Without --source, mirror the datadir's prompts and instructions
+    char prompts[1024];
+    char instructions[1024];
+    construct_source_path(prompts, sizeof(prompts), TEMPLATE_PROMPTS_DIR);
+    construct_source_path(instructions, sizeof(instructions), TEMPLATE_INSTRUCTIONS_DIR);
+    sync_root_t datadir_roots[] = {
+        {prompts, TEMPLATE_PROMPTS_DIR},
+        {instructions, TEMPLATE_INSTRUCTIONS_DIR},
+    };
+    sync_root_t source_root = {source, ""};
+
+    options.roots = source ? &source_root : datadir_roots;
+    options.root_count = source ? 1 : 2;
+    options.dests = dests;
+    if (apply_io_args(&io, &options.throttle) != 0) {
+        free(dests);
+        return EXIT_FAILURE;
+    }
+
+    cli_print_banner("Template Sync", options.watch ? "Watching for changes" : "One-shot sync");
+    for (int i = 0; i < options.dest_count; i++) {
+        if (cli_supports_color()) {
+            printf("  %s%sDestination:%s %s%s%s\n", 
+                   ICON_FOLDER, THEME_INFO, RESET, THEME_ACCENT, dests[i], RESET);
+        } else {
+            printf("  Destination: %s\n", dests[i]);
+        }
+    }
+    print_io_limits(options.throttle, &io);
+    printf("\n");
+
+    int result = sync_run(&options);
+    print_io_waited(options.throttle);
+    throttle_free(options.throttle);
+    free(dests);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    copy_cancel();
+}
+
+// rpc copy [--resume] [--journal FILE] <source> <destination>...: copies a
+// tree into each destination, journaling finished files so an interrupted
+// run can pick up where it stopped
+static int run_copy(int argc, char *argv[]) {
+    copy_options_t options = { .prefetch = COPY_DEFAULT_PREFETCH };
+    io_args_t io = {0};
+    concurrency_args_t concurrency = {0};
+    transform_t transform = {0};
+    const char *journal_path = NULL;
+    int resume = 0;
+    int path_count = 0;
+    const char **paths = calloc((size_t)argc, sizeof(*paths));
+    if (!paths) {
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        int io_option = parse_io_option(argc, argv, &i, &io);
+        if (io_option < 0) {
+            print_invalid_io_option(argv[i]);
+            free(paths);
+            return EXIT_FAILURE;
+        } else if (io_option > 0) {
+            continue;
+        }
+        int transform_option = parse_transform_option(argc, argv, &i, &transform);
+        if (transform_option < 0) {
+            print_invalid_transform_option(argv[i]);
+            free(paths);
+            return EXIT_FAILURE;
+        } else if (transform_option > 0) {
+            options.transform = &transform;
+            continue;
+        }
+        int concurrency_option = parse_concurrency_option(argv, i, &concurrency);
+        if (concurrency_option < 0) {
+            print_invalid_concurrency_option(argv[i]);
+            free(paths);
+            return EXIT_FAILURE;
+        } else if (concurrency_option > 0) {
+            continue;
+        }
+        int count_option = parse_count_option(argc, argv, &i, &options);
+        if (count_option < 0) {
+            print_invalid_count_option(argv[i]);
+            free(paths);
+            return EXIT_FAILURE;
+        } else if (count_option > 0) {
+            continue;
+        }
+
+        if (strcmp(argv[i], "--resume") == 0) {
+            resume = 1;
+        } else if (strcmp(argv[i], "--physical-order") == 0) {
+            options.physical_order = 1;
+        } else if (strcmp(argv[i], "--preserve-hardlinks") == 0) {
+            options.preserve_hardlinks = 1;
+        } else if (strcmp(argv[i], "--preserve-symlinks") == 0) {
+            options.preserve_symlinks = 1;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            start_perf_counters();
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            options.no_cache = 1;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            options.verbose = 1;
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strncmp(argv[i], "--journal=", 10) == 0) {
+            journal_path = argv[i] + 10;
+        } else if ((strcmp(argv[i], "--walk-mem") == 0 && i + 1 < argc) || strncmp(argv[i], "--walk-mem=", 11) == 0) {
+            const char *value = argv[i][10] == '=' ? argv[i] + 11 : argv[++i];
+            long long bytes;
+            if (throttle_parse_rate(value, &bytes) != 0 || bytes < WALK_MIN_MEM_LIMIT) {
+                cli_print_banner("Error", "Invalid Argument");
+                cli_print_panel("Problem", 
+                    "🚫 --walk-mem expects a byte count of at least 260K, optionally with a K, M or G suffix", 
+                    THEME_ERROR);
+                printf("\n  Argument: %s\n\n", value);
+                free(paths);
+                return EXIT_FAILURE;
+            }
+            options.walk_mem_limit = (size_t)bytes;
+        } else if (argv[i][0] == '-') {
+            cli_print_banner("Error", "Invalid Argument");
+            cli_print_panel("Problem", 
+                "🚫 Expected --resume, --journal FILE, --jobs N, --prefetch N, --walk-mem BYTES, --physical-order, --preserve-hardlinks, --preserve-symlinks, --adaptive[=MIN:MAX], --stats, --perf-counters, --no-cache, --verbose, a source and destinations", 
+                THEME_ERROR);
+            printf("\n  Argument: %s\n\n", argv[i]);
+            free(paths);
+            return EXIT_FAILURE;
+        } else {
+            paths[path_count++] = argv[i];
+        }
+    }
+
+    if (path_count < 2) {
+        cli_print_banner("Error", "Missing Required Argument");
+        cli_print_panel("Problem", 
+            "🚫 A source and at least one destination directory are required", 
+            THEME_ERROR);
+        printf("\nCorrect usage: %s copy [--resume] <source> <destination>...\n\n", argv[0]);
+        free(paths);
+        return EXIT_FAILURE;
+    }
+
+    // By default the journal sits next to the first destination
+    char default_journal[1024];
+    if (!journal_path) {
+        size_t len = strlen(paths[1]);
+        while (len > 1 && paths[1][len - 1] == '/') {
+            len--;
+        }
+        snprintf(default_journal, sizeof(default_journal), "%.*s%s", (int)len, paths[1], JOURNAL_SUFFIX);
+        journal_path = default_journal;
+    }
+    if (apply_io_args(&io, &options.throttle) != 0) {
+        free(paths);
+        return EXIT_FAILURE;
+    }
+    if (apply_concurrency_args(&concurrency, &options) != 0) {
+        throttle_free(options.throttle);
+        free(paths);
+        return EXIT_FAILURE;
+    }
+    options.journal = journal_open(journal_path, resume);
+    if (!options.journal) {
+        throttle_free(options.throttle);
+        adapt_free(options.adapt);
+        free(paths);
+        return EXIT_FAILURE;
+    }
+
+    // Stop cleanly on the first signal; a second one terminates at once
+    struct sigaction action = { .sa_handler = handle_stop_signal, .sa_flags = SA_RESETHAND };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    cli_print_banner("Copy", resume ? "Resuming from the journal" : paths[0]);
+    print_io_limits(options.throttle, &io);
+    char message[1200];
+    if (resume) {
+        snprintf(message, sizeof(message), "Loaded %zu finished files from %s",
+                 journal_loaded(options.journal), journal_path);
+        cli_print_step(message);
+    }
+
+    int result = 0;
+    for (int i = 1; i < path_count && !copy_cancelled(); i++) {
+        if (copy_directory_with(&options, paths[0], paths[i], NULL) != 0) {
+            result = -1;
+        }
+    }
+    printf("\n");
+
+    print_io_waited(options.throttle);
+    throttle_free(options.throttle);
+    print_perf_counters();
+    print_concurrency_stats(options.adapt, &concurrency);
+    adapt_free(options.adapt);
+    if (journal_skipped(options.journal) > 0) {
+        snprintf(message, sizeof(message), "Skipped %zu files already copied", journal_skipped(options.journal));
+        cli_print_step(message);
+    }
+
+    if (copy_cancelled()) {
+        journal_close(options.journal, 0);
+        snprintf(message, sizeof(message), "⏸ Interrupted. Finished files are recorded in %s; rerun with --resume to continue",
+                 journal_path);
+        cli_print_panel("Stopped", message, THEME_WARNING);
+        free(paths);
+        return 130;
+    }
+
+    // Only a complete copy leaves no journal behind
+    if (journal_close(options.journal, result == 0) != 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        cli_print_success("Copy complete");
+    } else {
+        snprintf(message, sizeof(message), "🔧 Some files failed; rerun with --resume to retry only those (journal: %s)",
+                 journal_path);
+        cli_print_panel("Troubleshooting", message, THEME_WARNING);
+    }
+    free(paths);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Resolves a template argument to files under the datadir: a set name as
+// taken by init ("security" or "--security"), which selects its prompt
+// and/or instructions, or the file name of either half
+static int resolve_cat_name(const char *name, int halves, char paths[2][512]) {
+    const char *bare = strncmp(name, "--", 2) == 0 ? name + 2 : name;
+    const template_set_t *set = template_set_find(bare);
+    int count = 0;
+    if (set) {
+        if (halves & 1) {
+            snprintf(paths[count++], 512, "%s/%s", TEMPLATE_PROMPTS_DIR, set->prompt);
+        }
+        if (halves & 2) {
+            snprintf(paths[count++], 512, "%s/%s", TEMPLATE_INSTRUCTIONS_DIR, set->instructions);
+        }
+        return count;
+    }
+    for (int i = 0; i < template_set_count; i++) {
+        if (strcmp(template_sets[i].prompt, name) == 0) {
+            snprintf(paths[0], 512, "%s/%s", TEMPLATE_PROMPTS_DIR, name);
+            return 1;
+        }
+        if (strcmp(template_sets[i].instructions, name) == 0) {
+            snprintf(paths[0], 512, "%s/%s", TEMPLATE_INSTRUCTIONS_DIR, name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// rpc cat | show [--prompt | --instructions] [--pin VERSION] <template>...:
+// writes templates to stdout; show puts a header above each file
+static int run_cat(int argc, char *argv[], int headers) {
+    copy_options_t options = {0};
+    int halves = 0; // 1 prompt, 2 instructions, 0 both
+    const char **names = calloc((size_t)argc, sizeof(*names));
+    int name_count = 0;
+    if (!names) {
+        return EXIT_FAILURE;
+    }
+
+    int usage = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--prompt") == 0) {
+            halves |= 1;
+        } else if (strcmp(argv[i], "--instructions") == 0) {
+            halves |= 2;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            if (i + 1 >= argc) {
+                usage = 1;
+                break;
+            }
+            options.template_version = argv[++i];
+        } else if (strncmp(argv[i], "--pin=", 6) == 0) {
+            options.template_version = argv[i] + 6;
+        } else {
+            names[name_count++] = argv[i];
+        }
+    }
+    if (usage || name_count == 0) {
+        fprintf(stderr, "Correct usage: %s %s [--prompt | --instructions] [--pin VERSION] <template>...\n",
+                argv[0], argv[1]);
+        free(names);
+        return EXIT_FAILURE;
+    }
+    if (halves == 0) {
+        halves = 3;
+    }
+
+    int result = EXIT_SUCCESS;
+    int shown = 0;
+    for (int n = 0; n < name_count; n++) {
+        char paths[2][512];
+        int count = resolve_cat_name(names[n], halves, paths);
+        if (count == 0) {
+            fprintf(stderr, "Unknown template '%s'; see 'rpc help' for the template names\n", names[n]);
+            result = EXIT_FAILURE;
+        }
+        for (int p = 0; p < count; p++) {
+            if (headers) {
+                printf("%s==> %s <==\n", shown++ > 0 ? "\n" : "", paths[p]);
+            }
+            // Anything stdio buffered has to reach the fd before the kernel copy
+            fflush(stdout);
+            if (copy_template_to_fd(&options, paths[p], STDOUT_FILENO) != 0) {
+                result = EXIT_FAILURE;
+            }
+        }
+    }
+    free(names);
+    return result;
+}
+
+#define SEARCH_MAX_RESULTS 10
+
+// rpc search <query>...: ranks the template options against the index
+// compiled into rpc
+static int run_search(int argc, char *argv[]) {
+    char query[1024] = "";
+    for (int i = 2; i < argc; i++) {
+        size_t len = strlen(query);
+        snprintf(query + len, sizeof(query) - len, "%s%s", len ? " " : "", argv[i]);
+    }
+    if (query[0] == '\0') {
+        fprintf(stderr, "Correct usage: %s search <query>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    search_hit_t hits[SEARCH_MAX_RESULTS];
+    int count = search_query(&search_index, query, hits, SEARCH_MAX_RESULTS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double micros = (double)(end.tv_sec - start.tv_sec) * 1e6 + (double)(end.tv_nsec - start.tv_nsec) / 1e3;
+
+    cli_print_banner("Template Search", query);
+    if (count == 0) {
+        cli_print_info("No template matches; 'rpc help' lists them all");
+        printf("\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; i++) {
+        const template_info_t *info = &help_templates[hits[i].doc];
+        if (cli_supports_color()) {
+            printf("  %s %s%-18s%s %s%-20s%s %s%s%s\n", info->icon, THEME_SUCCESS, info->flag, RESET,
+                   BOLD, info->name, RESET, THEME_MUTED, info->description, RESET);
+        } else {
+            printf("  %-18s %-20s %s\n", info->flag, info->name, info->description);
+        }
+    }
+    printf("\n");
+
+    char message[256];
+    snprintf(message, sizeof(message), "%d of %d templates matched in %.0f µs; install one with 'rpc init %s <destination>'",
+             count, search_index.doc_count, micros, help_templates[hits[0].doc].flag);
+    cli_print_info(message);
+    return EXIT_SUCCESS;
+}
+
+// rpc roots: lists the overlay roots and the templates they replace
+static int run_roots(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Correct usage: %s roots\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    cli_print_banner("Template Roots", "Overlays on top of the datadir, lowest priority first");
+    int count = roots_count();
+    if (count == 0) {
+        cli_print_info("No overlay roots; REPLICA_TEMPLATE_PATH is empty");
+        printf("\n");
+        return EXIT_SUCCESS;
+    }
+    for (int r = 0; r < count; r++) {
+        size_t files = 0;
+        for (size_t e = 0; e < roots_entry_count(); e++) {
+            int root;
+            roots_entry_at(e, &root);
+            files += root == r;
+        }
+        if (cli_supports_color()) {
+            printf("  %s%-40s%s %s%zu files%s\n", THEME_ACCENT, roots_path(r), RESET, THEME_MUTED, files, RESET);
+        } else {
+            printf("  %-40s %zu files\n", roots_path(r), files);
+        }
+    }
+    printf("\n");
+
+    for (size_t e = 0; e < roots_entry_count(); e++) {
+        int root;
+        const char *sub_path = roots_entry_at(e, &root);
+        printf("  %s  <- %s\n", sub_path, roots_path(root));
+    }
+    if (roots_entry_count() > 0) {
+        printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
+
+static void print_store_version(const char *version, void *ctx) {
+    const char *store_root = ctx;
+    char current[STORE_VERSION_MAX];
+    int is_current = store_current(store_root, current, sizeof(current)) == 0 && strcmp(current, version) == 0;
+    const store_manifest_t *manifest = store_manifest_get(store_root, version);
+    size_t files = manifest ? store_manifest_count(manifest) : 0;
+
+    if (cli_supports_color()) {
+        printf("  %s%s%s%s  %s%zu files%s%s\n", is_current ? THEME_SUCCESS : THEME_ACCENT, is_current ? "* " : "  ",
+               version, RESET, THEME_MUTED, files, RESET, is_current ? "  (current)" : "");
+    } else {
+        printf("  %s%s  %zu files%s\n", is_current ? "* " : "  ", version, files, is_current ? "  (current)" : "");
+    }
+}
+
+// rpc store list | add VERSION [DIR] [--use] | use VERSION, with --store DIR
+// selecting another store than the datadir's
+static int run_store(int argc, char *argv[]) {
+    const char *store_root = store_default_root();
+    const char *args[3] = {NULL, NULL, NULL};
+    int arg_count = 0;
+    int use = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--use") == 0) {
+            use = 1;
+        } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store_root = argv[++i];
+        } else if (strncmp(argv[i], "--store=", 8) == 0) {
+            store_root = argv[i] + 8;
+        } else if (argv[i][0] != '-' && arg_count < 3) {
+            args[arg_count++] = argv[i];
+        } else {
+            arg_count = -1;
+            break;
+        }
+    }
+
+    const char *action = arg_count > 0 ? args[0] : "list";
+    int valid = arg_count >= 0 &&
+                ((strcmp(action, "list") == 0 && arg_count <= 1) ||
+                 (strcmp(action, "add") == 0 && (arg_count == 2 || arg_count == 3)) ||
+                 (strcmp(action, "use") == 0 && arg_count == 2 && !use));
+    if (!valid) {
+        cli_print_banner("Error", "Invalid Argument");
+        cli_print_panel("Problem",
+            "🚫 Expected 'store list', 'store add VERSION [DIR] [--use]' or 'store use VERSION'",
+            THEME_ERROR);
+        printf("\n");
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(action, "list") == 0) {
+        cli_print_banner("Template Store", store_root);
+        if (store_list(store_root, print_store_version, (void *)store_root) != 0) {
+            cli_print_info("The store is empty; add a version with 'rpc store add VERSION [DIR]'");
+        }
+        printf("\n");
+        return EXIT_SUCCESS;
+    }
+
+    char message[512];
+    if (strcmp(action, "add") == 0) {
+        char datadir[1024];
+        construct_source_path(datadir, sizeof(datadir), "");
+        int added = store_import(store_root, args[1], arg_count == 3 ? args[2] : datadir);
+        if (added < 0) {
+            return EXIT_FAILURE;
+        }
+        snprintf(message, sizeof(message), "Added version %s (%d new objects)", args[1], added);
+        cli_print_step(message);
+        if (!use) {
+            return EXIT_SUCCESS;
+        }
+    }
+
+    if (store_use(store_root, args[1]) != 0) {
+        return EXIT_FAILURE;
+    }
+    snprintf(message, sizeof(message), "Current template version is now %s", args[1]);
+    cli_print_step(message);
+    return EXIT_SUCCESS;
+}
+
+// Files an install wrote, collected for --git-stage. on_file may run on
+// worker threads.
+typedef struct {
+    pthread_mutex_t lock;
+    char **paths;
+    size_t count;
+    size_t cap;
+    int failed; // a path could not be recorded
+} installed_files_t;
+
+static void add_installed_file(installed_files_t *files, const char *path) {
+    pthread_mutex_lock(&files->lock);
+    if (files->count == files->cap) {
+        size_t cap = files->cap ? files->cap * 2 : 64;
+        char **paths = realloc(files->paths, cap * sizeof(char *));
+        if (paths) {
+            files->paths = paths;
+            files->cap = cap;
+        }
+    }
+    char *copy = files->count < files->cap ? strdup(path) : NULL;
+    if (copy) {
+        files->paths[files->count++] = copy;
+    } else {
+        files->failed = 1;
+    }
+    pthread_mutex_unlock(&files->lock);
+}
+
+static void free_installed_files(installed_files_t *files) {
+    for (size_t i = 0; i < files->count; i++) {
+        free(files->paths[i]);
+    }
+    free(files->paths);
+    pthread_mutex_destroy(&files->lock);
+}
+
+// Records the file and prints the step line copy would have printed
+static void collect_installed_file(const char *path, int error, void *tag, void *ctx) {
+    (void)tag;
+    if (error) {
+        return;
+    }
+    add_installed_file(ctx, path);
+    char message[512];
+    const char *slash = strrchr(path, '/');
+    snprintf(message, sizeof(message), "Copied '%s'", slash ? slash + 1 : path);
+    cli_print_step(message);
+}
+
+// --git-stage: adds what an install wrote to the index of the repository
+// around dest, so no `git add` has to refresh it
+static int stage_installed_files(const char *dest, installed_files_t *files) {
+    git_stage_stats_t stats;
+    if (files->failed || git_stage_paths(dest, (const char *const *)files->paths, files->count, &stats) != 0) {
+        cli_print_panel("Not Staged", "🔧 The templates are installed but not staged; add them with git add",
+                        THEME_WARNING);
+        return -1;
+    }
+    char message[256];
+    int len = snprintf(message, sizeof(message), "Staged %zu files in the git index, %zu already up to date",
+                       stats.staged, stats.unchanged);
+    if (stats.skipped > 0 && len > 0 && (size_t)len < sizeof(message)) {
+        snprintf(message + len, sizeof(message) - (size_t)len, ", %zu outside the work tree", stats.skipped);
+    }
+    cli_print_step(message);
+    return 0;
+}
+
+typedef struct {
+    pool_t *pool;           // runs the walk and the installs
+    copy_options_t options; // per repository; runs inline on its worker
+    const template_set_t **sets;
+    int set_count;
+    int git_stage;          // stage each repository's files in its own index
+    pthread_mutex_t lock;   // keeps report lines whole
+    size_t installed;
+    size_t failed;
+    size_t files;
+    size_t staged;
+} bulk_init_t;
+
+typedef struct {
+    bulk_init_t *bulk;
+    size_t files;
+    int error;
+    installed_files_t written; // for --git-stage
+    char repo[];
+} repo_install_t;
+
+static void count_repo_file(const char *path, int error, void *tag, void *ctx) {
+    (void)ctx;
+    repo_install_t *install = tag;
+    if (!error) {
+        install->files++;
+        if (install->bulk->git_stage) {
+            add_installed_file(&install->written, path);
+        }
+    } else if (!install->error) {
+        install->error = error;
+    }
+}
+
+static void install_repo_task(void *arg) {
+    repo_install_t *install = arg;
+    bulk_init_t *bulk = install->bulk;
+
+    int result = 0;
+    if (!bulk->options.dry_run) {
+        copy_request_t requests[64];
+        int count = 0;
+        for (int i = 0; i < bulk->set_count && count < 64; i++) {
+            requests[count++] = (copy_request_t){ .set = bulk->sets[i], .dest = install->repo, .tag = install };
+        }
+        result = copy_templates_with(&bulk->options, requests, count);
+    }
+    git_stage_stats_t stats = {0};
+    int staged = 0;
+    if (result == 0 && bulk->git_stage && !bulk->options.dry_run) {
+        staged = !install->written.failed &&
+                 git_stage_paths(install->repo, (const char *const *)install->written.paths, install->written.count,
+                                 &stats) == 0 ? 1 : -1;
+    }
+    free_installed_files(&install->written);
+
+    pthread_mutex_lock(&bulk->lock);
+    if (result == 0) {
+        bulk->files += install->files;
+        bulk->staged += stats.staged;
+    }
+    if (result == 0 && staged >= 0) {
+        bulk->installed++;
+        if (cli_supports_color()) {
+            printf("  %s%s%s %s\n", THEME_SUCCESS, ICON_CHECK, RESET, install->repo);
+        } else {
+            printf("  %s %s\n", ICON_CHECK, install->repo);
+        }
+    } else {
+        bulk->failed++;
+        const char *reason = result == 0 ? "installed, not staged" : strerror(install->error ? install->error : EIO);
+        if (cli_supports_color()) {
+            printf("  %s%s %s%s %s(%s)%s\n", THEME_ERROR, ICON_CROSS, install->repo, RESET, THEME_MUTED, reason, RESET);
+        } else {
+            printf("  %s %s (%s)\n", ICON_CROSS, install->repo, reason);
+        }
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&bulk->lock);
+    free(install);
+}
+
+// Each repository gets its install queued on the walk's pool the moment it
+// is found, so installs overlap with the rest of the walk
+static void schedule_repo_install(const char *repo, void *ctx) {
+    bulk_init_t *bulk = ctx;
+    size_t len = strlen(repo) + 1;
+    repo_install_t *install = calloc(1, sizeof(repo_install_t) + len);
+    if (!install) {
+        pthread_mutex_lock(&bulk->lock);
+        bulk->failed++;
+        pthread_mutex_unlock(&bulk->lock);
+        return;
+    }
+    install->bulk = bulk;
+    pthread_mutex_init(&install->written.lock, NULL);
+    memcpy(install->repo, repo, len);
+    if (pool_submit(bulk->pool, install_repo_task, install) != 0) {
+        install_repo_task(install);
+    }
+}
+
+// rpc init [--<template>] --recursive <root>: installs into every git
+// repository under root
+static int run_recursive_init(const char *root, const char *option, const copy_options_t *options, int git_stage) {
+    const template_set_t *sets[64];
+    int set_count = 0;
+    const char *name = option ? option + strspn(option, "-") : NULL;
+    if (!name) {
+        sets[set_count++] = template_set_find("readme");
+        sets[set_count++] = template_set_find("release-notes");
+    } else if (strcmp(name, "all") == 0) {
+        for (int i = 0; i < template_set_count && i < 64; i++) {
+            sets[set_count++] = &template_sets[i];
+        }
+    } else if (template_set_find(name)) {
+        sets[set_count++] = template_set_find(name);
+    } else {
+        cli_print_banner("Error", "Unknown Template Option");
+        printf("\n  Unknown option: %s\n\n", option);
+        cli_print_info("Use 'rpc help' to see all available template options");
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        cli_print_banner("Error", "Invalid Destination");
+        cli_print_panel("Problem", "🚫 --recursive needs an existing directory to search", THEME_ERROR);
+        printf("\n  Path: %s\n\n", root);
+        return EXIT_FAILURE;
+    }
+
+    pool_t *pool = pool_new(options->jobs);
+    if (!pool) {
+        perror("Error starting workers");
+        return EXIT_FAILURE;
+    }
+
+    // Per-repository installs run inline on their worker: waiting on the
+    // shared pool from inside one of its tasks would never return
+    bulk_init_t bulk = {
+        .pool = pool,
+        .options = *options,
+        .sets = sets,
+        .set_count = set_count,
+    };
+    bulk.options.jobs = 1;
+    bulk.options.pool = NULL;
+    bulk.options.on_file = count_repo_file;
+    bulk.options.event_ctx = &bulk;
+    bulk.git_stage = git_stage;
+    pthread_mutex_init(&bulk.lock, NULL);
+
+    char subtitle[1200];
+    snprintf(subtitle, sizeof(subtitle), "%s into every repository under %s%s",
+             option ? option : "README + Release Notes", root, options->dry_run ? " (dry run)" : "");
+    cli_print_banner("Template Initialization", subtitle);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    discover_stats_t stats = {0};
+    int walked = discover_repos(pool, root, schedule_repo_install, &bulk, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pool_free(pool);
+    pthread_mutex_destroy(&bulk.lock);
+    if (stats.dirs == 0) {
+        printf("\n");
+        return EXIT_FAILURE; // root itself could not be read
+    }
+
+    double ms = (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    char message[256];
+    printf("\n");
+    snprintf(message, sizeof(message), "Scanned %zu directories (%zu pruned) and found %zu repositories in %.0f ms",
+             stats.dirs, stats.pruned, stats.repos, ms);
+    cli_print_step(message);
+    if (options->dry_run) {
+        print_dry_run_notice();
+    } else {
+        snprintf(message, sizeof(message), "Installed %zu files into %zu repositories, %zu failed",
+                 bulk.files, bulk.installed, bulk.failed);
+        cli_print_step(message);
+        if (git_stage) {
+            snprintf(message, sizeof(message), "Staged %zu changed files in their repositories' indexes", bulk.staged);
+            cli_print_step(message);
+        }
+    }
+    return walked == 0 && bulk.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[]) {
     // Handle help and version commands
     if (argc < 2 || strcmp(argv[1], "help") == 0 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
@@ -185,6 +1339,30 @@ int main(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    if (strcmp(argv[1], "sync") == 0) {
+        return run_sync(argc, argv);
+    }
+
+    if (strcmp(argv[1], "store") == 0) {
+        return run_store(argc, argv);
+    }
+
+    if (strcmp(argv[1], "copy") == 0) {
+        return run_copy(argc, argv);
+    }
+
+    if (strcmp(argv[1], "search") == 0) {
+        return run_search(argc, argv);
+    }
+
+    if (strcmp(argv[1], "roots") == 0) {
+        return run_roots(argc, argv);
+    }
+
+    if (strcmp(argv[1], "cat") == 0 || strcmp(argv[1], "show") == 0) {
+        return run_cat(argc, argv, strcmp(argv[1], "show") == 0);
+    }
+
     if (strcmp(argv[1], "init") == 0) {
         if (argc < 3) {
             cli_print_banner("Error", "Missing Required Argument");
@@ -211,6 +1389,131 @@ int main(int argc, char *argv[]) {
         }
         
         const char *dest = argv[argc - 1];
+        const char *option = NULL;
+        render_vars_t vars = {0};
+        copy_options_t options = { .vars = &vars };
+        io_args_t io = {0};
+        concurrency_args_t concurrency = {0};
+        transform_t transform = {0};
+        installed_files_t installed = { .lock = PTHREAD_MUTEX_INITIALIZER };
+        int recursive = 0;
+        int git_stage = 0;
+        
+        // Collect --set key=value pairs and flags; anything else is the template option
+        for (int i = 2; i < argc - 1; i++) {
+            const char *assignment = NULL;
+            int io_option = parse_io_option(argc - 1, argv, &i, &io);
+            if (io_option < 0) {
+                print_invalid_io_option(argv[i]);
+                return EXIT_FAILURE;
+            } else if (io_option > 0) {
+                continue;
+            }
+            int transform_option = parse_transform_option(argc - 1, argv, &i, &transform);
+            if (transform_option < 0) {
+                print_invalid_transform_option(argv[i]);
+                return EXIT_FAILURE;
+            } else if (transform_option > 0) {
+                options.transform = &transform;
+                continue;
+            }
+            int concurrency_option = parse_concurrency_option(argv, i, &concurrency);
+            if (concurrency_option < 0) {
+                print_invalid_concurrency_option(argv[i]);
+                return EXIT_FAILURE;
+            } else if (concurrency_option > 0) {
+                continue;
+            }
+            int count_option = parse_count_option(argc - 1, argv, &i, &options);
+            if (count_option < 0) {
+                print_invalid_count_option(argv[i]);
+                return EXIT_FAILURE;
+            } else if (count_option > 0) {
+                continue;
+            }
+
+            if (strcmp(argv[i], "--dry-run") == 0) {
+                options.dry_run = 1;
+                continue;
+            } else if (strcmp(argv[i], "--recursive") == 0) {
+                recursive = 1;
+                continue;
+            } else if (strcmp(argv[i], "--git-stage") == 0) {
+                git_stage = 1;
+                continue;
+            } else if (strcmp(argv[i], "--no-cache") == 0) {
+                options.no_cache = 1;
+                continue;
+            } else if (strcmp(argv[i], "--verbose") == 0) {
+                options.verbose = 1;
+                continue;
+            } else if (strcmp(argv[i], "--perf-counters") == 0) {
+                start_perf_counters();
+                continue;
+            } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc - 1) {
+                options.template_version = argv[++i];
+                continue;
+            } else if (strncmp(argv[i], "--pin=", 6) == 0) {
+                options.template_version = argv[i] + 6;
+                continue;
+            } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc - 1) {
+                assignment = argv[++i];
+            } else if (strncmp(argv[i], "--set=", 6) == 0) {
+                assignment = argv[i] + 6;
+            } else if (!option && strcmp(argv[i], "--set") != 0) {
+                option = argv[i];
+                continue;
+            }
+            
+            if (!assignment || render_vars_add(&vars, assignment) != 0) {
+                cli_print_banner("Error", "Invalid Argument");
+                cli_print_panel("Problem", 
+                    "🚫 Expected a single template option and --set key=value variables", 
+                    THEME_ERROR);
+                printf("\n");
+                
+                if (cli_supports_color()) {
+                    printf("  %s%sArgument:%s %s%s%s\n\n", 
+                           ICON_CROSS, THEME_ERROR, RESET, THEME_ACCENT, assignment ? assignment : argv[i], RESET);
+                } else {
+                    printf("  Argument: %s\n\n", assignment ? assignment : argv[i]);
+                }
+                
+                cli_print_info("Use 'rpc help' to see all available template options");
+                return EXIT_FAILURE;
+            }
+        }
+        
+        if (apply_io_args(&io, &options.throttle) != 0) {
+            return EXIT_FAILURE;
+        }
+        if (apply_concurrency_args(&concurrency, &options) != 0) {
+            throttle_free(options.throttle);
+            return EXIT_FAILURE;
+        }
+        if (git_stage && !recursive && !options.dry_run) {
+            options.on_file = collect_installed_file;
+            options.event_ctx = &installed;
+        }
+        copy_set_options(&options);
+
+        if (options.template_version && !store_manifest_get(store_default_root(), options.template_version)) {
+            cli_print_banner("Error", "Unknown Template Version");
+            cli_print_panel("Problem", 
+                "🚫 The pinned version is not in the template store; see 'rpc store list'", 
+                THEME_ERROR);
+            printf("\n  Version: %s\n\n", options.template_version);
+            return EXIT_FAILURE;
+        }
+
+        if (recursive) {
+            int result = run_recursive_init(dest, option, &options, git_stage);
+            throttle_free(options.throttle);
+            print_perf_counters();
+            print_concurrency_stats(options.adapt, &concurrency);
+            adapt_free(options.adapt);
+            return result;
+        }
         
         // Enhanced destination validation
         struct stat st = {0};
@@ -238,13 +1541,17 @@ int main(int argc, char *argv[]) {
         if (cli_supports_color()) {
             printf("  %s%sDestination:%s %s%s%s\n", 
                    ICON_FOLDER, THEME_INFO, RESET, THEME_ACCENT, dest, RESET);
-            printf("  %s%sMode:%s ", ICON_GEAR, THEME_INFO, RESET);
         } else {
             printf("  Destination: %s\n", dest);
+        }
+        print_io_limits(options.throttle, &io);
+        if (cli_supports_color()) {
+            printf("  %s%sMode:%s ", ICON_GEAR, THEME_INFO, RESET);
+        } else {
             printf("  Mode: ");
         }
 
-        if (argc == 3) {
+        if (!option) {
             // Default operation with enhanced feedback
             if (cli_supports_color()) {
                 printf("%sQuick Start%s (README + Release Notes)\n\n", THEME_SUCCESS, RESET);
@@ -262,8 +1569,15 @@ int main(int argc, char *argv[]) {
             int r2 = copy_release_notes(dest);
             
             printf("\n");
+            int staged = 0;
+            if (r1 == 0 && r2 == 0 && options.on_file == collect_installed_file) {
+                staged = stage_installed_files(dest, &installed);
+            }
+            free_installed_files(&installed);
             
-            if (r1 == 0 && r2 == 0) {
+            if (r1 == 0 && r2 == 0 && options.dry_run) {
+                print_dry_run_notice();
+            } else if (r1 == 0 && r2 == 0) {
                 if (cli_supports_color()) {
                     printf("  %s %s%sSuccess!%s Essential templates installed successfully\n", 
                            ICON_THUMBS_UP, THEME_SUCCESS, BOLD, RESET);
@@ -293,11 +1607,11 @@ int main(int argc, char *argv[]) {
                     THEME_ERROR);
             }
             
-            return (r1 == 0 && r2 == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
-        } else if (argc == 4) {
+            print_perf_counters();
+            print_concurrency_stats(options.adapt, &concurrency);
+            return (r1 == 0 && r2 == 0 && staged == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
             // Specific template operation
-            const char *option = argv[2];
-            
             if (cli_supports_color()) {
                 printf("%sSpecific Template%s (%s)\n\n", THEME_WARNING, RESET, option);
             } else {
@@ -312,7 +1626,12 @@ int main(int argc, char *argv[]) {
                 template_name += 1;
             }
             
-            int result = execute_template_operation(template_name, dest);
+            int result = execute_template_operation(template_name, dest, options.dry_run);
+            int staged = 0;
+            if (result == 0 && options.on_file == collect_installed_file) {
+                staged = stage_installed_files(dest, &installed);
+            }
+            free_installed_files(&installed);
             
             if (result != 0) {
                 cli_print_banner("Error", "Unknown Template Option");
@@ -333,7 +1652,9 @@ int main(int argc, char *argv[]) {
                 return EXIT_FAILURE;
             }
             
-            return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            print_perf_counters();
+            print_concurrency_stats(options.adapt, &concurrency);
+            return result == 0 && staged == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
         }
     }
 
@@ -357,11 +1678,23 @@ int main(int argc, char *argv[]) {
     if (cli_supports_color()) {
         printf("  %s%sAvailable commands:%s\n", ICON_GEAR, THEME_SUCCESS, RESET);
         cli_print_tree_item("init - Initialize templates in a directory", 1, false);
+        cli_print_tree_item("sync - Keep directories in sync with the templates", 1, false);
+        cli_print_tree_item("copy - Copy a directory tree, resumable after interruption", 1, false);
+        cli_print_tree_item("cat - Write templates to stdout (show adds headers)", 1, false);
+        cli_print_tree_item("search - Find templates by name, description or contents", 1, false);
+        cli_print_tree_item("roots - List the template overlay roots", 1, false);
+        cli_print_tree_item("store - List, add and select versions in the template store", 1, false);
         cli_print_tree_item("help - Show help information", 1, false);
         cli_print_tree_item("version - Show version information", 1, true);
     } else {
         printf("  Available commands:\n");
         printf("    - init     Initialize templates\n");
+        printf("    - sync     Keep directories in sync with the templates\n");
+        printf("    - copy     Copy a directory tree, resumable after interruption\n");
+        printf("    - cat      Write templates to stdout (show adds headers)\n");
+        printf("    - search   Find templates by name, description or contents\n");
+        printf("    - roots    List the template overlay roots\n");
+        printf("    - store    List, add and select versions in the template store\n");
         printf("    - help     Show help information\n");
         printf("    - version  Show version information\n");
     }
@@ -0,0 +1,286 @@
+// For mmap and MAP_FAILED
+#define _POSIX_C_SOURCE 200809L
+
+#include "pack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef REPLICA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef REPLICA_PACK_PATH
+#ifdef REPLICA_DATADIR
+#define REPLICA_PACK_PATH REPLICA_DATADIR "/" PACK_FILE_NAME
+#else
+#define REPLICA_PACK_PATH "./" PACK_FILE_NAME
+#endif
+#endif
+
+struct pack {
+    const unsigned char *map;
+    size_t map_size;
+    pack_entry_t *entries;
+    size_t entry_count;
+#ifdef REPLICA_HAVE_ZSTD
+    ZSTD_DDict *ddict;
+#endif
+};
+
+#ifdef REPLICA_HAVE_ZSTD
+
+static uint32_t read_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t read_u64(const unsigned char *p) {
+    return (uint64_t)read_u32(p) | (uint64_t)read_u32(p + 4) << 32;
+}
+
+static int pack_parse(pack_t *pack) {
+    const unsigned char *p = pack->map;
+    size_t size = pack->map_size;
+
+    if (size < PACK_HEADER_SIZE || memcmp(p, PACK_MAGIC, 8) != 0) {
+        return -1;
+    }
+    if (read_u32(p + 8) != PACK_VERSION) {
+        return -1;
+    }
+
+    uint32_t count = read_u32(p + 12);
+    uint32_t dict_size = read_u32(p + 16);
+    uint32_t names_size = read_u32(p + 20);
+
+    size_t dict_off = PACK_HEADER_SIZE;
+    size_t entries_off = dict_off + dict_size;
+    size_t names_off = entries_off + (size_t)count * PACK_ENTRY_SIZE;
+    if (names_off + names_size > size || (names_size > 0 && p[names_off + names_size - 1] != '\0')) {
+        return -1;
+    }
+
+    pack->entries = calloc(count ? count : 1, sizeof(pack_entry_t));
+    if (!pack->entries) {
+        return -1;
+    }
+    pack->entry_count = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *e = p + entries_off + (size_t)i * PACK_ENTRY_SIZE;
+        uint32_t name_off = read_u32(e);
+        pack_entry_t *entry = &pack->entries[i];
+
+        entry->flags = read_u32(e + 4);
+        entry->frame_offset = read_u64(e + 8);
+        entry->frame_size = read_u64(e + 16);
+        entry->raw_size = read_u64(e + 24);
+
+        if (name_off >= names_size || entry->frame_offset > size || entry->frame_size > size - entry->frame_offset) {
+            return -1;
+        }
+        entry->name = (const char *)p + names_off + name_off;
+    }
+
+    if (dict_size > 0) {
+        pack->ddict = ZSTD_createDDict(p + dict_off, dict_size);
+        if (!pack->ddict) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+pack_t *pack_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < PACK_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    pack_t *pack = calloc(1, sizeof(*pack));
+    if (!pack) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    pack->map = map;
+    pack->map_size = (size_t)st.st_size;
+
+    if (pack_parse(pack) != 0) {
+        fprintf(stderr, "Ignoring corrupt template pack: %s\n", path);
+        pack_close(pack);
+        return NULL;
+    }
+    return pack;
+}
+
+void pack_close(pack_t *pack) {
+    if (!pack) return;
+    ZSTD_freeDDict(pack->ddict);
+    free(pack->entries);
+    munmap((void *)pack->map, pack->map_size);
+    free(pack);
+}
+
+// One decompression context per thread, reused across entries and packs;
+// install plans extract from the pool's worker threads. The key's destructor
+// frees it when the thread exits, so pools started and joined per install
+// (libreplica) don't leak one per worker.
+static pthread_key_t dctx_key;
+static pthread_once_t dctx_once = PTHREAD_ONCE_INIT;
+static int dctx_key_error;
+
+static void free_dctx(void *dctx) {
+    ZSTD_freeDCtx(dctx);
+}
+
+static void create_dctx_key(void) {
+    dctx_key_error = pthread_key_create(&dctx_key, free_dctx);
+}
+
+static ZSTD_DCtx *thread_dctx(void) {
+    pthread_once(&dctx_once, create_dctx_key);
+    if (dctx_key_error) {
+        return NULL;
+    }
+    ZSTD_DCtx *dctx = pthread_getspecific(dctx_key);
+    if (!dctx) {
+        dctx = ZSTD_createDCtx();
+        if (!dctx || pthread_setspecific(dctx_key, dctx) != 0) {
+            ZSTD_freeDCtx(dctx);
+            return NULL;
+        }
+    }
+    return dctx;
+}
+
+int pack_extract(const pack_t *pack, const pack_entry_t *entry, void *dst, size_t dst_size) {
+    if (dst_size < entry->raw_size) {
+        return -1;
+    }
+
+    ZSTD_DCtx *dctx = thread_dctx();
+    if (!dctx) {
+        return -1;
+    }
+    const void *frame = pack->map + entry->frame_offset;
+    size_t n;
+    if (pack->ddict) {
+        n = ZSTD_decompress_usingDDict(dctx, dst, dst_size, frame, entry->frame_size, pack->ddict);
+    } else {
+        n = ZSTD_decompressDCtx(dctx, dst, dst_size, frame, entry->frame_size);
+    }
+    if (ZSTD_isError(n)) {
+        fprintf(stderr, "Error decompressing '%s': %s\n", entry->name, ZSTD_getErrorName(n));
+        return -1;
+    }
+    return n == entry->raw_size ? 0 : -1;
+}
+
+#else // !REPLICA_HAVE_ZSTD
+
+pack_t *pack_open(const char *path) {
+    (void)path;
+    return NULL;
+}
+
+void pack_close(pack_t *pack) {
+    (void)pack;
+}
+
+int pack_extract(const pack_t *pack, const pack_entry_t *entry, void *dst, size_t dst_size) {
+    (void)pack;
+    (void)entry;
+    (void)dst;
+    (void)dst_size;
+    return -1;
+}
+
+#endif // REPLICA_HAVE_ZSTD
+
+size_t pack_entry_count(const pack_t *pack) {
+    return pack ? pack->entry_count : 0;
+}
+
+const pack_entry_t *pack_entry_at(const pack_t *pack, size_t index) {
+    if (!pack || index >= pack->entry_count) return NULL;
+    return &pack->entries[index];
+}
+
+const pack_entry_t *pack_find(const pack_t *pack, const char *name) {
+    if (!pack) return NULL;
+
+    size_t lo = 0;
+    size_t hi = pack->entry_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, pack->entries[mid].name);
+        if (cmp == 0) {
+            return &pack->entries[mid];
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+int pack_extract_to_fd(const pack_t *pack, const pack_entry_t *entry, int fd) {
+    // Decompress straight into the buffer handed to write(), no staging copy
+    unsigned char *buffer = malloc(entry->raw_size ? entry->raw_size : 1);
+    if (!buffer) {
+        return -1;
+    }
+
+    if (pack_extract(pack, entry, buffer, entry->raw_size) != 0) {
+        free(buffer);
+        return -1;
+    }
+
+    size_t written = 0;
+    while (written < entry->raw_size) {
+        ssize_t n = write(fd, buffer + written, entry->raw_size - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buffer);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+static pthread_once_t default_pack_once = PTHREAD_ONCE_INIT;
+static pack_t *default_pack = NULL;
+
+static void open_default_pack(void) {
+    const char *path = getenv("REPLICA_PACK");
+    default_pack = pack_open(path ? path : REPLICA_PACK_PATH);
+}
+
+pack_t *pack_default(void) {
+    // Copies running on the worker pool may be the first to ask
+    pthread_once(&default_pack_once, open_default_pack);
+    return default_pack;
+}
@@ -0,0 +1,50 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Template pack: every template compressed as its own zstd frame against a
+// shared dictionary trained at build time, so any entry can be extracted
+// without touching the others.
+//
+// On-disk layout (all integers little-endian):
+//   header  magic "RPCPACK1", u32 version, u32 entry_count, u32 dict_size,
+//           u32 names_size
+//   dict    dict_size bytes
+//   entries entry_count records, sorted by name (see PACK_ENTRY_SIZE)
+//   names   names_size bytes of NUL-terminated relative paths
+//   frames  one zstd frame per entry
+#define PACK_MAGIC "RPCPACK1"
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE 24
+#define PACK_ENTRY_SIZE 32
+#define PACK_FILE_NAME "templates.pack"
+
+// Entry flags
+#define PACK_F_NONE 0x0u
+#define PACK_F_PLACEHOLDERS 0x1u // contains {{key}} placeholders
+
+typedef struct {
+    const char *name;       // relative path, e.g. "/.github/prompts/ROADMAP.prompt.md"
+    uint32_t flags;
+    uint64_t frame_offset;
+    uint64_t frame_size;
+    uint64_t raw_size;
+} pack_entry_t;
+
+typedef struct pack pack_t;
+
+pack_t *pack_open(const char *path);
+void pack_close(pack_t *pack);
+size_t pack_entry_count(const pack_t *pack);
+const pack_entry_t *pack_entry_at(const pack_t *pack, size_t index);
+const pack_entry_t *pack_find(const pack_t *pack, const char *name);
+int pack_extract(const pack_t *pack, const pack_entry_t *entry, void *dst, size_t dst_size);
+int pack_extract_to_fd(const pack_t *pack, const pack_entry_t *entry, int fd);
+
+// Returns the pack installed next to the templates, or NULL when replica was
+// built without pack support or no pack is installed. Opened once per process.
+pack_t *pack_default(void);
+
+#endif // PACK_H
@@ -0,0 +1,227 @@
+// For syscall and the perf_event_open number
+#define _GNU_SOURCE
+
+#include "perf.h"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} counters[PERF_COUNTER_COUNT] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    [PERF_CACHE_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+    [PERF_CONTEXT_SWITCHES] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches"},
+    [PERF_PAGE_FAULTS] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page-faults"},
+};
+
+static const char *phase_names[PERF_PHASE_COUNT] = {
+    [PERF_PHASE_PLAN] = "plan",
+    [PERF_PHASE_MKDIR] = "mkdir",
+    [PERF_PHASE_COPY] = "copy",
+    [PERF_PHASE_RENDER] = "render",
+    [PERF_PHASE_UI] = "ui",
+    [PERF_PHASE_WAIT] = "wait",
+};
+
+// Set once on the main thread before any worker starts
+static int enabled;
+static int exclude_kernel;
+static int available[PERF_COUNTER_COUNT];
+
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+static perf_totals_t totals[PERF_PHASE_COUNT];
+static int multiplexed;
+
+// What PERF_FORMAT_GROUP with both times reads back
+typedef struct {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[PERF_COUNTER_COUNT];
+} group_read_t;
+
+typedef struct {
+    int opened;
+    int leader;                   // group fd, -1 when nothing could be opened
+    int slot[PERF_COUNTER_COUNT]; // position in the group read, -1 when not counting
+    perf_phase_t phase;
+    uint64_t last[PERF_COUNTER_COUNT];
+    uint64_t last_enabled;
+    uint64_t last_running;
+    double last_ms;
+} thread_counters_t;
+
+static _Thread_local thread_counters_t thread_counters = { .leader = -1, .phase = PERF_PHASE_NONE };
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static int open_counter(perf_counter_t counter, int group, int kernel_excluded) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[counter].type;
+    attr.config = counters[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = (unsigned)kernel_excluded;
+    attr.exclude_hv = 1;
+    // The calling thread on any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void open_thread_group(thread_counters_t *t) {
+    t->opened = 1;
+    int nr = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        t->slot[i] = -1;
+        if (!available[i]) {
+            continue;
+        }
+        int fd = open_counter((perf_counter_t)i, t->leader, exclude_kernel);
+        if (fd < 0) {
+            continue;
+        }
+        if (t->leader < 0) {
+            t->leader = fd;
+        }
+        t->slot[i] = nr++;
+    }
+}
+
+// Reads the group, or zeros when the thread has no counters
+static void read_group(const thread_counters_t *t, group_read_t *sample) {
+    memset(sample, 0, sizeof(*sample));
+    if (t->leader >= 0 && read(t->leader, sample, sizeof(*sample)) <= 0) {
+        memset(sample, 0, sizeof(*sample));
+    }
+}
+
+// Charges everything since the last change to the current phase
+static void charge(thread_counters_t *t, perf_phase_t entering) {
+    group_read_t sample;
+    read_group(t, &sample);
+    double ms = now_ms();
+
+    if (t->phase != PERF_PHASE_NONE || entering != PERF_PHASE_NONE) {
+        uint64_t enabled_delta = sample.time_enabled - t->last_enabled;
+        uint64_t running_delta = sample.time_running - t->last_running;
+        pthread_mutex_lock(&totals_lock);
+        if (t->phase != PERF_PHASE_NONE) {
+            perf_totals_t *phase = &totals[t->phase];
+            for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+                if (t->slot[i] < 0) {
+                    continue;
+                }
+                double delta = (double)(sample.values[t->slot[i]] - t->last[i]);
+                // Scale up what was counted while the PMU was shared
+                if (running_delta > 0 && running_delta < enabled_delta) {
+                    delta = delta * (double)enabled_delta / (double)running_delta;
+                    multiplexed = 1;
+                }
+                phase->value[i] += (unsigned long long)delta;
+            }
+            phase->ms += ms - t->last_ms;
+        }
+        if (entering != PERF_PHASE_NONE) {
+            totals[entering].entries++;
+        }
+        pthread_mutex_unlock(&totals_lock);
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (t->slot[i] >= 0) {
+            t->last[i] = sample.values[t->slot[i]];
+        }
+    }
+    t->last_enabled = sample.time_enabled;
+    t->last_running = sample.time_running;
+    t->last_ms = ms;
+}
+
+int perf_enable(void) {
+    // Probe each counter alone, since a group fails as a whole. Kernel-side
+    // counts need perf_event_paranoid <= 1; below that count user space only.
+    int count = 0;
+    int first_error = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        int fd = open_counter((perf_counter_t)i, -1, exclude_kernel);
+        if (fd < 0 && (errno == EACCES || errno == EPERM) && !exclude_kernel) {
+            exclude_kernel = 1;
+            fd = open_counter((perf_counter_t)i, -1, exclude_kernel);
+        }
+        if (fd < 0) {
+            if (!first_error) first_error = errno;
+            continue;
+        }
+        close(fd);
+        available[i] = 1;
+        count++;
+    }
+    enabled = 1;
+    errno = first_error;
+    return count;
+}
+
+int perf_enabled(void) {
+    return enabled;
+}
+
+perf_phase_t perf_enter(perf_phase_t phase) {
+    if (!enabled) {
+        return PERF_PHASE_NONE;
+    }
+    thread_counters_t *t = &thread_counters;
+    if (!t->opened) {
+        open_thread_group(t);
+    }
+    perf_phase_t previous = t->phase;
+    charge(t, phase);
+    t->phase = phase;
+    return previous;
+}
+
+void perf_leave(perf_phase_t previous) {
+    if (!enabled) {
+        return;
+    }
+    thread_counters_t *t = &thread_counters;
+    charge(t, PERF_PHASE_NONE);
+    t->phase = previous;
+}
+
+int perf_available(perf_counter_t counter) {
+    return available[counter];
+}
+
+int perf_multiplexed(void) {
+    pthread_mutex_lock(&totals_lock);
+    int result = multiplexed;
+    pthread_mutex_unlock(&totals_lock);
+    return result;
+}
+
+void perf_totals(perf_phase_t phase, perf_totals_t *out) {
+    pthread_mutex_lock(&totals_lock);
+    *out = totals[phase];
+    pthread_mutex_unlock(&totals_lock);
+}
+
+const char *perf_phase_name(perf_phase_t phase) {
+    return phase >= 0 && phase < PERF_PHASE_COUNT ? phase_names[phase] : "none";
+}
+
+const char *perf_counter_name(perf_counter_t counter) {
+    return counters[counter].name;
+}
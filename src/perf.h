@@ -0,0 +1,61 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Opt-in performance counters for installs and copies (--perf-counters).
+// Every thread that takes part opens its own perf_event_open group the first
+// time it enters a phase, and each phase change reads the group once and
+// charges the difference to the phase being left. Phases nest: entering one
+// pauses the phase it interrupts, so each count lands in exactly one phase.
+//
+// Counters the kernel won't hand out (no PMU in a VM, perf_event_paranoid,
+// seccomp) are reported as unavailable and the others still count; wall
+// time per phase is always measured. While counting is off, entering and
+// leaving a phase is a single branch.
+
+typedef enum {
+    PERF_PHASE_NONE = -1,
+    PERF_PHASE_PLAN,   // walking sources and building the plan
+    PERF_PHASE_MKDIR,  // creating directories and links, setting modes
+    PERF_PHASE_COPY,   // copying file data
+    PERF_PHASE_RENDER, // substituting {{key}} placeholders
+    PERF_PHASE_UI,     // progress lines and per-file callbacks
+    PERF_PHASE_WAIT,   // the planning thread waiting for the workers
+    PERF_PHASE_COUNT
+} perf_phase_t;
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+} perf_counter_t;
+
+typedef struct {
+    unsigned long long value[PERF_COUNTER_COUNT];
+    unsigned long long entries; // times the phase was entered
+    double ms;                  // wall time, summed over threads
+} perf_totals_t;
+
+// Starts counting. Returns the number of counters available (0 still times
+// the phases), with errno from the first counter that could not be opened.
+int perf_enable(void);
+int perf_enabled(void);
+
+// Enters phase on the calling thread and returns the phase it interrupted,
+// to be handed to perf_leave()
+perf_phase_t perf_enter(perf_phase_t phase);
+void perf_leave(perf_phase_t previous);
+
+int perf_available(perf_counter_t counter);
+
+// Whether the kernel had to time-share counters, making counts estimates
+int perf_multiplexed(void);
+
+void perf_totals(perf_phase_t phase, perf_totals_t *totals);
+
+const char *perf_phase_name(perf_phase_t phase);
+const char *perf_counter_name(perf_counter_t counter);
+
+#endif // PERF_H
@@ -0,0 +1,474 @@
+#include "plan.h"
+#include "cli_utils.h"
+#include "strategy.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// Read/write size of the copy core, used for syscall estimates
+#define PLAN_IO_CHUNK (64 * 1024)
+#define PLAN_ARENA_CHUNK (64 * 1024)
+
+typedef struct {
+    plan_node_t node;
+    int first_edge;
+    atomic_int pending;
+    atomic_int blocked;
+} plan_entry_t;
+
+typedef struct plan_chunk {
+    struct plan_chunk *next;
+    size_t used;
+    size_t cap;
+    char data[];
+} plan_chunk_t;
+
+struct plan {
+    plan_entry_t *entries;
+    size_t count;
+    size_t cap;
+
+    // Dependency edges, stored as per-node singly linked lists
+    int *edge_to;
+    int *edge_next;
+    size_t edge_count;
+    size_t edge_cap;
+
+    // Open-addressing index of mkdir nodes by path (node id + 1, 0 = empty)
+    int *dirs;
+    size_t dir_count;
+    size_t dir_cap;
+
+    plan_chunk_t *chunks;
+};
+
+typedef struct plan_exec plan_exec_t;
+
+typedef struct {
+    plan_exec_t *exec;
+    int id;
+} plan_task_t;
+
+struct plan_exec {
+    plan_t *plan;
+    pool_t *pool;
+    plan_run_fn run;
+    void *ctx;
+    atomic_int failures;
+    plan_task_t *tasks;
+};
+
+static uint64_t hash_path(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static const char *plan_strdup(plan_t *plan, const char *s) {
+    if (!s) return NULL;
+
+    size_t len = strlen(s) + 1;
+    plan_chunk_t *chunk = plan->chunks;
+    if (!chunk || chunk->cap - chunk->used < len) {
+        size_t cap = len > PLAN_ARENA_CHUNK ? len : PLAN_ARENA_CHUNK;
+        chunk = malloc(sizeof(plan_chunk_t) + cap);
+        if (!chunk) return NULL;
+        chunk->next = plan->chunks;
+        chunk->used = 0;
+        chunk->cap = cap;
+        plan->chunks = chunk;
+    }
+
+    char *copy = chunk->data + chunk->used;
+    memcpy(copy, s, len);
+    chunk->used += len;
+    return copy;
+}
+
+plan_t *plan_new(void) {
+    return calloc(1, sizeof(plan_t));
+}
+
+void plan_reset(plan_t *plan) {
+    plan_chunk_t *chunk = plan->chunks;
+    while (chunk) {
+        plan_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    plan->chunks = NULL;
+    plan->count = 0;
+    plan->edge_count = 0;
+    plan->dir_count = 0;
+    if (plan->dirs) {
+        memset(plan->dirs, 0, plan->dir_cap * sizeof(int));
+    }
+}
+
+void plan_free(plan_t *plan) {
+    if (!plan) return;
+    plan_reset(plan);
+    free(plan->entries);
+    free(plan->edge_to);
+    free(plan->edge_next);
+    free(plan->dirs);
+    free(plan);
+}
+
+size_t plan_size(const plan_t *plan) {
+    return plan->count;
+}
+
+const plan_node_t *plan_node_at(const plan_t *plan, size_t index) {
+    return index < plan->count ? &plan->entries[index].node : NULL;
+}
+
+int plan_find_dir(const plan_t *plan, const char *path) {
+    if (plan->dir_cap == 0) return -1;
+
+    size_t mask = plan->dir_cap - 1;
+    for (size_t i = hash_path(path) & mask;; i = (i + 1) & mask) {
+        int slot = plan->dirs[i];
+        if (slot == 0) return -1;
+        if (strcmp(plan->entries[slot - 1].node.dest, path) == 0) return slot - 1;
+    }
+}
+
+static int dir_index_insert(plan_t *plan, int id) {
+    if ((plan->dir_count + 1) * 10 > plan->dir_cap * 7) {
+        size_t cap = plan->dir_cap ? plan->dir_cap * 2 : 64;
+        int *dirs = calloc(cap, sizeof(int));
+        if (!dirs) return -1;
+
+        for (size_t i = 0; i < plan->dir_cap; i++) {
+            int slot = plan->dirs[i];
+            if (slot == 0) continue;
+            size_t j = hash_path(plan->entries[slot - 1].node.dest) & (cap - 1);
+            while (dirs[j] != 0) j = (j + 1) & (cap - 1);
+            dirs[j] = slot;
+        }
+        free(plan->dirs);
+        plan->dirs = dirs;
+        plan->dir_cap = cap;
+    }
+
+    size_t mask = plan->dir_cap - 1;
+    size_t i = hash_path(plan->entries[id].node.dest) & mask;
+    while (plan->dirs[i] != 0) i = (i + 1) & mask;
+    plan->dirs[i] = id + 1;
+    plan->dir_count++;
+    return 0;
+}
+
+int plan_add(plan_t *plan, const plan_node_t *node) {
+    if (plan->count == plan->cap) {
+        size_t cap = plan->cap ? plan->cap * 2 : 64;
+        plan_entry_t *entries = realloc(plan->entries, cap * sizeof(plan_entry_t));
+        if (!entries) return -1;
+        plan->entries = entries;
+        plan->cap = cap;
+    }
+
+    int id = (int)plan->count;
+    plan_entry_t *entry = &plan->entries[id];
+    entry->node = *node;
+    entry->node.src = plan_strdup(plan, node->src);
+    entry->node.dest = plan_strdup(plan, node->dest);
+    entry->first_edge = -1;
+    atomic_init(&entry->pending, 0);
+    atomic_init(&entry->blocked, 0);
+    if (!entry->node.dest || (node->src && !entry->node.src)) {
+        return -1;
+    }
+    plan->count++;
+
+    if (node->op == PLAN_MKDIR && dir_index_insert(plan, id) != 0) {
+        plan->count--;
+        return -1;
+    }
+    return id;
+}
+
+int plan_add_dep(plan_t *plan, int node, int depends_on) {
+    if (node < 0 || depends_on < 0) {
+        return 0; // Dependency already satisfied (e.g. created in an earlier plan)
+    }
+
+    if (plan->edge_count == plan->edge_cap) {
+        size_t cap = plan->edge_cap ? plan->edge_cap * 2 : 64;
+        int *to = realloc(plan->edge_to, cap * sizeof(int));
+        if (!to) return -1;
+        plan->edge_to = to;
+        int *next = realloc(plan->edge_next, cap * sizeof(int));
+        if (!next) return -1;
+        plan->edge_next = next;
+        plan->edge_cap = cap;
+    }
+
+    int edge = (int)plan->edge_count++;
+    plan->edge_to[edge] = node;
+    plan->edge_next[edge] = plan->entries[depends_on].first_edge;
+    plan->entries[depends_on].first_edge = edge;
+    return 0;
+}
+
+int plan_mkdir(plan_t *plan, const char *path, mode_t mode, unsigned flags) {
+    int id = plan_find_dir(plan, path);
+    if (id >= 0) {
+        return id;
+    }
+
+    plan_node_t node = {
+        .op = PLAN_MKDIR,
+        .flags = flags,
+        .dest = path,
+        .size = 0,
+        .mode = mode,
+    };
+    return plan_add(plan, &node);
+}
+
+// Shared mkdir nodes keep the tag of the first request that planned them
+void plan_set_tag(plan_t *plan, int node, void *tag) {
+    if (node >= 0 && (size_t)node < plan->count && !plan->entries[node].node.tag) {
+        plan->entries[node].node.tag = tag;
+    }
+}
+
+static void plan_run_from(plan_exec_t *exec, int start);
+
+static void plan_task(void *arg) {
+    plan_task_t *task = arg;
+    plan_run_from(task->exec, task->id);
+}
+
+// Runs start, then every dependent it unblocks. Copies go to the pool so they
+// run concurrently; mkdir and metadata nodes are cheap and ordered, so they
+// are batched on the thread that unblocked them.
+static void plan_run_from(plan_exec_t *exec, int start) {
+    plan_t *plan = exec->plan;
+    int *stack = malloc(sizeof(int) * 16);
+    size_t depth = 0;
+    size_t cap = 16;
+    if (!stack) {
+        atomic_fetch_add(&exec->failures, 1);
+        return;
+    }
+    stack[depth++] = start;
+
+    while (depth > 0) {
+        int id = stack[--depth];
+        plan_entry_t *entry = &plan->entries[id];
+
+        int ok = 0;
+        if (!atomic_load(&entry->blocked)) {
+            ok = exec->run(&entry->node, exec->ctx) == 0;
+        }
+        if (!ok) {
+            atomic_fetch_add(&exec->failures, 1);
+        }
+
+        for (int e = entry->first_edge; e >= 0; e = plan->edge_next[e]) {
+            int next = plan->edge_to[e];
+            plan_entry_t *dependent = &plan->entries[next];
+            if (!ok) {
+                atomic_store(&dependent->blocked, 1);
+            }
+            if (atomic_fetch_sub(&dependent->pending, 1) != 1) {
+                continue;
+            }
+
+            if (exec->pool && dependent->node.op == PLAN_COPY &&
+                pool_submit(exec->pool, plan_task, &exec->tasks[next]) == 0) {
+                continue;
+            }
+            if (depth == cap) {
+                int *grown = realloc(stack, sizeof(int) * cap * 2);
+                if (!grown) {
+                    atomic_fetch_add(&exec->failures, 1);
+                    continue;
+                }
+                stack = grown;
+                cap *= 2;
+            }
+            stack[depth++] = next;
+        }
+    }
+    free(stack);
+}
+
+int plan_execute(plan_t *plan, pool_t *pool, plan_run_fn run, void *ctx) {
+    if (plan->count == 0) {
+        return 0;
+    }
+
+    size_t copies = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        atomic_store(&plan->entries[i].pending, 0);
+        atomic_store(&plan->entries[i].blocked, 0);
+        if (plan->entries[i].node.op == PLAN_COPY) copies++;
+    }
+    for (size_t e = 0; e < plan->edge_count; e++) {
+        atomic_fetch_add(&plan->entries[plan->edge_to[e]].pending, 1);
+    }
+
+    // Not worth a thread handoff for a single file
+    if (copies < 2) {
+        pool = NULL;
+    }
+
+    plan_exec_t exec = {
+        .plan = plan,
+        .pool = pool,
+        .run = run,
+        .ctx = ctx,
+    };
+    atomic_init(&exec.failures, 0);
+
+    exec.tasks = malloc(sizeof(plan_task_t) * plan->count);
+    int *roots = malloc(sizeof(int) * plan->count);
+    if (!exec.tasks || !roots) {
+        free(exec.tasks);
+        free(roots);
+        return -1;
+    }
+
+    size_t root_count = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        exec.tasks[i].exec = &exec;
+        exec.tasks[i].id = (int)i;
+        if (atomic_load(&plan->entries[i].pending) == 0) {
+            roots[root_count++] = (int)i;
+        }
+    }
+
+    for (size_t i = 0; i < root_count; i++) {
+        int id = roots[i];
+        if (pool && plan->entries[id].node.op == PLAN_COPY &&
+            pool_submit(pool, plan_task, &exec.tasks[id]) == 0) {
+            continue;
+        }
+        plan_run_from(&exec, id);
+    }
+    if (pool) {
+        pool_wait(pool);
+    }
+
+    free(roots);
+    free(exec.tasks);
+    return atomic_load(&exec.failures) == 0 ? 0 : -1;
+}
+
+void plan_estimate(const plan_t *plan, plan_estimate_t *estimate) {
+    for (size_t i = 0; i < plan->count; i++) {
+        const plan_node_t *node = &plan->entries[i].node;
+
+        switch (node->op) {
+        case PLAN_MKDIR:
+            estimate->mkdir_nodes++;
+            if (node->flags & PLAN_F_PARENTS) {
+                // One mkdir per path component
+                for (const char *p = node->dest + 1; *p; p++) {
+                    if (*p == '/') estimate->mkdirs++;
+                }
+            }
+            estimate->mkdirs++;
+            break;
+        case PLAN_COPY: {
+            estimate->copy_nodes++;
+            long long size = node->size > 0 ? node->size : 0;
+            estimate->bytes += size;
+            if (node->flags & PLAN_F_PACKED) {
+                estimate->opens += 1;
+                estimate->writes += 1;
+                estimate->other += 1;
+            } else {
+                estimate->opens += 2;
+                estimate->stats += 1;
+                if (size <= STRATEGY_BUFFER_MAX) {
+                    // Read once, written once
+                    estimate->reads += size > 0;
+                    estimate->writes += size > 0;
+                } else {
+                    // Streaming bound; kernel-side copies need far fewer
+                    estimate->reads += (size_t)(size / PLAN_IO_CHUNK) + 1;
+                    estimate->writes += (size_t)((size + PLAN_IO_CHUNK - 1) / PLAN_IO_CHUNK);
+                }
+                estimate->other += 2;
+            }
+            break;
+        }
+        case PLAN_META:
+            estimate->meta_nodes++;
+            estimate->other += 1;
+            break;
+        case PLAN_LINK:
+        case PLAN_SYMLINK:
+            estimate->link_nodes++;
+            estimate->other += 1;
+            break;
+        }
+    }
+}
+
+void plan_print(const plan_t *plan) {
+    char line[2048];
+
+    for (size_t i = 0; i < plan->count; i++) {
+        const plan_node_t *node = &plan->entries[i].node;
+
+        switch (node->op) {
+        case PLAN_MKDIR:
+            snprintf(line, sizeof(line), "mkdir%s %s",
+                     (node->flags & PLAN_F_PARENTS) ? " -p" : "", node->dest);
+            break;
+        case PLAN_COPY:
+            if (node->size >= 0) {
+                snprintf(line, sizeof(line), "copy  %s%s -> %s (%lld bytes)",
+                         (node->flags & PLAN_F_PACKED) ? "pack:" : "", node->src, node->dest, node->size);
+            } else {
+                snprintf(line, sizeof(line), "copy  %s%s -> %s",
+                         (node->flags & PLAN_F_PACKED) ? "pack:" : "", node->src, node->dest);
+            }
+            break;
+        case PLAN_META:
+            snprintf(line, sizeof(line), "chmod %04o %s", (unsigned)(node->mode & 07777), node->dest);
+            break;
+        case PLAN_LINK:
+            snprintf(line, sizeof(line), "link  %s -> %s", node->src, node->dest);
+            break;
+        case PLAN_SYMLINK:
+            snprintf(line, sizeof(line), "symlink %s -> %s", node->dest, node->src);
+            break;
+        }
+        cli_print_step(line);
+    }
+}
+
+void plan_print_estimate(const plan_estimate_t *estimate) {
+    size_t syscalls = estimate->opens + estimate->stats + estimate->mkdirs +
+                      estimate->reads + estimate->writes + estimate->other;
+    size_t nodes = estimate->mkdir_nodes + estimate->copy_nodes + estimate->link_nodes + estimate->meta_nodes;
+
+    printf("\n");
+    if (cli_supports_color()) {
+        printf("  %s%sNodes:%s %zu (%zu mkdir, %zu copy, %zu link, %zu metadata)\n", ICON_PACKAGE, THEME_INFO, RESET,
+               nodes, estimate->mkdir_nodes, estimate->copy_nodes, estimate->link_nodes, estimate->meta_nodes);
+        printf("  %s%sEstimated bytes:%s %lld\n", ICON_FILE, THEME_INFO, RESET, estimate->bytes);
+        printf("  %s%sEstimated syscalls:%s %zu (open %zu, stat %zu, mkdir %zu, read %zu, write %zu, other %zu)\n",
+               ICON_GEAR, THEME_INFO, RESET, syscalls, estimate->opens, estimate->stats, estimate->mkdirs,
+               estimate->reads, estimate->writes, estimate->other);
+    } else {
+        printf("  Nodes: %zu (%zu mkdir, %zu copy, %zu link, %zu metadata)\n",
+               nodes, estimate->mkdir_nodes, estimate->copy_nodes, estimate->link_nodes, estimate->meta_nodes);
+        printf("  Estimated bytes: %lld\n", estimate->bytes);
+        printf("  Estimated syscalls: %zu (open %zu, stat %zu, mkdir %zu, read %zu, write %zu, other %zu)\n",
+               syscalls, estimate->opens, estimate->stats, estimate->mkdirs,
+               estimate->reads, estimate->writes, estimate->other);
+    }
+}
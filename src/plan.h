@@ -0,0 +1,69 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "pool.h"
+
+// Install plans: every request (template sets, --all, a tree) is first
+// turned into a graph of mkdir, copy, link and metadata nodes, then executed by a
+// scheduler that runs independent nodes on the worker pool. Nodes must be
+// added after the nodes they depend on.
+
+typedef enum {
+    PLAN_MKDIR,
+    PLAN_COPY,
+    PLAN_META,
+    PLAN_LINK,   // hard link dest to src, an already written destination
+    PLAN_SYMLINK // symlink at dest whose target is src
+} plan_op_t;
+
+// Node flags
+#define PLAN_F_PARENTS 0x1u // PLAN_MKDIR: create missing parents too (mkdir -p)
+#define PLAN_F_PACKED 0x2u  // PLAN_COPY: served from the template pack
+
+typedef struct {
+    plan_op_t op;
+    unsigned flags;
+    const char *src;   // PLAN_COPY source path, PLAN_LINK existing path, PLAN_SYMLINK target
+    const char *dest;  // path created or updated
+    long long size;    // estimated bytes, -1 when unknown
+    mode_t mode;       // PLAN_MKDIR / PLAN_META permissions
+    void *tag;         // caller data, passed back untouched
+} plan_node_t;
+
+typedef struct {
+    size_t mkdir_nodes;
+    size_t copy_nodes;
+    size_t meta_nodes;
+    size_t link_nodes;
+    long long bytes;
+    size_t opens;
+    size_t stats;
+    size_t mkdirs;
+    size_t reads;
+    size_t writes;
+    size_t other;
+} plan_estimate_t;
+
+typedef struct plan plan_t;
+
+// Runs one node; returns 0 on success. Dependents of a failed node are skipped.
+typedef int (*plan_run_fn)(const plan_node_t *node, void *ctx);
+
+plan_t *plan_new(void);
+void plan_free(plan_t *plan);
+void plan_reset(plan_t *plan);
+size_t plan_size(const plan_t *plan);
+const plan_node_t *plan_node_at(const plan_t *plan, size_t index);
+int plan_add(plan_t *plan, const plan_node_t *node);
+int plan_add_dep(plan_t *plan, int node, int depends_on);
+int plan_mkdir(plan_t *plan, const char *path, mode_t mode, unsigned flags);
+int plan_find_dir(const plan_t *plan, const char *path);
+void plan_set_tag(plan_t *plan, int node, void *tag);
+int plan_execute(plan_t *plan, pool_t *pool, plan_run_fn run, void *ctx);
+void plan_estimate(const plan_t *plan, plan_estimate_t *estimate);
+void plan_print(const plan_t *plan);
+void plan_print_estimate(const plan_estimate_t *estimate);
+
+#endif // PLAN_H
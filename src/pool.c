@@ -0,0 +1,157 @@
+// For sysconf(_SC_NPROCESSORS_ONLN)
+#define _GNU_SOURCE
+
+#include "pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define POOL_MAX_DEFAULT_THREADS 8
+
+typedef struct {
+    pool_task_fn fn;
+    void *arg;
+} pool_task_t;
+
+struct pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;  // signalled when a task is queued or on shutdown
+    pthread_cond_t idle;  // signalled when outstanding drops to zero
+    pool_task_t *queue;   // ring buffer
+    int head;
+    int count;
+    int cap;
+    int outstanding;      // queued + running
+    int stopping;
+    int thread_count;
+    pthread_t *threads;
+};
+
+static void *pool_worker(void *arg) {
+    pool_t *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->count == 0 && pool->stopping) {
+            break;
+        }
+
+        pool_task_t task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->cap;
+        pool->count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        task.fn(task.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->outstanding == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int pool_default_size(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    return cpus < POOL_MAX_DEFAULT_THREADS ? (int)cpus : POOL_MAX_DEFAULT_THREADS;
+}
+
+pool_t *pool_new(int threads) {
+    if (threads < 1) {
+        threads = pool_default_size();
+    }
+
+    pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+
+    pool->cap = 64;
+    pool->queue = malloc(sizeof(pool_task_t) * (size_t)pool->cap);
+    pool->threads = calloc((size_t)threads, sizeof(pthread_t));
+    if (!pool->queue || !pool->threads) {
+        free(pool->queue);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void pool_free(pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+}
+
+int pool_submit(pool_t *pool, pool_task_fn fn, void *arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->count == pool->cap) {
+        int cap = pool->cap * 2;
+        pool_task_t *queue = malloc(sizeof(pool_task_t) * (size_t)cap);
+        if (!queue) {
+            pthread_mutex_unlock(&pool->lock);
+            return -1;
+        }
+        for (int i = 0; i < pool->count; i++) {
+            queue[i] = pool->queue[(pool->head + i) % pool->cap];
+        }
+        free(pool->queue);
+        pool->queue = queue;
+        pool->head = 0;
+        pool->cap = cap;
+    }
+
+    pool->queue[(pool->head + pool->count) % pool->cap] = (pool_task_t){fn, arg};
+    pool->count++;
+    pool->outstanding++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void pool_wait(pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->outstanding > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_size(const pool_t *pool) {
+    return pool ? pool->thread_count : 0;
+}
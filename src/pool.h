@@ -0,0 +1,18 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Persistent worker pool. Tasks may submit further tasks; pool_wait()
+// returns once every submitted task, including those, has finished.
+
+typedef void (*pool_task_fn)(void *arg);
+
+typedef struct pool pool_t;
+
+pool_t *pool_new(int threads);
+void pool_free(pool_t *pool);
+int pool_submit(pool_t *pool, pool_task_fn fn, void *arg);
+void pool_wait(pool_t *pool);
+int pool_size(const pool_t *pool);
+int pool_default_size(void);
+
+#endif // POOL_H
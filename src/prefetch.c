@@ -0,0 +1,96 @@
+// For posix_fadvise and O_CLOEXEC
+#define _POSIX_C_SOURCE 200809L
+
+#include "prefetch.h"
+#include <stdlib.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+struct prefetch {
+    const char *const *paths;
+    size_t count;
+    size_t window;
+    size_t started; // files the workers have begun copying
+    size_t issued;  // files read ahead so far, in plan order
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t moved;
+    pthread_t thread;
+};
+
+static void prefetch_file(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        return; // the copy reports it
+    }
+    posix_fadvise(fd, 0, PREFETCH_MAX_BYTES, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+static void *prefetch_thread(void *arg) {
+    prefetch_t *prefetch = arg;
+    pthread_mutex_lock(&prefetch->lock);
+    while (!prefetch->stopping && prefetch->issued < prefetch->count) {
+        if (prefetch->issued >= prefetch->started + prefetch->window) {
+            pthread_cond_wait(&prefetch->moved, &prefetch->lock);
+            continue;
+        }
+        const char *path = prefetch->paths[prefetch->issued];
+        pthread_mutex_unlock(&prefetch->lock);
+        prefetch_file(path);
+        pthread_mutex_lock(&prefetch->lock);
+        prefetch->issued++;
+    }
+    pthread_mutex_unlock(&prefetch->lock);
+    return NULL;
+}
+
+prefetch_t *prefetch_start(const char *const *paths, size_t count, size_t window) {
+    if (window == 0 || count == 0) {
+        return NULL;
+    }
+    prefetch_t *prefetch = calloc(1, sizeof(*prefetch));
+    if (!prefetch) {
+        return NULL;
+    }
+    prefetch->paths = paths;
+    prefetch->count = count;
+    prefetch->window = window;
+    pthread_mutex_init(&prefetch->lock, NULL);
+    pthread_cond_init(&prefetch->moved, NULL);
+    if (pthread_create(&prefetch->thread, NULL, prefetch_thread, prefetch) != 0) {
+        pthread_mutex_destroy(&prefetch->lock);
+        pthread_cond_destroy(&prefetch->moved);
+        free(prefetch);
+        return NULL;
+    }
+    return prefetch;
+}
+
+void prefetch_advance(prefetch_t *prefetch) {
+    if (!prefetch) {
+        return;
+    }
+    pthread_mutex_lock(&prefetch->lock);
+    prefetch->started++;
+    pthread_cond_signal(&prefetch->moved);
+    pthread_mutex_unlock(&prefetch->lock);
+}
+
+size_t prefetch_stop(prefetch_t *prefetch) {
+    if (!prefetch) {
+        return 0;
+    }
+    pthread_mutex_lock(&prefetch->lock);
+    prefetch->stopping = 1;
+    pthread_cond_signal(&prefetch->moved);
+    pthread_mutex_unlock(&prefetch->lock);
+    pthread_join(prefetch->thread, NULL);
+
+    size_t issued = prefetch->issued;
+    pthread_mutex_destroy(&prefetch->lock);
+    pthread_cond_destroy(&prefetch->moved);
+    free(prefetch);
+    return issued;
+}
@@ -0,0 +1,28 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+// Read-ahead stage for copy plans. A background thread walks the planned
+// source files in order and asks the kernel to start reading each one
+// (posix_fadvise WILLNEED on its first PREFETCH_MAX_BYTES), staying at most
+// window files ahead of the copies that have started. On a cold cache the
+// workers then find their sources already in flight instead of stalling on
+// the first read of every file.
+
+#define PREFETCH_MAX_BYTES (8 * 1024 * 1024) // the copy's own sequential readahead covers the rest
+
+typedef struct prefetch prefetch_t;
+
+// paths must stay valid until prefetch_stop(). Returns NULL when window is
+// 0, there is nothing to prefetch or the thread can't be started.
+prefetch_t *prefetch_start(const char *const *paths, size_t count, size_t window);
+
+// One more planned file has started copying; slides the window. NULL is a no-op.
+void prefetch_advance(prefetch_t *prefetch);
+
+// Stops the thread and frees the stage. Returns the number of files it
+// issued reads for.
+size_t prefetch_stop(prefetch_t *prefetch);
+
+#endif // PREFETCH_H
@@ -3,15 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 
-// Template data structure for beautiful display
-typedef struct {
-    const char *flag;
-    const char *name;
-    const char *description;
-    const char *icon;
-} template_info_t;
-
-static const template_info_t templates[] = {
+const template_info_t help_templates[] = {
     {"--readme", "README Templates", "Professional README.md generation", "📝"},
     {"--release-notes", "Release Notes", "Comprehensive release documentation", "🚀"},
     {"--post", "Social Posts", "LinkedIn and social media content", "📱"},
@@ -28,7 +20,52 @@ static const template_info_t templates[] = {
     {"--all", "Complete Package", "All available templates and resources", "📦"}
 };
 
-static const int template_count = sizeof(templates) / sizeof(templates[0]);
+const int help_template_count = sizeof(help_templates) / sizeof(help_templates[0]);
+
+// Options accepted by 'init' in addition to the template flag
+static const cli_option_t init_options[] = {
+    {.long_flag = "--set key=value", .description = "Replace {{key}} placeholders while copying"},
+    {.long_flag = "--dry-run", .description = "Print the install plan without writing anything"},
+    {.long_flag = "--recursive", .description = "Install into every git repository under the destination"},
+    {.long_flag = "--git-stage", .description = "Stage the installed files in the git index without running git add"},
+    {.long_flag = "--jobs N", .description = "Copy with N worker threads (default: one per CPU; also copy)"},
+    {.long_flag = "--adaptive[=MIN:MAX]", .description = "Tune the worker count to measured latency, within MIN:MAX (also copy)"},
+    {.long_flag = "--stats", .description = "Report file latency, throughput and worker count decisions (also copy)"},
+    {.long_flag = "--prefetch N", .description = "Read up to N source files ahead of the workers (also copy, default 32 there)"},
+    {.long_flag = "--no-cache", .description = "Keep large files (8 MiB and up) out of the page cache (also sync, copy)"},
+    {.long_flag = "--verbose", .description = "Trace filesystem probes and the copy method of each file (also sync, copy)"},
+    {.long_flag = "--perf-counters", .description = "Count cycles, instructions, page faults and more per phase (also copy)"},
+    {.long_flag = "--pin VERSION", .description = "Install a template version from the store (also cat, show)"},
+    {.long_flag = "--io-limit BYTES", .description = "Cap copy throughput at BYTES per second (K, M, G suffixes; also sync, copy)"},
+    {.long_flag = "--iops-limit N", .description = "Cap copy I/O operations at N per second (also sync, copy)"},
+    {.long_flag = "--ioprio CLASS", .description = "Set the I/O priority: idle, be:N or rt:N (also sync, copy)"},
+    {.long_flag = "--eol lf|crlf", .description = "Convert line endings while copying text files (also copy)"},
+    {.long_flag = "--bom strip|add", .description = "Strip or add the UTF-8 byte order mark (also copy)"},
+    {.long_flag = "--check-utf8", .description = "Refuse text files that are not valid UTF-8 (also copy)"},
+};
+
+static const int init_option_count = sizeof(init_options) / sizeof(init_options[0]);
+
+// Options accepted by 'sync'
+static const cli_option_t sync_options[] = {
+    {.long_flag = "--watch", .description = "Keep running and copy changes as they happen"},
+    {.long_flag = "--debounce MS", .description = "Wait for MS quiet milliseconds before copying (default: 100)"},
+    {.long_flag = "--source DIR", .description = "Mirror DIR instead of the installed templates"},
+};
+
+static const int sync_option_count = sizeof(sync_options) / sizeof(sync_options[0]);
+
+// Options accepted by 'copy'
+static const cli_option_t copy_options[] = {
+    {.long_flag = "--resume", .description = "Skip files an interrupted copy already finished"},
+    {.long_flag = "--journal FILE", .description = "Record finished files in FILE (default: <destination>.rpc-journal)"},
+    {.long_flag = "--walk-mem BYTES", .description = "Cap the memory for directories still to be read (default 64M, at least 260K)"},
+    {.long_flag = "--physical-order", .description = "Read source files one at a time in on-disk order (helps on spinning disks)"},
+    {.long_flag = "--preserve-hardlinks", .description = "Copy each hard-linked file once and link its other names to the copy"},
+    {.long_flag = "--preserve-symlinks", .description = "Recreate symlinks instead of copying the files they point to"},
+};
+
+static const int copy_option_count = sizeof(copy_options) / sizeof(copy_options[0]);
 
 void print_help(const char *prog) {
     // Beautiful banner
@@ -50,12 +87,34 @@ void print_help(const char *prog) {
                THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_ACCENT, RESET);
         printf("  %s%s%s %sinit%s %s--<template>%s %s<destination>%s\n", 
                THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET, THEME_ACCENT, RESET);
+        printf("  %s%s%s %sinit%s %s[--<template>] --recursive%s %s<root>%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET, THEME_ACCENT, RESET);
+        printf("  %s%s%s %ssync%s %s[--watch]%s %s<destination>...%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET, THEME_ACCENT, RESET);
+        printf("  %s%s%s %scopy%s %s[--resume]%s %s<source> <destination>...%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET, THEME_ACCENT, RESET);
+        printf("  %s%s%s %scat%s | %sshow%s %s[--prompt | --instructions] [--pin VERSION]%s %s<template>...%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET,
+               THEME_ACCENT, RESET);
+        printf("  %s%s%s %ssearch%s %s<query>...%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_ACCENT, RESET);
+        printf("  %s%s%s %sroots%s\n", 
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET);
+        printf("  %s%s%s %sstore%s %s[list | add VERSION [DIR] [--use] | use VERSION]%s\n",
+               THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_INFO, RESET);
         printf("  %s%s%s %shelp%s | %sversion%s\n\n", 
                THEME_MUTED, prog, RESET, THEME_SUCCESS, RESET, THEME_SUCCESS, RESET);
     } else {
         printf("USAGE:\n");
         printf("  %s init <destination>\n", prog);
         printf("  %s init --<template> <destination>\n", prog);
+        printf("  %s init [--<template>] --recursive <root>\n", prog);
+        printf("  %s sync [--watch] <destination>...\n", prog);
+        printf("  %s copy [--resume] <source> <destination>...\n", prog);
+        printf("  %s cat | show [--prompt | --instructions] [--pin VERSION] <template>...\n", prog);
+        printf("  %s search <query>...\n", prog);
+        printf("  %s roots\n", prog);
+        printf("  %s store [list | add VERSION [DIR] [--use] | use VERSION]\n", prog);
         printf("  %s help | version\n\n", prog);
     }
     
@@ -99,15 +158,15 @@ void print_help(const char *prog) {
         
         cli_print_table_header(headers, 3, widths);
         
-        for (int i = 0; i < template_count; i++) {
+        for (int i = 0; i < help_template_count; i++) {
             char option_with_icon[32];
             snprintf(option_with_icon, sizeof(option_with_icon), "%s %s", 
-                    templates[i].icon, templates[i].flag);
+                    help_templates[i].icon, help_templates[i].flag);
             
             const char *row[] = {
                 option_with_icon,
-                templates[i].name,
-                templates[i].description
+                help_templates[i].name,
+                help_templates[i].description
             };
             
             cli_print_table_row(row, 3, widths);
@@ -116,11 +175,11 @@ void print_help(const char *prog) {
         cli_print_table_separator(widths, 3);
     } else {
         printf("AVAILABLE TEMPLATES:\n");
-        for (int i = 0; i < template_count; i++) {
+        for (int i = 0; i < help_template_count; i++) {
             printf("  %-18s %-20s %s\n", 
-                   templates[i].flag,
-                   templates[i].name, 
-                   templates[i].description);
+                   help_templates[i].flag,
+                   help_templates[i].name, 
+                   help_templates[i].description);
         }
     }
     
@@ -147,10 +206,28 @@ void print_help(const char *prog) {
         
         cli_print_option_help(&help_option);
         cli_print_option_help(&version_option);
+        for (int i = 0; i < init_option_count; i++) {
+            cli_print_option_help(&init_options[i]);
+        }
+        for (int i = 0; i < sync_option_count; i++) {
+            cli_print_option_help(&sync_options[i]);
+        }
+        for (int i = 0; i < copy_option_count; i++) {
+            cli_print_option_help(&copy_options[i]);
+        }
     } else {
         printf("OPTIONS:\n");
         printf("  -h, --help     Show this help message\n");
         printf("  -v, --version  Show version information\n");
+        for (int i = 0; i < init_option_count; i++) {
+            printf("  %-22s %s\n", init_options[i].long_flag, init_options[i].description);
+        }
+        for (int i = 0; i < sync_option_count; i++) {
+            printf("  %-22s %s\n", sync_options[i].long_flag, sync_options[i].description);
+        }
+        for (int i = 0; i < copy_option_count; i++) {
+            printf("  %-22s %s\n", copy_options[i].long_flag, copy_options[i].description);
+        }
     }
     
     printf("\n");
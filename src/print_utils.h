@@ -1,6 +1,18 @@
 #ifndef PRINT_UTILS_H
 #define PRINT_UTILS_H
 
+// Template options as listed by 'rpc help'; also the documents indexed for
+// 'rpc search' (see tools/mkindex.c)
+typedef struct {
+    const char *flag;
+    const char *name;
+    const char *description;
+    const char *icon;
+} template_info_t;
+
+extern const template_info_t help_templates[];
+extern const int help_template_count;
+
 void print_help(const char *prog);
 
 #endif // PRINT_UTILS_H
\ No newline at end of file
@@ -0,0 +1,169 @@
+// For writev and struct iovec
+#define _POSIX_C_SOURCE 200809L
+
+#include "render.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Output segments gathered per writev() call
+#define RENDER_IOV_BATCH 64
+
+static int is_key_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c == '.';
+}
+
+int render_vars_add(render_vars_t *vars, const char *assignment) {
+    const char *eq = strchr(assignment, '=');
+    if (!eq || eq == assignment || eq - assignment > RENDER_MAX_KEY) {
+        return -1;
+    }
+    for (const char *c = assignment; c < eq; c++) {
+        if (!is_key_char(*c)) return -1;
+    }
+
+    size_t key_len = (size_t)(eq - assignment);
+    render_var_t *slot = NULL;
+    for (int i = 0; i < vars->count; i++) {
+        if (vars->vars[i].key_len == key_len && memcmp(vars->vars[i].key, assignment, key_len) == 0) {
+            slot = &vars->vars[i]; // Last assignment wins
+            break;
+        }
+    }
+    if (!slot) {
+        if (vars->count >= RENDER_MAX_VARS) return -1;
+        slot = &vars->vars[vars->count++];
+    }
+
+    slot->key = assignment;
+    slot->key_len = key_len;
+    slot->value = eq + 1;
+    slot->value_len = strlen(eq + 1);
+    return 0;
+}
+
+// Returns the first "{{" in [p, end), or NULL
+const char *render_find_open(const char *p, const char *end) {
+#if defined(__SSE2__)
+    // Compare 16 bytes at p and at p + 1 against '{'; a set bit in both
+    // masks is the start of a "{{" pair
+    const __m128i brace = _mm_set1_epi8('{');
+    while (end - p >= 17) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(const void *)p);
+        __m128i b = _mm_loadu_si128((const __m128i *)(const void *)(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, brace), _mm_cmpeq_epi8(b, brace)));
+        if (mask) {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+        p += 16;
+    }
+#endif
+    while (end - p >= 2) {
+        p = memchr(p, '{', (size_t)(end - p - 1));
+        if (!p) return NULL;
+        if (p[1] == '{') return p;
+        p++;
+    }
+    return NULL;
+}
+
+int render_has_placeholders(const char *buf, size_t len) {
+    return render_find_open(buf, buf + len) != NULL;
+}
+
+// Parses "{{ key }}" at p. Returns the position after the closing braces and
+// the matching variable, or NULL when it is not a known placeholder.
+static const char *match_placeholder(const char *p, const char *end, const render_vars_t *vars,
+                                     const render_var_t **out) {
+    const char *q = p + 2;
+    while (q < end && *q == ' ') q++;
+
+    const char *key = q;
+    while (q < end && is_key_char(*q) && q - key <= RENDER_MAX_KEY) q++;
+    size_t key_len = (size_t)(q - key);
+
+    while (q < end && *q == ' ') q++;
+    if (key_len == 0 || end - q < 2 || q[0] != '}' || q[1] != '}') {
+        return NULL;
+    }
+
+    for (int i = 0; i < vars->count; i++) {
+        if (vars->vars[i].key_len == key_len && memcmp(vars->vars[i].key, key, key_len) == 0) {
+            *out = &vars->vars[i];
+            return q + 2;
+        }
+    }
+    return NULL; // Unknown keys are left as written
+}
+
+static int flush_iov(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // Skip fully written segments and trim a partially written one
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+int render_to_fd(int fd, const char *buf, size_t len, const render_vars_t *vars) {
+    struct iovec iov[RENDER_IOV_BATCH];
+    const int iov_cap = (int)(sizeof(iov) / sizeof(iov[0]));
+    int n = 0;
+
+    const char *end = buf + len;
+    const char *literal = buf;
+    const char *p = buf;
+
+    while ((p = render_find_open(p, end)) != NULL) {
+        const render_var_t *var = NULL;
+        const char *after = match_placeholder(p, end, vars, &var);
+        if (!after) {
+            p++;
+            continue;
+        }
+
+        if (n + 2 > iov_cap) {
+            if (flush_iov(fd, iov, n) != 0) return -1;
+            n = 0;
+        }
+        if (p > literal) {
+            iov[n].iov_base = (void *)literal;
+            iov[n].iov_len = (size_t)(p - literal);
+            n++;
+        }
+        if (var->value_len > 0) {
+            iov[n].iov_base = (void *)var->value;
+            iov[n].iov_len = var->value_len;
+            n++;
+        }
+        literal = p = after;
+    }
+
+    if (end > literal) {
+        if (n == iov_cap) {
+            if (flush_iov(fd, iov, n) != 0) return -1;
+            n = 0;
+        }
+        iov[n].iov_base = (void *)literal;
+        iov[n].iov_len = (size_t)(end - literal);
+        n++;
+    }
+    return flush_iov(fd, iov, n);
+}
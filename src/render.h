@@ -0,0 +1,29 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+
+// Template variables substituted into {{key}} placeholders while copying.
+// Keys and values point into caller-owned strings (normally argv), so
+// rendering never allocates.
+#define RENDER_MAX_VARS 32
+#define RENDER_MAX_KEY 64
+
+typedef struct {
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
+} render_var_t;
+
+typedef struct {
+    render_var_t vars[RENDER_MAX_VARS];
+    int count;
+} render_vars_t;
+
+int render_vars_add(render_vars_t *vars, const char *assignment);
+const char *render_find_open(const char *p, const char *end);
+int render_has_placeholders(const char *buf, size_t len);
+int render_to_fd(int fd, const char *buf, size_t len, const render_vars_t *vars);
+
+#endif // RENDER_H
@@ -0,0 +1,284 @@
+// For strdup
+#define _POSIX_C_SOURCE 200809L
+
+#include "replica.h"
+#include "copy.h"
+#include "pack.h"
+#include "pool.h"
+#include "render.h"
+#include "templates.h"
+#include "throttle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+struct replica_ctx {
+    replica_config_t config;
+    pool_t *pool;
+    pack_t *pack;         // opened from config.pack_path, NULL for the default pack
+    render_vars_t vars;   // points into var_storage
+    char **var_storage;
+    size_t var_count;
+    char *template_version;
+    throttle_t *throttle; // config.io_limit and iops_limit, NULL when unlimited
+    pthread_mutex_t lock; // guards operation results during a run
+};
+
+typedef struct {
+    replica_ctx_t *ctx;
+    const replica_op_t *op;
+    replica_result_t result;
+    size_t expected; // files a template operation must produce
+} op_state_t;
+
+static void set_failure(op_state_t *state, replica_status_t status, int error, const char *path) {
+    if (state->result.status != REPLICA_OK) {
+        return;
+    }
+    state->result.status = status;
+    state->result.error = error;
+    snprintf(state->result.path, sizeof(state->result.path), "%s", path ? path : "");
+}
+
+static void on_copy_event(const char *path, int error, void *tag, void *ctx) {
+    replica_ctx_t *rc = ctx;
+    op_state_t *state = tag;
+    if (!state) {
+        return;
+    }
+
+    pthread_mutex_lock(&rc->lock);
+    if (error == 0) {
+        state->result.files++;
+    } else {
+        set_failure(state, REPLICA_ERR_IO, error, path);
+    }
+    pthread_mutex_unlock(&rc->lock);
+
+    if (rc->config.on_file) {
+        rc->config.on_file(state->op, path, error, rc->config.user);
+    }
+}
+
+replica_status_t replica_new(replica_ctx_t **out, const replica_config_t *config) {
+    static const replica_config_t defaults = {0};
+    if (!out) {
+        return REPLICA_ERR_INVALID;
+    }
+    *out = NULL;
+    if (!config) {
+        config = &defaults;
+    }
+
+    replica_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return REPLICA_ERR_NO_MEMORY;
+    }
+    ctx->config = *config;
+    ctx->config.pack_path = NULL;
+    ctx->config.template_version = NULL;
+    ctx->config.vars = NULL;
+    pthread_mutex_init(&ctx->lock, NULL);
+
+    replica_status_t status = REPLICA_OK;
+    if (config->var_count > 0) {
+        ctx->var_storage = calloc(config->var_count, sizeof(char *));
+        if (!ctx->var_storage) {
+            status = REPLICA_ERR_NO_MEMORY;
+        }
+    }
+    for (size_t i = 0; status == REPLICA_OK && i < config->var_count; i++) {
+        ctx->var_storage[i] = strdup(config->vars[i]);
+        if (!ctx->var_storage[i]) {
+            status = REPLICA_ERR_NO_MEMORY;
+            break;
+        }
+        ctx->var_count++;
+        if (render_vars_add(&ctx->vars, ctx->var_storage[i]) != 0) {
+            status = REPLICA_ERR_INVALID;
+        }
+    }
+
+    if (status == REPLICA_OK && config->template_version) {
+        ctx->template_version = strdup(config->template_version);
+        if (!ctx->template_version) {
+            status = REPLICA_ERR_NO_MEMORY;
+        }
+    }
+
+    if (status == REPLICA_OK && config->pack_path) {
+        ctx->pack = pack_open(config->pack_path);
+        if (!ctx->pack) {
+            status = errno == ENOMEM ? REPLICA_ERR_NO_MEMORY : REPLICA_ERR_IO;
+        }
+    }
+
+    if (status == REPLICA_OK && (config->io_limit < 0 || config->iops_limit < 0)) {
+        status = REPLICA_ERR_INVALID;
+    } else if (status == REPLICA_OK && (config->io_limit > 0 || config->iops_limit > 0)) {
+        ctx->throttle = throttle_new(config->io_limit, config->iops_limit);
+        if (!ctx->throttle) {
+            status = REPLICA_ERR_NO_MEMORY;
+        }
+    }
+
+    if (status == REPLICA_OK) {
+        ctx->pool = pool_new(config->jobs);
+        if (!ctx->pool) {
+            status = REPLICA_ERR_NO_MEMORY;
+        }
+    }
+
+    if (status != REPLICA_OK) {
+        replica_free(ctx);
+        return status;
+    }
+    *out = ctx;
+    return REPLICA_OK;
+}
+
+void replica_free(replica_ctx_t *ctx) {
+    if (!ctx) return;
+
+    pool_free(ctx->pool);
+    pack_close(ctx->pack);
+    throttle_free(ctx->throttle);
+    for (size_t i = 0; i < ctx->var_count; i++) {
+        free(ctx->var_storage[i]);
+    }
+    free(ctx->var_storage);
+    free(ctx->template_version);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
+// Turns template operations into copy requests; the rest are checked here and
+// run afterwards
+static size_t plan_requests(op_state_t *states, size_t count, copy_request_t *requests) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        op_state_t *state = &states[i];
+        const replica_op_t *op = state->op;
+
+        if (!op->dest || op->dest[0] == '\0') {
+            set_failure(state, REPLICA_ERR_INVALID, EINVAL, NULL);
+            continue;
+        }
+
+        switch (op->kind) {
+        case REPLICA_OP_TEMPLATE:
+            if (!op->name) {
+                set_failure(state, REPLICA_ERR_INVALID, EINVAL, NULL);
+            } else if (strcmp(op->name, "all") == 0) {
+                for (int s = 0; s < template_set_count; s++) {
+                    requests[n++] = (copy_request_t){ .set = &template_sets[s], .dest = op->dest, .tag = state };
+                    state->expected += 2;
+                }
+            } else {
+                const template_set_t *set = template_set_find(op->name);
+                if (!set) {
+                    set_failure(state, REPLICA_ERR_NO_TEMPLATE, ENOENT, op->name);
+                } else {
+                    requests[n++] = (copy_request_t){ .set = set, .dest = op->dest, .tag = state };
+                    state->expected = 2;
+                }
+            }
+            break;
+        case REPLICA_OP_TREE:
+            if (!op->source) {
+                set_failure(state, REPLICA_ERR_INVALID, EINVAL, NULL);
+            }
+            break;
+        default:
+            set_failure(state, REPLICA_ERR_INVALID, EINVAL, NULL);
+            break;
+        }
+    }
+    return n;
+}
+
+replica_status_t replica_run(replica_ctx_t *ctx, const replica_op_t *ops, size_t count,
+                             replica_result_t *results) {
+    if (!ctx || (!ops && count > 0)) {
+        return REPLICA_ERR_INVALID;
+    }
+    if (count == 0) {
+        return REPLICA_OK;
+    }
+
+    op_state_t *states = calloc(count, sizeof(op_state_t));
+    copy_request_t *requests = malloc(count * (size_t)template_set_count * sizeof(copy_request_t));
+    if (!states || !requests) {
+        free(states);
+        free(requests);
+        return REPLICA_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        states[i].ctx = ctx;
+        states[i].op = &ops[i];
+    }
+
+    copy_options_t options = {
+        .vars = ctx->vars.count > 0 ? &ctx->vars : NULL,
+        .pool = ctx->pool,
+        .pack = ctx->pack,
+        .no_cache = ctx->config.no_cache,
+        .throttle = ctx->throttle,
+        .template_version = ctx->template_version,
+        .on_file = on_copy_event,
+        .event_ctx = ctx,
+    };
+
+    // All template sets of the batch form a single plan
+    size_t request_count = plan_requests(states, count, requests);
+    if (request_count > 0) {
+        copy_templates_with(&options, requests, (int)request_count);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        op_state_t *state = &states[i];
+        if (state->result.status != REPLICA_OK) {
+            continue;
+        }
+        if (state->op->kind == REPLICA_OP_TREE) {
+            errno = 0;
+            if (copy_directory_with(&options, state->op->source, state->op->dest, state) != 0) {
+                set_failure(state, REPLICA_ERR_IO, errno ? errno : EIO, state->op->source);
+            }
+        } else if (state->result.files < state->expected) {
+            // Planning ran out of memory, or a directory failed and its
+            // copies were skipped without an event of their own
+            set_failure(state, REPLICA_ERR_IO, ECANCELED, state->op->dest);
+        }
+    }
+
+    replica_status_t status = REPLICA_OK;
+    for (size_t i = 0; i < count; i++) {
+        if (status == REPLICA_OK) {
+            status = states[i].result.status;
+        }
+        if (results) {
+            results[i] = states[i].result;
+        }
+        if (ctx->config.on_done) {
+            ctx->config.on_done(&ops[i], &states[i].result, ctx->config.user);
+        }
+    }
+
+    free(requests);
+    free(states);
+    return status;
+}
+
+const char *replica_strerror(replica_status_t status) {
+    switch (status) {
+    case REPLICA_OK: return "success";
+    case REPLICA_ERR_INVALID: return "invalid operation or configuration";
+    case REPLICA_ERR_NO_TEMPLATE: return "unknown template set";
+    case REPLICA_ERR_IO: return "file could not be read or written";
+    case REPLICA_ERR_NO_MEMORY: return "out of memory";
+    }
+    return "unknown error";
+}
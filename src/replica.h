@@ -0,0 +1,83 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+// libreplica: install templates and copy trees in-process.
+//
+// A context owns a worker pool and an open template pack that are reused by
+// every call. Operations are passed in batches; template operations of one
+// batch are planned together, so shared directories are created once and
+// all copies run in parallel. Progress is reported through callbacks rather
+// than printed; only unexpected failures are also logged to stderr. A
+// context must not be used from two threads at once.
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define REPLICA_API __attribute__((visibility("default")))
+#else
+#define REPLICA_API
+#endif
+
+typedef enum {
+    REPLICA_OK = 0,
+    REPLICA_ERR_INVALID = 1,     // malformed operation or configuration
+    REPLICA_ERR_NO_TEMPLATE = 2, // unknown template set name
+    REPLICA_ERR_IO = 3,          // a file could not be read or written, see error/path
+    REPLICA_ERR_NO_MEMORY = 4,
+} replica_status_t;
+
+typedef enum {
+    REPLICA_OP_TEMPLATE, // install template set `name` ("all" for every set) into dest
+    REPLICA_OP_TREE,     // copy the directory tree `source` to dest
+} replica_op_kind_t;
+
+typedef struct {
+    replica_op_kind_t kind;
+    const char *name;   // REPLICA_OP_TEMPLATE
+    const char *source; // REPLICA_OP_TREE
+    const char *dest;
+    void *user;         // handed back in callbacks
+} replica_op_t;
+
+typedef struct {
+    replica_status_t status;
+    int error;           // errno value for REPLICA_ERR_IO
+    char path[1024];     // first path that failed
+    size_t files;        // files written
+} replica_result_t;
+
+// Called for every file written, or that failed with error != 0. Runs on the
+// context's worker threads.
+typedef void (*replica_file_fn)(const replica_op_t *op, const char *path, int error, void *user);
+
+// Called on the calling thread once an operation has finished.
+typedef void (*replica_done_fn)(const replica_op_t *op, const replica_result_t *result, void *user);
+
+typedef struct {
+    int jobs;                  // worker threads, 0 for one per CPU
+    const char *pack_path;     // template pack, NULL for the installed one
+    const char *template_version; // store version to install, NULL for the current one
+    const char *const *vars;   // "key=value" placeholder substitutions
+    size_t var_count;
+    int no_cache;              // keep large copies out of the page cache
+    long long io_limit;        // bytes per second across all workers, 0 for no limit
+    long long iops_limit;      // I/O operations per second across all workers, 0 for no limit
+    replica_file_fn on_file;
+    replica_done_fn on_done;
+    void *user;                // passed to both callbacks
+} replica_config_t;
+
+typedef struct replica_ctx replica_ctx_t;
+
+REPLICA_API replica_status_t replica_new(replica_ctx_t **ctx, const replica_config_t *config);
+REPLICA_API void replica_free(replica_ctx_t *ctx);
+
+// Runs count operations. results, when not NULL, receives one entry per
+// operation. Returns REPLICA_OK when every operation succeeded, otherwise the
+// status of the first one that failed.
+REPLICA_API replica_status_t replica_run(replica_ctx_t *ctx, const replica_op_t *ops, size_t count,
+                                         replica_result_t *results);
+
+REPLICA_API const char *replica_strerror(replica_status_t status);
+
+#endif // REPLICA_H
@@ -0,0 +1,348 @@
+// For d_type, strdup and mkstemp
+#define _GNU_SOURCE
+
+#include "roots.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "templates.h"
+
+#define STAMP_SIZE 64
+
+typedef struct {
+    char *sub_path;
+    int root;
+} root_entry_t;
+
+static const char *template_dirs[] = {TEMPLATE_PROMPTS_DIR, TEMPLATE_INSTRUCTIONS_DIR};
+
+static struct {
+    pthread_once_t once;
+    int count;
+    char *paths[ROOTS_MAX];
+    char stamps[ROOTS_MAX][2][STAMP_SIZE]; // per template directory, "-" when missing
+    root_entry_t *entries;
+    size_t entry_count;
+    size_t entry_cap;
+    size_t *table; // entry index + 1, 0 for an empty slot
+    size_t table_size;
+} roots = { .once = PTHREAD_ONCE_INIT };
+
+static uint64_t fnv1a(const char *data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *data; data++) {
+        hash ^= (unsigned char)*data;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void add_root(const char *path) {
+    if (path[0] != '\0' && roots.count < ROOTS_MAX) {
+        roots.paths[roots.count] = strdup(path);
+        if (roots.paths[roots.count]) {
+            roots.count++;
+        }
+    }
+}
+
+static void discover_roots(void) {
+    const char *list = getenv("REPLICA_TEMPLATE_PATH");
+    if (list) {
+        char *copy = strdup(list);
+        char *save = NULL;
+        for (char *p = copy ? strtok_r(copy, ":", &save) : NULL; p; p = strtok_r(NULL, ":", &save)) {
+            add_root(p);
+        }
+        free(copy);
+        return;
+    }
+
+    char path[PATH_MAX];
+    add_root("/etc/replica");
+    const char *data_home = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    if (data_home && data_home[0] == '/') {
+        snprintf(path, sizeof(path), "%s/replica", data_home);
+        add_root(path);
+    } else if (home) {
+        snprintf(path, sizeof(path), "%s/.local/share/replica", home);
+        add_root(path);
+    }
+    // Absolute, so the cache key doesn't depend on how rpc was started
+    if (getcwd(path, sizeof(path) - sizeof("/.replica"))) {
+        strcat(path, "/.replica");
+        add_root(path);
+    }
+}
+
+// Inode and mtime of a template directory: files added, removed or renamed
+// in it change the mtime, and a replaced directory changes the inode
+static int stamp_dir(const char *root, const char *dir, char stamp[STAMP_SIZE]) {
+    char path[PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s%s", root, dir);
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        snprintf(stamp, STAMP_SIZE, "-");
+        return 0;
+    }
+    snprintf(stamp, STAMP_SIZE, "%llu:%lld.%09ld", (unsigned long long)st.st_ino,
+             (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    return 1;
+}
+
+static size_t *table_slot(const char *sub_path) {
+    size_t mask = roots.table_size - 1;
+    size_t i = (size_t)fnv1a(sub_path) & mask;
+    while (roots.table[i] && strcmp(roots.entries[roots.table[i] - 1].sub_path, sub_path) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &roots.table[i];
+}
+
+static int table_grow(void) {
+    size_t size = roots.table_size ? roots.table_size * 2 : 64;
+    size_t *table = calloc(size, sizeof(size_t));
+    if (!table) {
+        return -1;
+    }
+    free(roots.table);
+    roots.table = table;
+    roots.table_size = size;
+    for (size_t e = 0; e < roots.entry_count; e++) {
+        *table_slot(roots.entries[e].sub_path) = e + 1;
+    }
+    return 0;
+}
+
+// Records that root provides sub_path; higher roots are added later and win
+static int index_put(const char *sub_path, int root) {
+    if ((roots.entry_count + 1) * 2 > roots.table_size && table_grow() != 0) {
+        return -1;
+    }
+    size_t *slot = table_slot(sub_path);
+    if (*slot) {
+        roots.entries[*slot - 1].root = root;
+        return 0;
+    }
+
+    if (roots.entry_count == roots.entry_cap) {
+        size_t cap = roots.entry_cap ? roots.entry_cap * 2 : 32;
+        root_entry_t *entries = realloc(roots.entries, cap * sizeof(root_entry_t));
+        if (!entries) return -1;
+        roots.entries = entries;
+        roots.entry_cap = cap;
+    }
+    root_entry_t *entry = &roots.entries[roots.entry_count];
+    entry->sub_path = strdup(sub_path);
+    entry->root = root;
+    if (!entry->sub_path) {
+        return -1;
+    }
+    *slot = ++roots.entry_count;
+    return 0;
+}
+
+static void index_clear(void) {
+    for (size_t e = 0; e < roots.entry_count; e++) {
+        free(roots.entries[e].sub_path);
+    }
+    roots.entry_count = 0;
+    if (roots.table) {
+        memset(roots.table, 0, roots.table_size * sizeof(size_t));
+    }
+}
+
+static int scan_roots(void) {
+    for (int r = 0; r < roots.count; r++) {
+        for (int d = 0; d < 2; d++) {
+            if (strcmp(roots.stamps[r][d], "-") == 0) {
+                continue;
+            }
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s%s", roots.paths[r], template_dirs[d]);
+            DIR *dir = opendir(path);
+            if (!dir) {
+                continue;
+            }
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL) {
+                if (entry->d_name[0] == '.' || entry->d_type == DT_DIR || strchr(entry->d_name, '\n')) {
+                    continue;
+                }
+                char sub_path[PATH_MAX];
+                snprintf(sub_path, sizeof(sub_path), "%s/%s", template_dirs[d], entry->d_name);
+                if (index_put(sub_path, r) != 0) {
+                    closedir(dir);
+                    return -1;
+                }
+            }
+            closedir(dir);
+        }
+    }
+    return 0;
+}
+
+static int cache_path(char *path, size_t size, int create) {
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+    if (cache_home && cache_home[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s", cache_home);
+    } else if (home) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    if (create) {
+        mkdir(dir, 0755);
+    }
+    size_t len = strlen(dir);
+    snprintf(dir + len, sizeof(dir) - len, "/replica");
+    if (create) {
+        mkdir(dir, 0755);
+    }
+
+    // One cache per list of roots, so projects don't evict each other
+    char key[ROOTS_MAX * PATH_MAX] = "";
+    for (int r = 0; r < roots.count; r++) {
+        strcat(key, roots.paths[r]);
+        strcat(key, ":");
+    }
+    snprintf(path, size, "%s/roots-%016llx", dir, (unsigned long long)fnv1a(key));
+    return 0;
+}
+
+// Loads the cached index if it was written for the current stamps
+static int load_cache(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    char line[PATH_MAX + 64];
+    int valid = fgets(line, sizeof(line), f) && strcmp(line, ROOTS_CACHE_HEADER "\n") == 0;
+    int roots_seen = 0;
+    while (valid && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        int root;
+        int offset = 0;
+        char stamps[2][STAMP_SIZE];
+        if (sscanf(line, "root %d %63s %63s", &root, stamps[0], stamps[1]) == 3) {
+            valid = root == roots_seen && root < roots.count &&
+                    strcmp(stamps[0], roots.stamps[root][0]) == 0 && strcmp(stamps[1], roots.stamps[root][1]) == 0;
+            roots_seen++;
+        } else if (sscanf(line, "file %d %n", &root, &offset) == 1 && offset > 0 && root >= 0 && root < roots.count) {
+            valid = index_put(line + offset, root) == 0;
+        } else {
+            valid = 0;
+        }
+    }
+    fclose(f);
+
+    if (!valid || roots_seen != roots.count) {
+        index_clear();
+        return -1;
+    }
+    return 0;
+}
+
+// Best effort: without a writable cache, the roots are listed every run
+static void save_cache(const char *path) {
+    char temp[PATH_MAX + 8];
+    snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        return;
+    }
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        unlink(temp);
+        return;
+    }
+
+    fprintf(f, "%s\n", ROOTS_CACHE_HEADER);
+    for (int r = 0; r < roots.count; r++) {
+        fprintf(f, "root %d %s %s\n", r, roots.stamps[r][0], roots.stamps[r][1]);
+    }
+    for (size_t e = 0; e < roots.entry_count; e++) {
+        fprintf(f, "file %d %s\n", roots.entries[e].root, roots.entries[e].sub_path);
+    }
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed || rename(temp, path) != 0) {
+        unlink(temp);
+    }
+}
+
+static void roots_init(void) {
+    discover_roots();
+
+    int present = 0;
+    for (int r = 0; r < roots.count; r++) {
+        for (int d = 0; d < 2; d++) {
+            present += stamp_dir(roots.paths[r], template_dirs[d], roots.stamps[r][d]);
+        }
+    }
+    if (present == 0) {
+        return; // Nothing to overlay; no cache needed
+    }
+
+    char path[PATH_MAX];
+    int have_cache = cache_path(path, sizeof(path), 0) == 0;
+    if (have_cache && load_cache(path) == 0) {
+        return;
+    }
+    if (scan_roots() != 0) {
+        fprintf(stderr, "Error indexing template roots: %s\n", strerror(errno));
+        index_clear();
+        return;
+    }
+    if (have_cache && cache_path(path, sizeof(path), 1) == 0) {
+        save_cache(path);
+    }
+}
+
+int roots_count(void) {
+    pthread_once(&roots.once, roots_init);
+    return roots.count;
+}
+
+const char *roots_path(int index) {
+    pthread_once(&roots.once, roots_init);
+    return index >= 0 && index < roots.count ? roots.paths[index] : NULL;
+}
+
+int roots_find(const char *sub_path, char *path, size_t size) {
+    pthread_once(&roots.once, roots_init);
+    if (roots.entry_count == 0) {
+        return 0;
+    }
+    size_t entry = *table_slot(sub_path);
+    if (!entry) {
+        return 0;
+    }
+    snprintf(path, size, "%s%s", roots.paths[roots.entries[entry - 1].root], sub_path);
+    return 1;
+}
+
+size_t roots_entry_count(void) {
+    pthread_once(&roots.once, roots_init);
+    return roots.entry_count;
+}
+
+const char *roots_entry_at(size_t index, int *root) {
+    pthread_once(&roots.once, roots_init);
+    if (index >= roots.entry_count) {
+        return NULL;
+    }
+    *root = roots.entries[index].root;
+    return roots.entries[index].sub_path;
+}
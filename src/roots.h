@@ -0,0 +1,39 @@
+#ifndef ROOTS_H
+#define ROOTS_H
+
+#include <stddef.h>
+
+// Layered template roots. The datadir (or the selected store version) is
+// the system root; overlay roots on top of it can replace any of its
+// templates by providing a file at the same path, e.g.
+// <root>/.github/prompts/SECURITY.prompt.md. Overlays, lowest priority
+// first:
+//   site     /etc/replica
+//   user     $XDG_DATA_HOME/replica (~/.local/share/replica)
+//   project  ./.replica
+// $REPLICA_TEMPLATE_PATH, a colon-separated list in the same order,
+// replaces these; set it empty to disable overlays.
+//
+// The overlays are merged into one hash index from template path to root.
+// The index is cached under $XDG_CACHE_HOME/replica (~/.cache/replica),
+// one file per list of roots. The cache stays valid while the template
+// directories of every root keep their inode and mtime, so a warm start
+// costs one stat per directory instead of listing them.
+
+#define ROOTS_MAX 8
+#define ROOTS_CACHE_HEADER "# replica roots 1"
+
+// Number of overlay roots and their paths, lowest priority first
+int roots_count(void);
+const char *roots_path(int index);
+
+// Writes the path of the topmost overlay file for sub_path (e.g.
+// "/.github/prompts/SECURITY.prompt.md") into path. Returns 1 when an
+// overlay provides it, 0 when the system root does.
+int roots_find(const char *sub_path, char *path, size_t size);
+
+// The merged index, for listing: sub_path and the root that provides it
+size_t roots_entry_count(void);
+const char *roots_entry_at(size_t index, int *root);
+
+#endif // ROOTS_H
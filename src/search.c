@@ -0,0 +1,141 @@
+#include "search.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stop_words[] = {
+    "an", "and", "any", "are", "as", "at", "be", "by", "can", "do", "for", "from", "has", "have",
+    "if", "in", "into", "is", "it", "its", "of", "on", "or", "our", "that", "the", "their", "them",
+    "then", "there", "these", "this", "to", "use", "was", "we", "what", "when", "which", "will",
+    "with", "you", "your",
+};
+
+static int is_stop_word(const char *term) {
+    for (size_t i = 0; i < sizeof(stop_words) / sizeof(stop_words[0]); i++) {
+        if (strcmp(stop_words[i], term) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_term_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+// "policies" -> "policy", "templates" -> "template"; "ss" endings such as
+// "process" are left alone
+static void fold_plural(char *term, size_t len) {
+    if (len > 4 && strcmp(term + len - 3, "ies") == 0) {
+        strcpy(term + len - 3, "y");
+    } else if (len > 3 && term[len - 1] == 's' && term[len - 2] != 's') {
+        term[len - 1] = '\0';
+    }
+}
+
+int search_next_term(const char **text, const char *end, char term[SEARCH_TERM_MAX]) {
+    const char *p = *text;
+    while (p < end) {
+        while (p < end && !is_term_char(*p)) {
+            p++;
+        }
+        const char *start = p;
+        while (p < end && is_term_char(*p)) {
+            p++;
+        }
+        size_t len = (size_t)(p - start);
+        if (len < 2 || len >= SEARCH_TERM_MAX) {
+            continue;
+        }
+
+        for (size_t i = 0; i < len; i++) {
+            term[i] = start[i] >= 'A' && start[i] <= 'Z' ? (char)(start[i] - 'A' + 'a') : start[i];
+        }
+        term[len] = '\0';
+        if (is_stop_word(term)) {
+            continue;
+        }
+        fold_plural(term, len);
+        *text = p;
+        return 1;
+    }
+    *text = p;
+    return 0;
+}
+
+// First table entry whose term is not less than term
+static int lower_bound(const search_index_t *index, const char *term) {
+    int low = 0;
+    int high = index->term_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (strcmp(index->terms + index->table[mid].term, term) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int compare_hits(const void *a, const void *b) {
+    const search_hit_t *x = a;
+    const search_hit_t *y = b;
+    if (x->matched != y->matched) {
+        return y->matched - x->matched;
+    }
+    if (x->score != y->score) {
+        return x->score < y->score ? 1 : -1;
+    }
+    return x->doc - y->doc;
+}
+
+int search_query(const search_index_t *index, const char *query, search_hit_t *hits, int max) {
+    search_hit_t *docs = calloc((size_t)index->doc_count, sizeof(search_hit_t));
+    int *seen = calloc((size_t)index->doc_count, sizeof(int)); // last query term that matched each doc
+    if (!docs || !seen) {
+        free(docs);
+        free(seen);
+        return 0;
+    }
+    for (int d = 0; d < index->doc_count; d++) {
+        docs[d].doc = d;
+    }
+
+    const char *p = query;
+    const char *end = query + strlen(query);
+    char term[SEARCH_TERM_MAX];
+    int query_terms = 0;
+    while (search_next_term(&p, end, term)) {
+        query_terms++;
+        size_t len = strlen(term);
+        for (int t = lower_bound(index, term); t < index->term_count; t++) {
+            const search_term_t *entry = &index->table[t];
+            const char *candidate = index->terms + entry->term;
+            if (strncmp(candidate, term, len) != 0) {
+                break;
+            }
+
+            // Rarer terms say more about a document
+            double idf = (double)index->doc_count / entry->count;
+            double factor = candidate[len] == '\0' ? 1.0 : 0.5;
+            for (int i = 0; i < entry->count; i++) {
+                const unsigned char *posting = index->postings + 2 * (entry->first + (uint32_t)i);
+                search_hit_t *hit = &docs[posting[0]];
+                hit->score += posting[1] * idf * factor;
+                if (seen[posting[0]] != query_terms) {
+                    seen[posting[0]] = query_terms;
+                    hit->matched++;
+                }
+            }
+        }
+    }
+
+    qsort(docs, (size_t)index->doc_count, sizeof(search_hit_t), compare_hits);
+    int count = 0;
+    for (int d = 0; d < index->doc_count && count < max && docs[d].matched > 0; d++) {
+        hits[count++] = docs[d];
+    }
+    free(docs);
+    free(seen);
+    return count;
+}
@@ -0,0 +1,55 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Inverted index over the templates listed by 'rpc help': each document is
+// one entry of help_templates[], made of its flag, name, description and the
+// bodies of its prompt and instructions files. The index is generated at
+// build time by tools/mkindex.c and compiled into rpc, so a query never opens
+// a template.
+//
+// Terms are lowercased alphanumeric runs with plurals folded ("templates"
+// and "template" are one term) and stop words dropped. Each posting is a
+// (document, weight) byte pair; the weight favours the flag and name over
+// the description, and the description over the body.
+
+#define SEARCH_TERM_MAX 32
+#define SEARCH_WEIGHT_FLAG 24 // term appears in the flag or name
+#define SEARCH_WEIGHT_DESCRIPTION 8
+#define SEARCH_WEIGHT_BODY_MAX 16 // body occurrences count up to this
+
+typedef struct {
+    uint32_t term;    // offset into terms
+    uint32_t first;   // first posting
+    uint16_t count;   // postings, i.e. documents containing the term
+} search_term_t;
+
+typedef struct {
+    const char *terms;             // NUL-separated, sorted
+    const search_term_t *table;    // sorted by term
+    int term_count;
+    const unsigned char *postings; // (document, weight) pairs
+    int doc_count;
+} search_index_t;
+
+typedef struct {
+    int doc;     // index into help_templates[]
+    int matched; // query terms found in the document
+    double score;
+} search_hit_t;
+
+// The index generated for this build
+extern const search_index_t search_index;
+
+// Copies the next term of text into term and advances *text. Returns 0 once
+// the text is exhausted.
+int search_next_term(const char **text, const char *end, char term[SEARCH_TERM_MAX]);
+
+// Ranks documents for a query: documents matching more query terms first,
+// then by tf-idf. A query term also matches longer terms it is a prefix of,
+// at half weight. Returns the number of hits written, at most max.
+int search_query(const search_index_t *index, const char *query, search_hit_t *hits, int max);
+
+#endif // SEARCH_H
@@ -0,0 +1,110 @@
+#include "sha1.h"
+#include <string.h>
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(sha1_t *ctx, const unsigned char *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3], e = ctx->state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = ROTL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROTL(b, 30);
+        b = a;
+        a = t;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+}
+
+void sha1_init(sha1_t *ctx) {
+    static const uint32_t initial[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void sha1_update(sha1_t *ctx, const void *data, size_t size) {
+    const unsigned char *p = data;
+    ctx->length += size;
+
+    if (ctx->used > 0) {
+        size_t take = sizeof(ctx->block) - ctx->used;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(ctx->block + ctx->used, p, take);
+        ctx->used += take;
+        p += take;
+        size -= take;
+        if (ctx->used < sizeof(ctx->block)) {
+            return;
+        }
+        sha1_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+
+    for (; size >= sizeof(ctx->block); p += sizeof(ctx->block), size -= sizeof(ctx->block)) {
+        sha1_block(ctx, p);
+    }
+    memcpy(ctx->block, p, size);
+    ctx->used = size;
+}
+
+void sha1_final(sha1_t *ctx, unsigned char digest[SHA1_DIGEST_SIZE]) {
+    uint64_t bits = ctx->length * 8;
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(ctx->block + ctx->used, 0, sizeof(ctx->block) - ctx->used);
+        sha1_block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (unsigned char)(bits >> (56 - i * 8));
+    }
+    sha1_block(ctx, ctx->block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->state[i];
+    }
+}
+
+void sha1_to_hex(const unsigned char digest[SHA1_DIGEST_SIZE], char hex[SHA1_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0xf];
+    }
+    hex[SHA1_HEX_SIZE - 1] = '\0';
+}
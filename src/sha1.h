@@ -0,0 +1,26 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIPS 180-4 SHA-1, for git object ids and the index checksum
+
+#define SHA1_DIGEST_SIZE 20
+#define SHA1_HEX_SIZE (SHA1_DIGEST_SIZE * 2 + 1)
+
+typedef struct {
+    uint32_t state[5];
+    uint64_t length; // bytes hashed so far
+    unsigned char block[64];
+    size_t used;     // bytes waiting in block
+} sha1_t;
+
+void sha1_init(sha1_t *ctx);
+void sha1_update(sha1_t *ctx, const void *data, size_t size);
+void sha1_final(sha1_t *ctx, unsigned char digest[SHA1_DIGEST_SIZE]);
+
+// Writes the lowercase hex form of a digest, NUL-terminated
+void sha1_to_hex(const unsigned char digest[SHA1_DIGEST_SIZE], char hex[SHA1_HEX_SIZE]);
+
+#endif // SHA1_H
@@ -0,0 +1,26 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIPS 180-4 SHA-256, used to address objects in the template store
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_HEX_SIZE (SHA256_DIGEST_SIZE * 2 + 1)
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length; // bytes hashed so far
+    unsigned char block[64];
+    size_t used;     // bytes waiting in block
+} sha256_t;
+
+void sha256_init(sha256_t *ctx);
+void sha256_update(sha256_t *ctx, const void *data, size_t size);
+void sha256_final(sha256_t *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+// Writes the lowercase hex digest of data, NUL-terminated
+void sha256_hex(const void *data, size_t size, char hex[SHA256_HEX_SIZE]);
+
+#endif // SHA256_H
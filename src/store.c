@@ -0,0 +1,462 @@
+// For mkstemp, readlink, symlink, openat and strdup
+#define _POSIX_C_SOURCE 200809L
+
+#include "store.h"
+#include "sha256.h"
+#include "templates.h"
+#include "walk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef REPLICA_DATADIR
+#define REPLICA_DATADIR "."
+#endif
+
+struct store_manifest {
+    char *data; // manifest file contents; entries point into it
+    store_entry_t *entries;
+    size_t count;
+};
+
+const char *store_default_root(void) {
+    const char *root = getenv("REPLICA_STORE");
+    return root ? root : REPLICA_DATADIR "/" STORE_DIR_NAME;
+}
+
+// Version names become file names under versions/
+static int valid_version(const char *version) {
+    size_t len = strlen(version);
+    if (len == 0 || len >= STORE_VERSION_MAX || version[0] == '.' || strchr(version, '/')) {
+        fprintf(stderr, "Invalid template version name '%s'\n", version);
+        return 0;
+    }
+    return 1;
+}
+
+static int make_dir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static char *read_fd(int fd, size_t *size) {
+    size_t cap = 4096;
+    size_t used = 0;
+    char *data = malloc(cap + 1);
+    while (data) {
+        if (used == cap) {
+            char *grown = realloc(data, cap * 2 + 1);
+            if (!grown) {
+                free(data);
+                return NULL;
+            }
+            data = grown;
+            cap *= 2;
+        }
+        ssize_t n = read(fd, data + used, cap - used);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            free(data);
+            return NULL;
+        }
+        if (n == 0) {
+            break;
+        }
+        used += (size_t)n;
+    }
+    if (data) {
+        data[used] = '\0';
+        *size = used;
+    }
+    return data;
+}
+
+static int write_fd(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+// Writes data to a temporary file in dir, then renames it to path, so
+// readers see either nothing or the complete file
+static int write_atomic(const char *dir, const char *path, const char *data, size_t size) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s/.tmp-XXXXXX", dir);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        fprintf(stderr, "Error creating a file in '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    int result = write_fd(fd, data, size) == 0 && fchmod(fd, 0644) == 0 && fsync(fd) == 0 ? 0 : -1;
+    if (close(fd) != 0) {
+        result = -1;
+    }
+    if (result == 0 && rename(tmp, path) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+        unlink(tmp);
+    }
+    return result;
+}
+
+void store_object_path(const char *root, const char *hash, char *path, size_t size) {
+    snprintf(path, size, "%s/objects/%.2s/%s", root, hash, hash + 2);
+}
+
+typedef struct {
+    const char *root;
+    const char *tree;   // template tree being imported
+    const char *subdir; // the same tree relative to the datadir
+    char *manifest;     // "<hash> <mode> <size> <path>" lines, unsorted
+    size_t manifest_size;
+    size_t manifest_cap;
+    size_t lines;
+    int added;
+    int result;
+} import_state_t;
+
+static int append_line(import_state_t *state, const char *line) {
+    size_t len = strlen(line);
+    if (state->manifest_size + len + 1 > state->manifest_cap) {
+        size_t cap = state->manifest_cap ? state->manifest_cap * 2 : 4096;
+        while (cap < state->manifest_size + len + 1) {
+            cap *= 2;
+        }
+        char *grown = realloc(state->manifest, cap);
+        if (!grown) {
+            return -1;
+        }
+        state->manifest = grown;
+        state->manifest_cap = cap;
+    }
+    memcpy(state->manifest + state->manifest_size, line, len + 1);
+    state->manifest_size += len;
+    state->lines++;
+    return 0;
+}
+
+// Stores one file as an object unless its hash is already present
+static int import_entry(const walk_entry_t *entry, void *ctx) {
+    import_state_t *state = ctx;
+    if (entry->type != WALK_FILE) {
+        return WALK_CONTINUE;
+    }
+
+    int fd = openat(entry->dirfd, entry->name, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    size_t size = 0;
+    char *data = NULL;
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+        data = read_fd(fd, &size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!data) {
+        fprintf(stderr, "Error reading '%s/%s': %s\n", state->tree, entry->path, strerror(errno));
+        state->result = -1;
+        return WALK_CONTINUE;
+    }
+
+    char hash[SHA256_HEX_SIZE];
+    sha256_hex(data, size, hash);
+
+    char dir[4096];
+    char path[4200];
+    snprintf(dir, sizeof(dir), "%s/objects/%.2s", state->root, hash);
+    store_object_path(state->root, hash, path, sizeof(path));
+    if (access(path, F_OK) != 0) {
+        if (make_dir(dir) != 0 || write_atomic(dir, path, data, size) != 0) {
+            state->result = -1;
+        } else {
+            state->added++;
+        }
+    }
+    free(data);
+
+    char line[4400];
+    snprintf(line, sizeof(line), "%s %o %zu %s/%s\n", hash, (unsigned)(st.st_mode & 07777), size, state->subdir, entry->path);
+    if (append_line(state, line) != 0) {
+        state->result = -1;
+    }
+    return WALK_CONTINUE;
+}
+
+static int compare_lines(const void *a, const void *b) {
+    // Lines sort by path, which follows the three fixed fields
+    const char *pa = strchr(strchr(strchr(*(char *const *)a, ' ') + 1, ' ') + 1, ' ') + 1;
+    const char *pb = strchr(strchr(strchr(*(char *const *)b, ' ') + 1, ' ') + 1, ' ') + 1;
+    return strcmp(pa, pb);
+}
+
+// Sorts the collected lines by path and writes the finished manifest
+static int write_manifest(import_state_t *state, const char *version) {
+    char **lines = malloc((state->lines ? state->lines : 1) * sizeof(char *));
+    if (!lines) {
+        return -1;
+    }
+    size_t n = 0;
+    for (char *p = state->manifest; n < state->lines; p = strchr(p, '\n') + 1) {
+        lines[n++] = p;
+    }
+    for (size_t i = 0; i < n; i++) {
+        *strchr(lines[i], '\n') = '\0';
+    }
+    qsort(lines, n, sizeof(char *), compare_lines);
+
+    size_t total = strlen(STORE_MANIFEST_HEADER) + 2;
+    for (size_t i = 0; i < n; i++) {
+        total += strlen(lines[i]) + 1;
+    }
+    char *out = malloc(total);
+    int result = -1;
+    if (out) {
+        size_t used = (size_t)sprintf(out, "%s\n", STORE_MANIFEST_HEADER);
+        for (size_t i = 0; i < n; i++) {
+            used += (size_t)sprintf(out + used, "%s\n", lines[i]);
+        }
+
+        char dir[4096];
+        char path[4200];
+        snprintf(dir, sizeof(dir), "%s/versions", state->root);
+        snprintf(path, sizeof(path), "%s/%s", dir, version);
+        result = write_atomic(dir, path, out, used);
+    }
+    free(out);
+    free(lines);
+    return result;
+}
+
+int store_import(const char *root, const char *version, const char *source_dir) {
+    if (!valid_version(version)) {
+        return -1;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/objects", root);
+    if (make_dir(root) != 0 || make_dir(path) != 0) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/versions", root);
+    if (make_dir(path) != 0) {
+        return -1;
+    }
+
+    import_state_t state = { .root = root };
+    const char *subdirs[] = {TEMPLATE_PROMPTS_DIR, TEMPLATE_INSTRUCTIONS_DIR};
+    for (int i = 0; i < 2 && state.result == 0; i++) {
+        char tree[4096];
+        snprintf(tree, sizeof(tree), "%s%s", source_dir, subdirs[i]);
+        state.tree = tree;
+        state.subdir = subdirs[i];
+        if (walk_tree(tree, NULL, import_entry, &state) != 0) {
+            fprintf(stderr, "Error reading templates from '%s'\n", tree);
+            state.result = -1;
+        }
+    }
+
+    if (state.result == 0) {
+        state.result = write_manifest(&state, version);
+    }
+    free(state.manifest);
+    return state.result == 0 ? state.added : -1;
+}
+
+int store_use(const char *root, const char *version) {
+    if (!valid_version(version)) {
+        return -1;
+    }
+
+    char target[STORE_VERSION_MAX + 16];
+    char manifest[4096];
+    snprintf(target, sizeof(target), "versions/%s", version);
+    snprintf(manifest, sizeof(manifest), "%s/%s", root, target);
+    if (access(manifest, F_OK) != 0) {
+        fprintf(stderr, "Template version '%s' is not in the store at %s\n", version, root);
+        return -1;
+    }
+
+    // rename() swaps the link atomically; installs see either version
+    char tmp[4096];
+    char current[4096];
+    snprintf(tmp, sizeof(tmp), "%s/.current-%ld", root, (long)getpid());
+    snprintf(current, sizeof(current), "%s/current", root);
+    unlink(tmp);
+    if (symlink(target, tmp) != 0 || rename(tmp, current) != 0) {
+        fprintf(stderr, "Error switching '%s' to %s: %s\n", current, version, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int store_current(const char *root, char *version, size_t size) {
+    char current[4096];
+    char target[STORE_VERSION_MAX + 16];
+    snprintf(current, sizeof(current), "%s/current", root);
+    ssize_t len = readlink(current, target, sizeof(target) - 1);
+    if (len < 0) {
+        return -1;
+    }
+    target[len] = '\0';
+
+    const char *name = strrchr(target, '/');
+    name = name ? name + 1 : target;
+    if (strlen(name) >= size) {
+        return -1;
+    }
+    memcpy(version, name, strlen(name) + 1);
+    return 0;
+}
+
+int store_list(const char *root, void (*fn)(const char *version, void *ctx), void *ctx) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/versions", root);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            fn(entry->d_name, ctx);
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const store_entry_t *)a)->path, ((const store_entry_t *)b)->path);
+}
+
+static store_manifest_t *manifest_load(const char *root, const char *version) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/versions/%s", root, version);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    size_t size = 0;
+    char *data = read_fd(fd, &size);
+    close(fd);
+    if (!data) {
+        return NULL;
+    }
+
+    size_t header_len = strlen(STORE_MANIFEST_HEADER);
+    size_t lines = 0;
+    for (size_t i = 0; i < size; i++) {
+        lines += data[i] == '\n';
+    }
+    store_manifest_t *manifest = calloc(1, sizeof(*manifest));
+    if (!manifest || strncmp(data, STORE_MANIFEST_HEADER, header_len) != 0 || data[header_len] != '\n' ||
+        !(manifest->entries = calloc(lines ? lines : 1, sizeof(store_entry_t)))) {
+        fprintf(stderr, "Invalid template manifest %s\n", path);
+        free(manifest);
+        free(data);
+        return NULL;
+    }
+    manifest->data = data;
+
+    // Fields are split in place: "<hash> <mode> <size> <path>\n"
+    for (char *line = data + header_len + 1; *line; ) {
+        char *end = strchr(line, '\n');
+        if (!end) {
+            break;
+        }
+        *end = '\0';
+
+        char *hash_end = strchr(line, ' ');
+        char *mode_end = hash_end ? strchr(hash_end + 1, ' ') : NULL;
+        char *size_end = mode_end ? strchr(mode_end + 1, ' ') : NULL;
+        if (size_end && hash_end - line == SHA256_HEX_SIZE - 1) {
+            store_entry_t *entry = &manifest->entries[manifest->count++];
+            *hash_end = '\0';
+            entry->hash = line;
+            entry->mode = (unsigned)strtoul(hash_end + 1, NULL, 8);
+            entry->size = strtoll(mode_end + 1, NULL, 10);
+            entry->path = size_end + 1;
+        }
+        line = end + 1;
+    }
+
+    // Written sorted; sorting again only guards against hand edits
+    qsort(manifest->entries, manifest->count, sizeof(store_entry_t), compare_entries);
+    return manifest;
+}
+
+// Manifests stay loaded for the life of the process; a run asks for one or
+// two versions
+#define STORE_CACHE_SIZE 8
+
+static struct {
+    char *root;
+    char *version;
+    store_manifest_t *manifest;
+} cache[STORE_CACHE_SIZE];
+static int cache_count;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const store_manifest_t *store_manifest_get(const char *root, const char *version) {
+    if (!valid_version(version)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    store_manifest_t *manifest = NULL;
+    for (int i = 0; i < cache_count && !manifest; i++) {
+        if (strcmp(cache[i].root, root) == 0 && strcmp(cache[i].version, version) == 0) {
+            manifest = cache[i].manifest;
+        }
+    }
+    if (!manifest) {
+        manifest = manifest_load(root, version);
+        if (manifest && cache_count < STORE_CACHE_SIZE) {
+            cache[cache_count].root = strdup(root);
+            cache[cache_count].version = strdup(version);
+            cache[cache_count].manifest = manifest;
+            if (cache[cache_count].root && cache[cache_count].version) {
+                cache_count++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return manifest;
+}
+
+size_t store_manifest_count(const store_manifest_t *manifest) {
+    return manifest->count;
+}
+
+const store_entry_t *store_manifest_at(const store_manifest_t *manifest, size_t index) {
+    return index < manifest->count ? &manifest->entries[index] : NULL;
+}
+
+const store_entry_t *store_manifest_find(const store_manifest_t *manifest, const char *path) {
+    store_entry_t key = { .path = path };
+    return bsearch(&key, manifest->entries, manifest->count, sizeof(store_entry_t), compare_entries);
+}
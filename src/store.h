@@ -0,0 +1,59 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+
+// Content-addressed template store. A template version is a small manifest
+// of (hash, mode, size, path) lines; file contents are stored once per hash,
+// so versions that share files share storage. Adding a version never touches
+// the others, and switching versions replaces a single symlink.
+//
+// Layout under the store root (by default <datadir>/store):
+//   objects/ab/cdef...   file contents named by SHA-256 (2 + 62 hex digits)
+//   versions/<version>   manifest: STORE_MANIFEST_HEADER, then one
+//                        "<sha256> <mode> <size> <path>" line per file,
+//                        sorted by path
+//   current              symlink to versions/<version>
+
+#define STORE_DIR_NAME "store"
+#define STORE_MANIFEST_HEADER "# replica manifest 1"
+#define STORE_VERSION_MAX 128
+
+typedef struct {
+    const char *path; // relative to the datadir, e.g. "/.github/prompts/ROADMAP.prompt.md"
+    const char *hash; // hex SHA-256 of the contents
+    unsigned mode;
+    long long size;
+} store_entry_t;
+
+typedef struct store_manifest store_manifest_t;
+
+// $REPLICA_STORE, or the store directory inside the datadir
+const char *store_default_root(void);
+
+// Adds the template trees under source_dir as version, replacing an earlier
+// manifest of the same name. Returns the number of objects that were new to
+// the store, or -1.
+int store_import(const char *root, const char *version, const char *source_dir);
+
+// Makes version the current one
+int store_use(const char *root, const char *version);
+
+// Copies the current version's name into version. Returns -1 when the store
+// has no current version.
+int store_current(const char *root, char *version, size_t size);
+
+// Calls fn for every version in the store, in directory order
+int store_list(const char *root, void (*fn)(const char *version, void *ctx), void *ctx);
+
+// Loads a manifest, or returns the one loaded earlier by this process.
+// Returns NULL when the version is not in the store.
+const store_manifest_t *store_manifest_get(const char *root, const char *version);
+size_t store_manifest_count(const store_manifest_t *manifest);
+const store_entry_t *store_manifest_at(const store_manifest_t *manifest, size_t index);
+const store_entry_t *store_manifest_find(const store_manifest_t *manifest, const char *path);
+
+// Path of the object holding an entry's contents
+void store_object_path(const char *root, const char *hash, char *path, size_t size);
+
+#endif // STORE_H
@@ -0,0 +1,160 @@
+#include "strategy.h"
+#include <pthread.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#ifndef BCACHEFS_SUPER_MAGIC
+#define BCACHEFS_SUPER_MAGIC 0xca451a4e
+#endif
+#ifndef ZFS_SUPER_MAGIC
+#define ZFS_SUPER_MAGIC 0x2fc12fc1
+#endif
+
+// Device pairs seen during this run. Runs touch a handful of filesystems;
+// pairs past the table are probed every time instead of cached.
+#define STRATEGY_CACHE_SIZE 32
+
+static strategy_pair_t cache[STRATEGY_CACHE_SIZE];
+static int cache_count;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+    long type;
+    const char *name;
+    int reflink; // FICLONE between files of one filesystem
+} filesystems[] = {
+    {EXT4_SUPER_MAGIC, "ext4", 0},
+    {XFS_SUPER_MAGIC, "xfs", 1},
+    {BTRFS_SUPER_MAGIC, "btrfs", 1},
+    {TMPFS_MAGIC, "tmpfs", 0},
+    {OVERLAYFS_SUPER_MAGIC, "overlayfs", 1},
+    {NFS_SUPER_MAGIC, "nfs", 1},
+    {F2FS_SUPER_MAGIC, "f2fs", 0},
+    {OCFS2_SUPER_MAGIC, "ocfs2", 1},
+    {BCACHEFS_SUPER_MAGIC, "bcachefs", 1},
+    {ZFS_SUPER_MAGIC, "zfs", 1},
+    {SMB2_SUPER_MAGIC, "smb2", 1},
+    {CIFS_SUPER_MAGIC, "cifs", 1},
+    {FUSE_SUPER_MAGIC, "fuse", 0},
+};
+
+static int fs_index(long type) {
+    for (size_t i = 0; i < sizeof(filesystems) / sizeof(filesystems[0]); i++) {
+        if (filesystems[i].type == type) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+const char *strategy_fs_name(long type) {
+    int i = fs_index(type);
+    return i < 0 ? "unknown" : filesystems[i].name;
+}
+
+// What a pair is expected to support before anything has been tried.
+// Clones need both files on one filesystem (overlayfs forwards them to its
+// upper layer); copy_file_range between different filesystem types is
+// refused by current kernels. The rest is learned as it fails.
+static void probe_caps(strategy_pair_t *pair) {
+    int i = fs_index(pair->src_type);
+    int same_type = pair->src_type == pair->dest_type;
+    int same_fs = pair->src_dev == pair->dest_dev || pair->src_type == OVERLAYFS_SUPER_MAGIC;
+
+    pair->caps = STRATEGY_CAP_SENDFILE | STRATEGY_CAP_MMAP | STRATEGY_CAP_DIRECT | STRATEGY_CAP_FALLOCATE;
+    pair->shares_extents = same_type && same_fs && i >= 0 && filesystems[i].reflink;
+    if (pair->shares_extents) {
+        pair->caps |= STRATEGY_CAP_REFLINK;
+    }
+    if (same_type) {
+        pair->caps |= STRATEGY_CAP_RANGE;
+    }
+}
+
+int strategy_probe(int in, int out, const struct stat *in_st, strategy_pair_t *pair) {
+    struct stat out_st;
+    if (fstat(out, &out_st) != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < cache_count; i++) {
+        if (cache[i].src_dev == in_st->st_dev && cache[i].dest_dev == out_st.st_dev) {
+            *pair = cache[i];
+            pthread_mutex_unlock(&cache_lock);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    struct statfs in_fs;
+    struct statfs out_fs;
+    if (fstatfs(in, &in_fs) != 0 || fstatfs(out, &out_fs) != 0) {
+        return -1;
+    }
+    pair->src_dev = in_st->st_dev;
+    pair->dest_dev = out_st.st_dev;
+    pair->src_type = (long)in_fs.f_type;
+    pair->dest_type = (long)out_fs.f_type;
+    probe_caps(pair);
+
+    // Another worker may have probed the same pair meanwhile; either result
+    // is the same
+    pthread_mutex_lock(&cache_lock);
+    if (cache_count < STRATEGY_CACHE_SIZE) {
+        cache[cache_count++] = *pair;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return 1;
+}
+
+void strategy_forget(strategy_pair_t *pair, unsigned cap) {
+    pair->caps &= ~cap;
+
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < cache_count; i++) {
+        if (cache[i].src_dev == pair->src_dev && cache[i].dest_dev == pair->dest_dev) {
+            cache[i].caps &= ~cap;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+copy_strategy_t strategy_pick(const strategy_pair_t *pair, off_t size, int sparse, int no_cache) {
+    unsigned caps = pair ? pair->caps : 0;
+
+    // A clone copies nothing, holes and all
+    if (caps & STRATEGY_CAP_REFLINK) {
+        return COPY_REFLINK;
+    }
+    if (sparse) {
+        return COPY_SPARSE;
+    }
+    if (no_cache) {
+        return size >= STRATEGY_DIRECT_MIN && (caps & STRATEGY_CAP_DIRECT) ? COPY_DIRECT : COPY_STREAM;
+    }
+    if (size <= STRATEGY_BUFFER_MAX) {
+        return COPY_BUFFER;
+    }
+    if (caps & STRATEGY_CAP_RANGE) {
+        return COPY_RANGE;
+    }
+    if (caps & STRATEGY_CAP_SENDFILE) {
+        return COPY_SENDFILE;
+    }
+    return size >= STRATEGY_MMAP_MIN && (caps & STRATEGY_CAP_MMAP) ? COPY_MMAP : COPY_STREAM;
+}
+
+const char *strategy_name(copy_strategy_t strategy) {
+    switch (strategy) {
+    case COPY_BUFFER: return "buffer";
+    case COPY_STREAM: return "stream";
+    case COPY_SPARSE: return "sparse";
+    case COPY_REFLINK: return "reflink";
+    case COPY_RANGE: return "copy_file_range";
+    case COPY_SENDFILE: return "sendfile";
+    case COPY_MMAP: return "mmap";
+    case COPY_DIRECT: return "direct";
+    }
+    return "unknown";
+}
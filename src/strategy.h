@@ -0,0 +1,66 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Per-file copy strategy selection. The filesystems behind a source and a
+// destination are probed with fstatfs the first time a device pair is seen,
+// and the primitives the pair supports are cached for the rest of the run.
+// A primitive that fails as unsupported is dropped from its pair, so later
+// files go straight to the next choice.
+
+typedef enum {
+    COPY_BUFFER,   // one read and one write through a buffer of the file's size
+    COPY_STREAM,   // pread/pwrite in chunks; the --no-cache writeback path
+    COPY_SPARSE,   // stream only the data extents, keeping holes
+    COPY_REFLINK,  // FICLONE: share extents, nothing is copied
+    COPY_RANGE,    // copy_file_range: in-kernel, server-side on NFS
+    COPY_SENDFILE, // sendfile: in-kernel, between any two filesystems
+    COPY_MMAP,     // write() straight from a mapping of the source
+    COPY_DIRECT,   // O_DIRECT, bypassing the page cache
+} copy_strategy_t;
+
+// Primitives a device pair is believed to support
+#define STRATEGY_CAP_REFLINK (1u << 0)
+#define STRATEGY_CAP_RANGE (1u << 1)
+#define STRATEGY_CAP_SENDFILE (1u << 2)
+#define STRATEGY_CAP_DIRECT (1u << 3)
+#define STRATEGY_CAP_FALLOCATE (1u << 4)
+#define STRATEGY_CAP_MMAP (1u << 5)
+
+// Files up to this size are read once into a buffer; larger ones are worth
+// probing for a kernel-side copy
+#define STRATEGY_BUFFER_MAX (256 * 1024)
+
+// Outputs from this size are preallocated before they are written
+#define STRATEGY_PREALLOC_MIN (1024 * 1024)
+
+// Below this size an mmap costs more than it saves
+#define STRATEGY_MMAP_MIN (1024 * 1024)
+
+// --no-cache copies from this size use O_DIRECT where the filesystems allow it
+#define STRATEGY_DIRECT_MIN (64 * 1024 * 1024)
+
+typedef struct {
+    dev_t src_dev;
+    dev_t dest_dev;
+    long src_type;  // statfs f_type
+    long dest_type;
+    unsigned caps;  // STRATEGY_CAP_*
+    int shares_extents; // copy_file_range may clone instead of copying
+} strategy_pair_t;
+
+// Looks up, or probes and caches, the pair behind two open files. Returns 1
+// when the pair was probed by this call, 0 when it came from the cache.
+int strategy_probe(int in, int out, const struct stat *in_st, strategy_pair_t *pair);
+
+// Drops a primitive from a pair after it failed as unsupported
+void strategy_forget(strategy_pair_t *pair, unsigned cap);
+
+copy_strategy_t strategy_pick(const strategy_pair_t *pair, off_t size, int sparse, int no_cache);
+
+const char *strategy_name(copy_strategy_t strategy);
+const char *strategy_fs_name(long type);
+
+#endif // STRATEGY_H
@@ -0,0 +1,425 @@
+// For inotify_init1, utimensat, strdup and clock_gettime
+#define _GNU_SOURCE
+
+#include "sync.h"
+#include "copy.h"
+#include "walk.h"
+#include "cli_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+// Changes are copied at the latest this long after the first event of a
+// burst, even if events keep arriving
+#define SYNC_MAX_DELAY_MS 500
+
+// Written files show up as IN_CLOSE_WRITE, editors that save by rename as
+// IN_MOVED_TO; IN_CREATE is only acted on for new directories
+#define SYNC_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+
+typedef struct {
+    int wd;
+    int root;
+    char *dir; // relative to the root, "" for the root itself
+} sync_watch_t;
+
+typedef struct {
+    int root;
+    int is_dir; // rescan the whole subtree
+    char *path;
+} sync_change_t;
+
+typedef struct {
+    const sync_options_t *options;
+    int inotify_fd;
+    sync_watch_t *watches;
+    size_t watch_count;
+    size_t watch_cap;
+    sync_change_t *pending;
+    size_t pending_count;
+    size_t pending_cap;
+    int rescan_all;
+    size_t copied;
+    int result;
+} sync_state_t;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void join_path(char *out, size_t size, const char *dir, const char *name) {
+    if (dir[0] == '\0') {
+        snprintf(out, size, "%s", name);
+    } else if (name[0] == '\0') {
+        snprintf(out, size, "%s", dir);
+    } else {
+        snprintf(out, size, "%s/%s", dir, name);
+    }
+}
+
+static int same_contents(const char *a, const char *b) {
+    int fa = open(a, O_RDONLY | O_CLOEXEC);
+    int fb = open(b, O_RDONLY | O_CLOEXEC);
+    int same = fa >= 0 && fb >= 0;
+    char ba[65536];
+    char bb[65536];
+
+    while (same) {
+        ssize_t na = read(fa, ba, sizeof(ba));
+        ssize_t nb = na > 0 ? read(fb, bb, (size_t)na) : read(fb, bb, 1);
+        if (na < 0 || nb < 0 || na != nb || memcmp(ba, bb, (size_t)na) != 0) {
+            same = 0;
+        }
+        if (na <= 0) {
+            break;
+        }
+    }
+
+    if (fa >= 0) close(fa);
+    if (fb >= 0) close(fb);
+    return same;
+}
+
+// A destination is up to date when it matches in size and either carries the
+// source's mtime (set by a previous sync) or has identical contents. Matching
+// contents get the source's mtime too, so the next check needs no read.
+static int is_unchanged(const char *src, const struct stat *src_st, const char *dest) {
+    struct stat dest_st;
+    if (stat(dest, &dest_st) != 0 || dest_st.st_size != src_st->st_size) {
+        return 0;
+    }
+    if (dest_st.st_mtim.tv_sec == src_st->st_mtim.tv_sec &&
+        dest_st.st_mtim.tv_nsec == src_st->st_mtim.tv_nsec) {
+        return 1;
+    }
+    if (!same_contents(src, dest)) {
+        return 0;
+    }
+    struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, src_st->st_mtim};
+    utimensat(AT_FDCWD, dest, times, 0);
+    return 1;
+}
+
+// Brings one file up to date in every destination
+static void sync_file(sync_state_t *state, int root, const char *rel) {
+    const sync_options_t *options = state->options;
+    const sync_root_t *r = &options->roots[root];
+    char src[4096];
+    join_path(src, sizeof(src), r->source, rel);
+
+    struct stat st;
+    if (stat(src, &st) != 0 || !S_ISREG(st.st_mode)) {
+        // Removed or replaced before the burst settled
+        return;
+    }
+
+    for (int i = 0; i < options->dest_count; i++) {
+        char dest[4096];
+        snprintf(dest, sizeof(dest), "%s%s/%s", options->dests[i], r->subdir, rel);
+        if (is_unchanged(src, &st, dest)) {
+            continue;
+        }
+
+        char parent[4096];
+        snprintf(parent, sizeof(parent), "%s", dest);
+        *strrchr(parent, '/') = '\0';
+        copy_options_t copy = {
+            .no_cache = options->no_cache,
+            .verbose = options->verbose,
+            .throttle = options->throttle,
+        };
+        if (create_directories(parent) != 0 || copy_path_data(&copy, src, dest) != 0) {
+            fprintf(stderr, "Error syncing '%s' to '%s': %s\n", rel, options->dests[i], strerror(errno));
+            state->result = -1;
+            continue;
+        }
+
+        // Carry the source mtime so the next comparison needs no read
+        struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, st.st_mtim};
+        utimensat(AT_FDCWD, dest, times, 0);
+
+        char msg[8192];
+        snprintf(msg, sizeof(msg), "Synced '%s%s%s' -> %s",
+                 r->subdir[0] == '/' ? r->subdir + 1 : r->subdir, r->subdir[0] ? "/" : "", rel, options->dests[i]);
+        cli_print_step(msg);
+        state->copied++;
+    }
+}
+
+static void add_watch(sync_state_t *state, int root, const char *rel) {
+    if (state->inotify_fd < 0) {
+        return;
+    }
+
+    char path[4096];
+    join_path(path, sizeof(path), state->options->roots[root].source, rel);
+    int wd = inotify_add_watch(state->inotify_fd, path, SYNC_WATCH_MASK);
+    if (wd < 0) {
+        fprintf(stderr, "Error watching '%s': %s\n", path, strerror(errno));
+        state->result = -1;
+        return;
+    }
+
+    // Watching a directory again (after a rescan) returns its existing wd
+    for (size_t i = 0; i < state->watch_count; i++) {
+        if (state->watches[i].wd == wd) {
+            return;
+        }
+    }
+
+    if (state->watch_count == state->watch_cap) {
+        size_t cap = state->watch_cap ? state->watch_cap * 2 : 64;
+        sync_watch_t *watches = realloc(state->watches, cap * sizeof(sync_watch_t));
+        if (!watches) {
+            state->result = -1;
+            return;
+        }
+        state->watches = watches;
+        state->watch_cap = cap;
+    }
+    char *dir = strdup(rel);
+    if (!dir) {
+        state->result = -1;
+        return;
+    }
+    state->watches[state->watch_count++] = (sync_watch_t){wd, root, dir};
+}
+
+typedef struct {
+    sync_state_t *state;
+    int root;
+    const char *base; // scanned directory, relative to the root
+} sync_scan_t;
+
+static int scan_entry(const walk_entry_t *entry, void *ctx) {
+    sync_scan_t *scan = ctx;
+    char rel[4096];
+    join_path(rel, sizeof(rel), scan->base, entry->path);
+
+    if (entry->type == WALK_DIR) {
+        add_watch(scan->state, scan->root, rel);
+    } else if (entry->type == WALK_FILE || entry->type == WALK_SYMLINK) {
+        sync_file(scan->state, scan->root, rel);
+    }
+    return WALK_CONTINUE;
+}
+
+// Syncs every file below rel and watches its directories
+static void sync_scan(sync_state_t *state, int root, const char *rel) {
+    char path[4096];
+    join_path(path, sizeof(path), state->options->roots[root].source, rel);
+
+    add_watch(state, root, rel);
+    sync_scan_t scan = {state, root, rel};
+    if (walk_tree(path, NULL, scan_entry, &scan) != 0) {
+        state->result = -1;
+    }
+}
+
+static void queue_change(sync_state_t *state, int root, const char *rel, int is_dir) {
+    if (state->pending_count == state->pending_cap) {
+        size_t cap = state->pending_cap ? state->pending_cap * 2 : 64;
+        sync_change_t *pending = realloc(state->pending, cap * sizeof(sync_change_t));
+        if (!pending) {
+            state->rescan_all = 1;
+            return;
+        }
+        state->pending = pending;
+        state->pending_cap = cap;
+    }
+    char *path = strdup(rel);
+    if (!path) {
+        state->rescan_all = 1;
+        return;
+    }
+    state->pending[state->pending_count++] = (sync_change_t){root, is_dir, path};
+}
+
+static int compare_changes(const void *a, const void *b) {
+    const sync_change_t *x = a;
+    const sync_change_t *y = b;
+    if (x->root != y->root) {
+        return x->root - y->root;
+    }
+    int c = strcmp(x->path, y->path);
+    return c != 0 ? c : x->is_dir - y->is_dir;
+}
+
+// Copies a settled burst, each changed path once
+static void flush_changes(sync_state_t *state) {
+    if (state->rescan_all) {
+        for (int i = 0; i < state->options->root_count; i++) {
+            sync_scan(state, i, "");
+        }
+    } else {
+        qsort(state->pending, state->pending_count, sizeof(sync_change_t), compare_changes);
+        for (size_t i = 0; i < state->pending_count; i++) {
+            const sync_change_t *c = &state->pending[i];
+            if (i > 0 && compare_changes(c, &state->pending[i - 1]) == 0) {
+                continue;
+            }
+            if (c->is_dir) {
+                sync_scan(state, c->root, c->path);
+            } else {
+                sync_file(state, c->root, c->path);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < state->pending_count; i++) {
+        free(state->pending[i].path);
+    }
+    state->pending_count = 0;
+    state->rescan_all = 0;
+}
+
+static const sync_watch_t *find_watch(const sync_state_t *state, int wd) {
+    for (size_t i = 0; i < state->watch_count; i++) {
+        if (state->watches[i].wd == wd) {
+            return &state->watches[i];
+        }
+    }
+    return NULL;
+}
+
+static void forget_watch(sync_state_t *state, int wd) {
+    for (size_t i = 0; i < state->watch_count; i++) {
+        if (state->watches[i].wd == wd) {
+            free(state->watches[i].dir);
+            state->watches[i] = state->watches[--state->watch_count];
+            return;
+        }
+    }
+}
+
+static int read_events(sync_state_t *state) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t n = read(state->inotify_fd, buffer, sizeof(buffer));
+    if (n < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+
+    for (char *p = buffer; p < buffer + n;) {
+        const struct inotify_event *event = (const struct inotify_event *)(void *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            state->rescan_all = 1;
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            forget_watch(state, event->wd);
+            continue;
+        }
+
+        const sync_watch_t *watch = find_watch(state, event->wd);
+        if (!watch || event->len == 0) {
+            continue;
+        }
+
+        char rel[4096];
+        join_path(rel, sizeof(rel), watch->dir, event->name);
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                queue_change(state, watch->root, rel, 1);
+            }
+        } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            queue_change(state, watch->root, rel, 0);
+        }
+    }
+    return 0;
+}
+
+static void watch_loop(sync_state_t *state) {
+    int debounce = state->options->debounce_ms > 0 ? state->options->debounce_ms : SYNC_DEFAULT_DEBOUNCE_MS;
+    long long burst_start = 0;
+
+    for (;;) {
+        int pending = state->pending_count > 0 || state->rescan_all;
+        int timeout = -1;
+        if (pending) {
+            long long left = burst_start + SYNC_MAX_DELAY_MS - now_ms();
+            timeout = left < debounce ? (left > 0 ? (int)left : 0) : debounce;
+        }
+
+        struct pollfd pfd = {.fd = state->inotify_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("Error waiting for changes");
+            state->result = -1;
+            return;
+        }
+
+        if (ready == 0 || (pending && now_ms() - burst_start >= SYNC_MAX_DELAY_MS)) {
+            if (pending) {
+                flush_changes(state);
+                fflush(stdout);
+            }
+            if (ready == 0) {
+                continue;
+            }
+        }
+
+        if (read_events(state) != 0) {
+            perror("Error reading change events");
+            state->result = -1;
+            return;
+        }
+        if (!pending && (state->pending_count > 0 || state->rescan_all)) {
+            burst_start = now_ms();
+        }
+    }
+}
+
+int sync_run(const sync_options_t *options) {
+    sync_state_t state = {
+        .options = options,
+        .inotify_fd = -1,
+    };
+
+    if (options->watch) {
+        state.inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if (state.inotify_fd < 0) {
+            perror("Error initializing inotify");
+            return -1;
+        }
+    }
+
+    // Initial pass: bring every destination up to date, watching as we go so
+    // nothing changed during the pass is missed
+    for (int i = 0; i < options->root_count; i++) {
+        sync_scan(&state, i, "");
+    }
+
+    if (state.copied == 0) {
+        cli_print_step("Destinations are up to date");
+    }
+
+    if (options->watch) {
+        cli_print_info("Watching for changes (Ctrl+C to stop)");
+        fflush(stdout);
+        watch_loop(&state);
+        close(state.inotify_fd);
+    }
+
+    for (size_t i = 0; i < state.watch_count; i++) {
+        free(state.watches[i].dir);
+    }
+    free(state.watches);
+    for (size_t i = 0; i < state.pending_count; i++) {
+        free(state.pending[i].path);
+    }
+    free(state.pending);
+    return state.result;
+}
@@ -0,0 +1,32 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "throttle.h"
+
+// Incremental sync: mirrors source trees into one or more destinations,
+// copying only files whose contents differ. In watch mode the sources are
+// followed with inotify and bursts of changes are copied once they settle.
+// Deletions are not propagated.
+
+typedef struct {
+    const char *source; // directory to mirror
+    const char *subdir; // path under each destination, e.g. "/.github/prompts"; "" for the root
+} sync_root_t;
+
+typedef struct {
+    const sync_root_t *roots;
+    int root_count;
+    const char *const *dests;
+    int dest_count;
+    int watch;       // keep running and follow changes after the first pass
+    int debounce_ms; // quiet time before a burst of changes is copied, 0 for the default
+    int no_cache;    // keep large copies out of the page cache
+    int verbose;     // trace copy strategies to stderr
+    throttle_t *throttle; // I/O limits for the copies, NULL for none
+} sync_options_t;
+
+#define SYNC_DEFAULT_DEBOUNCE_MS 100
+
+int sync_run(const sync_options_t *options);
+
+#endif // SYNC_H
@@ -0,0 +1,29 @@
+#include "templates.h"
+#include <string.h>
+
+const template_set_t template_sets[] = {
+    {"readme", "generate-readme.prompt.md", "readme.instructions.md"},
+    {"release-notes", "generate-release-notes.prompt.md", "release-notes.instructions.md"},
+    {"post", "generate-linkedin.prompt.md", "linkedin.instructions.md"},
+    {"contributing", "CONTRIBUTING.prompt.md", "CONTRIBUTING.instructions.md"},
+    {"license", "LICENSE.prompt.md", "LICENSE.instructions.md"},
+    {"security", "SECURITY.prompt.md", "SECURITY.instructions.md"},
+    {"code-of-conduct", "CODE_OF_CONDUCT.prompt.md", "CODE_OF_CONDUCT.instructions.md"},
+    {"issue-template", "ISSUE_TEMPLATE.prompt.md", "ISSUE_TEMPLATE.instructions.md"},
+    {"pr-template", "PULL_REQUEST_TEMPLATE.prompt.md", "PULL_REQUEST_TEMPLATE.instructions.md"},
+    {"architecture", "ARCHITECTURE.prompt.md", "ARCHITECTURE.instructions.md"},
+    {"roadmap", "ROADMAP.prompt.md", "ROADMAP.instructions.md"},
+    {"support", "SUPPORT.prompt.md", "SUPPORT.instructions.md"},
+    {"install", "INSTALL.prompt.md", "INSTALL.instructions.md"},
+};
+
+const int template_set_count = sizeof(template_sets) / sizeof(template_sets[0]);
+
+const template_set_t *template_set_find(const char *name) {
+    for (int i = 0; i < template_set_count; i++) {
+        if (strcmp(template_sets[i].name, name) == 0) {
+            return &template_sets[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef TEMPLATES_H
+#define TEMPLATES_H
+
+// A template set is one prompt plus its matching instructions file, both
+// relative to the datadir's .github tree.
+typedef struct {
+    const char *name;         // option name without dashes, e.g. "readme"
+    const char *prompt;       // file under /.github/prompts
+    const char *instructions; // file under /.github/instructions
+} template_set_t;
+
+#define TEMPLATE_PROMPTS_DIR "/.github/prompts"
+#define TEMPLATE_INSTRUCTIONS_DIR "/.github/instructions"
+
+extern const template_set_t template_sets[];
+extern const int template_set_count;
+
+const template_set_t *template_set_find(const char *name);
+
+#endif // TEMPLATES_H
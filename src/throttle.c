@@ -0,0 +1,191 @@
+// For clock_nanosleep and syscall()
+#define _GNU_SOURCE
+
+#include "throttle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// From linux/ioprio.h, which older kernel headers don't install
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+
+typedef struct {
+    double rate;     // tokens per nanosecond, 0 for unlimited
+    double capacity;
+    double tokens;   // negative while callers are sleeping off a debt
+    long long rate_per_sec;
+} bucket_t;
+
+struct throttle {
+    pthread_mutex_t lock;
+    bucket_t bytes;
+    bucket_t ops;
+    long long last_ns;
+    long long waited_ns;
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void bucket_init(bucket_t *bucket, long long per_sec, double min_capacity) {
+    bucket->rate_per_sec = per_sec;
+    bucket->rate = (double)per_sec / 1e9;
+    bucket->capacity = (double)per_sec * THROTTLE_BURST_MS / 1000.0;
+    if (bucket->capacity < min_capacity) {
+        bucket->capacity = min_capacity;
+    }
+    bucket->tokens = bucket->capacity;
+}
+
+// Refills for elapsed nanoseconds, takes amount and returns how long the
+// caller has to wait for the bucket to be out of debt
+static long long bucket_take(bucket_t *bucket, long long elapsed, double amount) {
+    if (bucket->rate <= 0) {
+        return 0;
+    }
+    bucket->tokens += (double)elapsed * bucket->rate;
+    if (bucket->tokens > bucket->capacity) {
+        bucket->tokens = bucket->capacity;
+    }
+    bucket->tokens -= amount;
+    return bucket->tokens >= 0 ? 0 : (long long)(-bucket->tokens / bucket->rate);
+}
+
+throttle_t *throttle_new(long long bytes_per_sec, long long ops_per_sec) {
+    if (bytes_per_sec <= 0 && ops_per_sec <= 0) {
+        return NULL;
+    }
+    throttle_t *throttle = calloc(1, sizeof(*throttle));
+    if (!throttle) {
+        return NULL;
+    }
+    pthread_mutex_init(&throttle->lock, NULL);
+    // Room for at least one copy chunk, or rates below it would never refill
+    bucket_init(&throttle->bytes, bytes_per_sec > 0 ? bytes_per_sec : 0, 64 * 1024);
+    bucket_init(&throttle->ops, ops_per_sec > 0 ? ops_per_sec : 0, 2);
+    throttle->last_ns = now_ns();
+    return throttle;
+}
+
+void throttle_free(throttle_t *throttle) {
+    if (!throttle) return;
+    pthread_mutex_destroy(&throttle->lock);
+    free(throttle);
+}
+
+void throttle_acquire(throttle_t *throttle, size_t bytes, unsigned ops) {
+    if (!throttle) {
+        return;
+    }
+
+    pthread_mutex_lock(&throttle->lock);
+    long long now = now_ns();
+    long long elapsed = now - throttle->last_ns;
+    throttle->last_ns = now;
+    long long wait = bucket_take(&throttle->bytes, elapsed, (double)bytes);
+    long long ops_wait = bucket_take(&throttle->ops, elapsed, (double)ops);
+    if (ops_wait > wait) {
+        wait = ops_wait;
+    }
+    throttle->waited_ns += wait;
+    pthread_mutex_unlock(&throttle->lock);
+
+    if (wait > 0) {
+        // An absolute deadline, so EINTR ends the wait instead of restarting it
+        long long deadline = now + wait;
+        struct timespec ts = { .tv_sec = deadline / 1000000000LL, .tv_nsec = deadline % 1000000000LL };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+}
+
+static void format_rate(char *buffer, size_t size, long long rate, const char *unit) {
+    static const char *prefixes[] = {"", "Ki", "Mi", "Gi"};
+    int prefix = 0;
+    double value = (double)rate;
+    while (value >= 1024 && prefix < 3) {
+        value /= 1024;
+        prefix++;
+    }
+    snprintf(buffer, size, value == (long long)value ? "%.0f %s%s" : "%.1f %s%s", value, prefixes[prefix], unit);
+}
+
+void throttle_describe(const throttle_t *throttle, char *buffer, size_t size) {
+    char bytes[32] = "";
+    if (throttle && throttle->bytes.rate_per_sec > 0) {
+        format_rate(bytes, sizeof(bytes), throttle->bytes.rate_per_sec, "B/s");
+    }
+    if (!throttle) {
+        snprintf(buffer, size, "unlimited");
+    } else if (throttle->ops.rate_per_sec > 0) {
+        snprintf(buffer, size, "%s%s%lld IOPS", bytes, bytes[0] ? ", " : "", throttle->ops.rate_per_sec);
+    } else {
+        snprintf(buffer, size, "%s", bytes);
+    }
+}
+
+long long throttle_waited_ms(const throttle_t *throttle) {
+    if (!throttle) {
+        return 0;
+    }
+    pthread_mutex_lock(&((throttle_t *)throttle)->lock);
+    long long waited = throttle->waited_ns;
+    pthread_mutex_unlock(&((throttle_t *)throttle)->lock);
+    return waited / 1000000;
+}
+
+int throttle_parse_rate(const char *text, long long *rate) {
+    char *end;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (errno != 0 || end == text || value <= 0) {
+        return -1;
+    }
+    long long scale = 1;
+    switch (*end) {
+    case 'k': case 'K': scale = 1024LL; end++; break;
+    case 'm': case 'M': scale = 1024LL * 1024; end++; break;
+    case 'g': case 'G': scale = 1024LL * 1024 * 1024; end++; break;
+    }
+    if (*end != '\0' || value > (1LL << 62) / scale) {
+        return -1;
+    }
+    *rate = value * scale;
+    return 0;
+}
+
+int throttle_parse_ioprio(const char *spec, int *ioprio) {
+    int class;
+    int level = 0;
+    if (strcmp(spec, "idle") == 0) {
+        class = IOPRIO_CLASS_IDLE;
+    } else if (strncmp(spec, "be:", 3) == 0 || strncmp(spec, "rt:", 3) == 0) {
+        class = spec[0] == 'b' ? IOPRIO_CLASS_BE : IOPRIO_CLASS_RT;
+        char *end;
+        level = (int)strtol(spec + 3, &end, 10);
+        if (end == spec + 3 || *end != '\0' || level < 0 || level > 7) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    *ioprio = class << IOPRIO_CLASS_SHIFT | level;
+    return 0;
+}
+
+int throttle_set_ioprio(int ioprio) {
+    return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) == 0 ? 0 : -1;
+}
@@ -0,0 +1,43 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stddef.h>
+
+// I/O rate limits shared by all copy workers: one token bucket for bytes per
+// second and one for operations per second. Callers reserve before each
+// chunk and sleep off any debt outside the lock, so workers are throttled
+// together without serializing their I/O. Buckets hold at most
+// THROTTLE_BURST_MS worth of tokens, which keeps idle workers from saving up
+// a burst.
+
+#define THROTTLE_BURST_MS 100
+
+typedef struct throttle throttle_t;
+
+// A 0 rate leaves that dimension unlimited. Returns NULL when both are 0.
+throttle_t *throttle_new(long long bytes_per_sec, long long ops_per_sec);
+void throttle_free(throttle_t *throttle);
+
+// Takes bytes and ops from the buckets, sleeping until the debt is paid.
+// Returns early when a signal arrives. NULL is unlimited.
+void throttle_acquire(throttle_t *throttle, size_t bytes, unsigned ops);
+
+// "10 MiB/s, 200 IOPS", for progress output
+void throttle_describe(const throttle_t *throttle, char *buffer, size_t size);
+
+// Milliseconds all workers together spent waiting on the limits
+long long throttle_waited_ms(const throttle_t *throttle);
+
+// Parses a count with an optional K, M or G suffix (powers of 1024)
+int throttle_parse_rate(const char *text, long long *rate);
+
+// Parses an I/O priority: "idle", "be:N" or "rt:N" with N from 0 (highest)
+// to 7
+int throttle_parse_ioprio(const char *spec, int *ioprio);
+
+// Sets the I/O priority of the calling thread, and of the threads it starts
+// afterwards. Returns -1 with errno set when the kernel refuses, e.g. EPERM
+// for the realtime class without CAP_SYS_ADMIN.
+int throttle_set_ioprio(int ioprio);
+
+#endif // THROTTLE_H
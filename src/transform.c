@@ -0,0 +1,346 @@
+// For ssize_t and write
+#define _POSIX_C_SOURCE 200809L
+
+#include "transform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define TRANSFORM_X86 1
+#endif
+
+#define SINK_BUFFER_SIZE (64 * 1024)
+
+static const char bom[3] = {'\xEF', '\xBB', '\xBF'};
+
+// Returns the first byte in [p, end) that is needle or non-ASCII, or end.
+// Only the line ending byte the conversion acts on is searched for, so
+// text already in the target form streams through without stopping.
+typedef const char *(*find_special_fn)(const char *p, const char *end, char needle);
+
+static const char *find_special_scalar(const char *p, const char *end, char needle) {
+    while (p < end && *p != needle && (unsigned char)*p < 0x80) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef TRANSFORM_X86
+// The sign bit of each byte is set for non-ASCII bytes and for matches of
+// the compare, so one movemask finds both
+static const char *find_special_sse2(const char *p, const char *end, char needle) {
+    const __m128i match = _mm_set1_epi8(needle);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)p);
+        __m128i hits = _mm_or_si128(v, _mm_cmpeq_epi8(v, match));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+        p += 16;
+    }
+    return find_special_scalar(p, end, needle);
+}
+
+__attribute__((target("avx2")))
+static const char *find_special_avx2(const char *p, const char *end, char needle) {
+    const __m256i match = _mm256_set1_epi8(needle);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)p);
+        __m256i hits = _mm256_or_si256(v, _mm256_cmpeq_epi8(v, match));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_special_sse2(p, end, needle);
+}
+#endif
+
+static find_special_fn find_special = find_special_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void pick_kernel(void) {
+#ifdef TRANSFORM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        find_special = find_special_avx2;
+        kernel_name = "avx2";
+    } else {
+        find_special = find_special_sse2;
+        kernel_name = "sse2";
+    }
+#endif
+}
+
+const char *transform_kernel(void) {
+    pthread_once(&kernel_once, pick_kernel);
+    return kernel_name;
+}
+
+// Length of the UTF-8 sequence at p, or 0 when it is malformed, overlong,
+// a surrogate or beyond U+10FFFF
+static size_t utf8_sequence(const unsigned char *p, const unsigned char *end) {
+    size_t len;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        len = 2;
+    } else if (p[0] >= 0xE0 && p[0] <= 0xEF) {
+        len = 3;
+        if (p[0] == 0xE0) low = 0xA0;
+        if (p[0] == 0xED) high = 0x9F;
+    } else if (p[0] >= 0xF0 && p[0] <= 0xF4) {
+        len = 4;
+        if (p[0] == 0xF0) low = 0x90;
+        if (p[0] == 0xF4) high = 0x8F;
+    } else {
+        return 0;
+    }
+    if ((size_t)(end - p) < len || p[1] < low || p[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; i++) {
+        if (p[i] < 0x80 || p[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+int transform_is_identity(const transform_t *t) {
+    return t->eol == TRANSFORM_EOL_KEEP && t->bom == TRANSFORM_BOM_KEEP && !t->check_utf8;
+}
+
+static int has_bom(const char *data, size_t size) {
+    return size >= sizeof(bom) && memcmp(data, bom, sizeof(bom)) == 0;
+}
+
+static int is_binary(const char *data, size_t size) {
+    return memchr(data, '\0', size < TRANSFORM_BINARY_PROBE ? size : TRANSFORM_BINARY_PROBE) != NULL;
+}
+
+// The line ending byte each conversion looks for: a '\r' that starts a CRLF
+// for LF output, a '\n' without its '\r' for CRLF output. A non-ASCII byte
+// never matches, so it stands for "none" (non-ASCII bytes are always found).
+static char eol_needle(const transform_t *t) {
+    switch (t->eol) {
+    case TRANSFORM_EOL_LF: return '\r';
+    case TRANSFORM_EOL_CRLF: return '\n';
+    default: return (char)0x80;
+    }
+}
+
+// Where the body starts once a BOM to strip is skipped
+static size_t body_start(const transform_t *t, const char *data, size_t size) {
+    return t->bom == TRANSFORM_BOM_STRIP && has_bom(data, size) ? sizeof(bom) : 0;
+}
+
+int transform_scan(const transform_t *t, const char *data, size_t size, size_t *clean) {
+    pthread_once(&kernel_once, pick_kernel);
+    *clean = size;
+    if (transform_is_identity(t) || is_binary(data, size)) {
+        return 1;
+    }
+
+    size_t body = body_start(t, data, size);
+    char needle = eol_needle(t);
+    const char *end = data + size;
+    const char *p = data + body;
+    for (;;) {
+        const char *q = find_special(p, end, needle);
+        if (q == end) {
+            p = end;
+            break;
+        }
+        unsigned char c = (unsigned char)*q;
+        if (c >= 0x80) {
+            size_t len = 1;
+            if (t->check_utf8) {
+                len = utf8_sequence((const unsigned char *)q, (const unsigned char *)end);
+                if (len == 0) {
+                    errno = EILSEQ;
+                    return -1;
+                }
+            }
+            p = q + len;
+        } else if (c == '\r' && t->eol == TRANSFORM_EOL_LF && q + 1 < end && q[1] == '\n') {
+            p = q;
+            break;
+        } else if (c == '\n' && t->eol == TRANSFORM_EOL_CRLF && (q == data || q[-1] != '\r')) {
+            p = q;
+            break;
+        } else {
+            p = q + 1;
+        }
+    }
+
+    *clean = (size_t)(p - data);
+    int adds_bom = t->bom == TRANSFORM_BOM_ADD && !has_bom(data, size);
+    return body == 0 && !adds_bom && p == end;
+}
+
+// Output either to a file descriptor, through a fixed buffer, or to a
+// growing memory buffer when fd is -1
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t cap;
+} sink_t;
+
+static int write_fully(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int sink_flush(sink_t *sink) {
+    if (sink->fd < 0 || sink->len == 0) {
+        return 0;
+    }
+    int result = write_fully(sink->fd, sink->buf, sink->len);
+    sink->len = 0;
+    return result;
+}
+
+static int sink_put(sink_t *sink, const char *data, size_t size) {
+    if (sink->len + size <= sink->cap) {
+        memcpy(sink->buf + sink->len, data, size);
+        sink->len += size;
+        return 0;
+    }
+    if (sink->fd >= 0) {
+        // Long unchanged runs go straight from the source
+        if (sink_flush(sink) != 0) return -1;
+        if (size >= sink->cap / 2) return write_fully(sink->fd, data, size);
+        memcpy(sink->buf, data, size);
+        sink->len = size;
+        return 0;
+    }
+    size_t cap = sink->cap ? sink->cap : 4096;
+    while (cap < sink->len + size) cap *= 2;
+    char *grown = realloc(sink->buf, cap);
+    if (!grown) return -1;
+    sink->buf = grown;
+    sink->cap = cap;
+    memcpy(sink->buf + sink->len, data, size);
+    sink->len += size;
+    return 0;
+}
+
+static int transform_into(sink_t *sink, const transform_t *t, const char *data, size_t size, size_t clean) {
+    size_t body = body_start(t, data, size);
+    char needle = eol_needle(t);
+
+    if (t->bom == TRANSFORM_BOM_ADD && !has_bom(data, size) && sink_put(sink, bom, sizeof(bom)) != 0) {
+        return -1;
+    }
+    if (clean > body && sink_put(sink, data + body, clean - body) != 0) {
+        return -1;
+    }
+
+    const char *end = data + size;
+    const char *p = data + (clean > body ? clean : body);
+    while (p < end) {
+        const char *q = find_special(p, end, needle);
+        if (q > p && sink_put(sink, p, (size_t)(q - p)) != 0) {
+            return -1;
+        }
+        if (q == end) {
+            break;
+        }
+
+        unsigned char c = (unsigned char)*q;
+        int put;
+        if (c >= 0x80) {
+            size_t len = 1;
+            if (t->check_utf8) {
+                len = utf8_sequence((const unsigned char *)q, (const unsigned char *)end);
+                if (len == 0) {
+                    errno = EILSEQ;
+                    return -1;
+                }
+            }
+            put = sink_put(sink, q, len);
+            p = q + len;
+        } else if (c == '\r' && q + 1 < end && q[1] == '\n') {
+            put = sink_put(sink, "\n", 1); // LF output
+            p = q + 2;
+        } else if (c == '\n' && (q == data || q[-1] != '\r')) {
+            put = sink_put(sink, "\r\n", 2); // CRLF output
+            p = q + 1;
+        } else {
+            put = sink_put(sink, q, 1); // a lone '\r', or a '\n' whose '\r' is already out
+            p = q + 1;
+        }
+        if (put != 0) {
+            return -1;
+        }
+    }
+    return sink_flush(sink);
+}
+
+int transform_write(int fd, const transform_t *t, const char *data, size_t size, size_t clean) {
+    pthread_once(&kernel_once, pick_kernel);
+    sink_t sink = { .fd = fd, .cap = SINK_BUFFER_SIZE };
+    sink.buf = malloc(sink.cap);
+    if (!sink.buf) {
+        return -1;
+    }
+    int result = transform_into(&sink, t, data, size, clean);
+    free(sink.buf);
+    return result;
+}
+
+char *transform_to_buffer(const transform_t *t, const char *data, size_t size, size_t clean, size_t *out_size) {
+    pthread_once(&kernel_once, pick_kernel);
+    sink_t sink = { .fd = -1 };
+    if (transform_into(&sink, t, data, size, clean) != 0 || (!sink.buf && !(sink.buf = malloc(1)))) {
+        int saved = errno;
+        free(sink.buf);
+        errno = saved;
+        return NULL;
+    }
+    *out_size = sink.len;
+    return sink.buf;
+}
+
+int transform_parse_eol(const char *value, transform_eol_t *eol) {
+    if (strcmp(value, "lf") == 0) {
+        *eol = TRANSFORM_EOL_LF;
+    } else if (strcmp(value, "crlf") == 0) {
+        *eol = TRANSFORM_EOL_CRLF;
+    } else if (strcmp(value, "keep") == 0) {
+        *eol = TRANSFORM_EOL_KEEP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int transform_parse_bom(const char *value, transform_bom_t *bom_mode) {
+    if (strcmp(value, "strip") == 0) {
+        *bom_mode = TRANSFORM_BOM_STRIP;
+    } else if (strcmp(value, "add") == 0) {
+        *bom_mode = TRANSFORM_BOM_ADD;
+    } else if (strcmp(value, "keep") == 0) {
+        *bom_mode = TRANSFORM_BOM_KEEP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
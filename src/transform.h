@@ -0,0 +1,61 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stddef.h>
+
+// In-flight text transforms applied while copying: line endings converted
+// to LF or CRLF, a UTF-8 byte order mark stripped or added, and UTF-8
+// validated. A file is scanned up to the first byte that would change; a
+// file that needs no change is left to the regular (zero-copy) copy path,
+// and one that does is written as the unchanged prefix straight from the
+// source followed by the converted rest, so no byte is examined twice.
+// Files with a NUL byte in their first TRANSFORM_BINARY_PROBE bytes are
+// taken to be binary and copied as they are.
+//
+// The search for the next line ending or non-ASCII byte uses AVX2 when the
+// CPU has it, SSE2 on other x86-64 CPUs and plain C elsewhere, chosen at
+// run time.
+
+#define TRANSFORM_BINARY_PROBE 8000
+
+typedef enum {
+    TRANSFORM_EOL_KEEP,
+    TRANSFORM_EOL_LF,
+    TRANSFORM_EOL_CRLF
+} transform_eol_t;
+
+typedef enum {
+    TRANSFORM_BOM_KEEP,
+    TRANSFORM_BOM_STRIP,
+    TRANSFORM_BOM_ADD
+} transform_bom_t;
+
+typedef struct {
+    transform_eol_t eol;
+    transform_bom_t bom;
+    int check_utf8; // fail files that are not valid UTF-8 (EILSEQ)
+} transform_t;
+
+// Returns 1 when t changes nothing at all
+int transform_is_identity(const transform_t *t);
+
+// Scans data. Returns 1 when the output would equal the input, 0 when it
+// must be rewritten and -1 with errno EILSEQ on invalid UTF-8. *clean is
+// the offset of the first byte that changes; pass it to transform_write().
+int transform_scan(const transform_t *t, const char *data, size_t size, size_t *clean);
+
+// Writes the transformed data to fd, validating what the scan did not
+// reach. Returns -1 on a write error, or with errno EILSEQ on invalid UTF-8.
+int transform_write(int fd, const transform_t *t, const char *data, size_t size, size_t clean);
+
+// Same, into a malloc'ed buffer for further processing (placeholders)
+char *transform_to_buffer(const transform_t *t, const char *data, size_t size, size_t clean, size_t *out_size);
+
+// Parses the --eol and --bom values
+int transform_parse_eol(const char *value, transform_eol_t *eol);
+int transform_parse_bom(const char *value, transform_bom_t *bom);
+
+// Name of the kernel in use: "avx2", "sse2" or "scalar"
+const char *transform_kernel(void);
+
+#endif // TRANSFORM_H
@@ -0,0 +1,256 @@
+// For statx, AT_STATX_DONT_SYNC and syscall()
+#define _GNU_SOURCE
+
+#include "walk.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Pending directories: NUL-terminated relative paths packed into one buffer,
+// with their start offsets kept alongside
+typedef struct {
+    char *bytes;
+    size_t len;
+    size_t cap;
+    size_t *offsets;
+    size_t count;
+    size_t offsets_cap;
+    size_t limit;
+} dir_stack_t;
+
+static const unsigned long network_fs_magics[] = {
+    0x6969,     // NFS
+    0x517B,     // SMB
+    0xFF534D42, // CIFS
+    0xFE534D42, // SMB2
+    0x00C36400, // Ceph
+    0x5346414F, // AFS
+    0x65735546, // FUSE (sshfs and friends)
+};
+
+int walk_is_network_fs(int fd) {
+    struct statfs sfs;
+    if (fstatfs(fd, &sfs) != 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(network_fs_magics) / sizeof(network_fs_magics[0]); i++) {
+        if ((unsigned long)sfs.f_type == network_fs_magics[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int stack_reserve(dir_stack_t *stack, size_t bytes) {
+    size_t need = stack->len + bytes;
+    size_t need_offsets = stack->count + 1;
+
+    if (need > stack->cap) {
+        size_t cap = stack->cap ? stack->cap * 2 : 4096;
+        while (cap < need) cap *= 2;
+        if (cap + stack->offsets_cap * sizeof(size_t) > stack->limit) {
+            cap = need;
+        }
+        if (cap + stack->offsets_cap * sizeof(size_t) > stack->limit) {
+            errno = ENOMEM;
+            return -1;
+        }
+        char *bytes_new = realloc(stack->bytes, cap);
+        if (!bytes_new) return -1;
+        stack->bytes = bytes_new;
+        stack->cap = cap;
+    }
+
+    if (need_offsets > stack->offsets_cap) {
+        size_t cap = stack->offsets_cap ? stack->offsets_cap * 2 : 256;
+        if (stack->cap + cap * sizeof(size_t) > stack->limit) {
+            cap = need_offsets;
+        }
+        if (stack->cap + cap * sizeof(size_t) > stack->limit) {
+            errno = ENOMEM;
+            return -1;
+        }
+        size_t *offsets_new = realloc(stack->offsets, cap * sizeof(size_t));
+        if (!offsets_new) return -1;
+        stack->offsets = offsets_new;
+        stack->offsets_cap = cap;
+    }
+    return 0;
+}
+
+static int stack_push(dir_stack_t *stack, const char *path, size_t len) {
+    if (stack_reserve(stack, len + 1) != 0) {
+        return -1;
+    }
+    stack->offsets[stack->count++] = stack->len;
+    memcpy(stack->bytes + stack->len, path, len + 1);
+    stack->len += len + 1;
+    return 0;
+}
+
+static int stack_pop(dir_stack_t *stack, char *out, size_t out_size) {
+    if (stack->count == 0) {
+        return 0;
+    }
+    size_t offset = stack->offsets[--stack->count];
+    snprintf(out, out_size, "%s", stack->bytes + offset);
+    stack->len = offset;
+    return 1;
+}
+
+static walk_type_t type_from_dirent(unsigned char d_type) {
+    switch (d_type) {
+    case DT_REG: return WALK_FILE;
+    case DT_DIR: return WALK_DIR;
+    case DT_LNK: return WALK_SYMLINK;
+    default: return WALK_OTHER;
+    }
+}
+
+static walk_type_t type_from_mode(mode_t mode) {
+    if (S_ISREG(mode)) return WALK_FILE;
+    if (S_ISDIR(mode)) return WALK_DIR;
+    if (S_ISLNK(mode)) return WALK_SYMLINK;
+    return WALK_OTHER;
+}
+
+int walk_tree(const char *root, const walk_options_t *options, walk_fn fn, void *ctx) {
+    size_t buffer_size = options && options->buffer_size ? options->buffer_size : WALK_DEFAULT_BUFFER_SIZE;
+    dir_stack_t stack = {0};
+    stack.limit = options && options->mem_limit ? options->mem_limit : WALK_DEFAULT_MEM_LIMIT;
+
+    int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        perror("Error opening source directory");
+        return -1;
+    }
+
+    char *buffer = malloc(buffer_size);
+    if (!buffer) {
+        close(root_fd);
+        return -1;
+    }
+
+    // Don't force attribute revalidation on network filesystems
+    int statx_flags = AT_SYMLINK_NOFOLLOW;
+    if (walk_is_network_fs(root_fd)) {
+        statx_flags |= AT_STATX_DONT_SYNC;
+    }
+
+    int result = 0;
+    int aborted = 0;
+    char dir_path[PATH_MAX];
+    char entry_path[PATH_MAX];
+
+    if (stack_push(&stack, "", 0) != 0) {
+        fprintf(stderr, "Traversal memory limit (%zu bytes) reached at '%s'\n", stack.limit, root);
+        free(buffer);
+        close(root_fd);
+        return -1;
+    }
+    while (!aborted && stack_pop(&stack, dir_path, sizeof(dir_path))) {
+        int dir_fd = root_fd;
+        if (dir_path[0] != '\0') {
+            dir_fd = openat(root_fd, dir_path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (dir_fd < 0) {
+                fprintf(stderr, "Error opening directory '%s': %s\n", dir_path, strerror(errno));
+                result = -1;
+                continue;
+            }
+        }
+
+        for (;;) {
+            long n = syscall(SYS_getdents64, dir_fd, buffer, buffer_size);
+            if (n < 0) {
+                fprintf(stderr, "Error reading directory '%s': %s\n", dir_path, strerror(errno));
+                result = -1;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+
+            for (long off = 0; off < n && !aborted;) {
+                struct linux_dirent64 *d = (struct linux_dirent64 *)(void *)(buffer + off);
+                off += d->d_reclen;
+
+                if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) {
+                    continue;
+                }
+
+                walk_entry_t entry = {
+                    .dirfd = dir_fd,
+                    .name = d->d_name,
+                    .path = entry_path,
+                    .type = type_from_dirent(d->d_type),
+                    .ino = (ino_t)d->d_ino,
+                };
+
+                if (d->d_type == DT_UNKNOWN) {
+                    struct statx stx;
+                    if (statx(dir_fd, d->d_name, statx_flags, STATX_TYPE | STATX_INO, &stx) != 0) {
+                        fprintf(stderr, "Error getting stat for '%s': %s\n", d->d_name, strerror(errno));
+                        result = -1;
+                        continue;
+                    }
+                    entry.type = type_from_mode(stx.stx_mode);
+                    entry.ino = (ino_t)stx.stx_ino;
+                }
+
+                int len = dir_path[0] != '\0'
+                    ? snprintf(entry_path, sizeof(entry_path), "%s/%s", dir_path, d->d_name)
+                    : snprintf(entry_path, sizeof(entry_path), "%s", d->d_name);
+                if (len < 0 || (size_t)len >= sizeof(entry_path)) {
+                    fprintf(stderr, "Path too long, skipping: %s/%s\n", dir_path, d->d_name);
+                    result = -1;
+                    continue;
+                }
+
+                int action = fn(&entry, ctx);
+                if (action < 0) {
+                    result = -1;
+                } else if (action == WALK_STOP) {
+                    result = -1;
+                    aborted = 1;
+                } else if (entry.type == WALK_DIR && action == WALK_CONTINUE) {
+                    if (stack_push(&stack, entry_path, (size_t)len) != 0) {
+                        fprintf(stderr, "Traversal memory limit (%zu bytes) reached at '%s'\n",
+                                stack.limit, entry_path);
+                        result = -1;
+                        aborted = 1;
+                    }
+                }
+            }
+            if (aborted) {
+                break;
+            }
+        }
+
+        if (dir_fd != root_fd) {
+            close(dir_fd);
+        }
+    }
+
+    free(stack.bytes);
+    free(stack.offsets);
+    free(buffer);
+    close(root_fd);
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Iterative directory traversal over getdents64. Entry types come from
+// d_type; statx is only issued when the filesystem does not report one.
+// Pending directories live on an explicit stack whose memory is capped by
+// walk_options_t.mem_limit, so deep or huge trees never grow the C stack.
+
+#define WALK_DEFAULT_BUFFER_SIZE (256 * 1024)
+#define WALK_DEFAULT_MEM_LIMIT (64 * 1024 * 1024)
+// Smallest cap worth walking with: one getdents buffer plus one path
+#define WALK_MIN_MEM_LIMIT (WALK_DEFAULT_BUFFER_SIZE + PATH_MAX)
+
+typedef enum {
+    WALK_FILE,
+    WALK_DIR,
+    WALK_SYMLINK,
+    WALK_OTHER
+} walk_type_t;
+
+// Callback results
+#define WALK_CONTINUE 0
+#define WALK_SKIP 1 // do not descend into this directory
+#define WALK_STOP 2 // end the walk; walk_tree() returns -1
+
+typedef struct {
+    int dirfd;        // open parent directory, for *at() calls
+    const char *name; // entry name inside dirfd
+    const char *path; // path relative to the walk root
+    walk_type_t type;
+    ino_t ino;
+} walk_entry_t;
+
+typedef struct {
+    size_t buffer_size; // getdents64 buffer, 0 for the default
+    size_t mem_limit;   // bytes for pending directories, 0 for the default
+} walk_options_t;
+
+typedef int (*walk_fn)(const walk_entry_t *entry, void *ctx);
+
+int walk_tree(const char *root, const walk_options_t *options, walk_fn fn, void *ctx);
+int walk_is_network_fs(int fd);
+
+#endif // WALK_H
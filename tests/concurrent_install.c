@@ -0,0 +1,228 @@
+// For mkdtemp and nftw
+#define _GNU_SOURCE
+
+// Concurrency stress test. Forks N workers that install into the same
+// destination at the same moment, then checks the results byte for byte:
+//
+// - templates: every worker runs copy_all_templates(); the result must match
+//   a reference install made alone.
+// - trees: each worker copies one of several source variants, whose files
+//   differ in content and size, with copy_directory(); every resulting file
+//   must equal the same file of exactly one variant, never a mix.
+//
+// Usage: concurrent_install [workers] [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "copy.h"
+
+#define VARIANTS 3
+#define TREE_FILES 4
+
+static char work_dir[] = "/tmp/rpc-concurrent-XXXXXX";
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+static void cleanup(void) {
+    nftw(work_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// Variant files differ in size and content so interleaved writes show up
+static int make_variants(void) {
+    char path[4096];
+    for (int v = 0; v < VARIANTS; v++) {
+        snprintf(path, sizeof(path), "%s/variant%d", work_dir, v);
+        if (mkdir(path, 0755) != 0) return -1;
+
+        for (int f = 0; f < TREE_FILES; f++) {
+            size_t size = (size_t)(1 + (v * TREE_FILES + f) % 4) * 1024 * 1024 + (size_t)v * 4099;
+            unsigned char *data = malloc(size);
+            if (!data) return -1;
+            uint32_t x = (uint32_t)(v * 7919 + f * 104729 + 1);
+            for (size_t i = 0; i < size; i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                data[i] = (unsigned char)x;
+            }
+
+            snprintf(path, sizeof(path), "%s/variant%d/file%d.bin", work_dir, v, f);
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            int ok = fd >= 0 && write(fd, data, size) == (ssize_t)size;
+            if (fd >= 0) close(fd);
+            free(data);
+            if (!ok) return -1;
+        }
+    }
+    return 0;
+}
+
+static int files_equal(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int equal = fa && fb;
+    char ba[65536];
+    char bb[65536];
+
+    while (equal) {
+        size_t na = fread(ba, 1, sizeof(ba), fa);
+        size_t nb = fread(bb, 1, sizeof(bb), fb);
+        if (na != nb || memcmp(ba, bb, na) != 0) {
+            equal = 0;
+        }
+        if (na == 0) break;
+    }
+
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return equal;
+}
+
+static const char *compare_base;
+static const char *compare_other;
+static int compare_failures;
+
+static int compare_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type != FTW_F) return 0;
+
+    char other[4096];
+    snprintf(other, sizeof(other), "%s%s", compare_other, path + strlen(compare_base));
+    if (!files_equal(path, other)) {
+        fprintf(stderr, "Mismatch: %s\n", other);
+        compare_failures++;
+    }
+    return 0;
+}
+
+static int trees_equal(const char *reference, const char *actual) {
+    compare_base = reference;
+    compare_other = actual;
+    compare_failures = 0;
+    if (nftw(reference, compare_entry, 16, FTW_PHYS) != 0) return 0;
+    return compare_failures == 0;
+}
+
+static int run_round(int workers, int round) {
+    char dest[4096];
+    char templates[4200];
+    char tree[4200];
+    snprintf(dest, sizeof(dest), "%s/dest%d", work_dir, round);
+    snprintf(templates, sizeof(templates), "%s/templates", dest);
+    snprintf(tree, sizeof(tree), "%s/tree", dest);
+
+    // Workers block on the pipe until every one of them has been forked
+    int gate[2];
+    if (pipe(gate) != 0) return -1;
+
+    for (int i = 0; i < workers; i++) {
+        pid_t pid = fork();
+        if (pid < 0) return -1;
+        if (pid == 0) {
+            char c;
+            close(gate[1]);
+            if (read(gate[0], &c, 1) < 0) _exit(1);
+            if (!freopen("/dev/null", "w", stdout)) _exit(1);
+
+            char variant[4200];
+            snprintf(variant, sizeof(variant), "%s/variant%d", work_dir, i % VARIANTS);
+            copy_options_t options = {0};
+            copy_set_options(&options);
+            int failed = copy_all_templates(templates) != 0;
+            failed |= copy_directory(variant, tree) != 0;
+            _exit(failed);
+        }
+    }
+    close(gate[0]);
+    close(gate[1]);
+
+    int failed = 0;
+    int status;
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "Round %d: a worker failed\n", round);
+        return -1;
+    }
+
+    char reference[4200];
+    snprintf(reference, sizeof(reference), "%s/reference", work_dir);
+    if (!trees_equal(reference, templates)) {
+        fprintf(stderr, "Round %d: templates differ from the reference install\n", round);
+        return -1;
+    }
+
+    for (int f = 0; f < TREE_FILES; f++) {
+        char actual[4300];
+        snprintf(actual, sizeof(actual), "%s/file%d.bin", tree, f);
+        int matches = 0;
+        for (int v = 0; v < VARIANTS; v++) {
+            char expected[4300];
+            snprintf(expected, sizeof(expected), "%s/variant%d/file%d.bin", work_dir, v, f);
+            matches += files_equal(expected, actual);
+        }
+        if (matches != 1) {
+            fprintf(stderr, "Round %d: %s matches no single source\n", round, actual);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : 8;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    if (workers < 2 || rounds < 1) {
+        fprintf(stderr, "Usage: %s [workers >= 2] [rounds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!mkdtemp(work_dir) || make_variants() != 0) {
+        perror("Error creating fixtures");
+        return EXIT_FAILURE;
+    }
+
+    // Reference install, made alone and without starting a worker pool in
+    // the parent before forking
+    char reference[4200];
+    snprintf(reference, sizeof(reference), "%s/reference", work_dir);
+    copy_options_t options = { .jobs = 1 };
+    copy_set_options(&options);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    if (!freopen("/dev/null", "w", stdout) || copy_all_templates(reference) != 0) {
+        fprintf(stderr, "Reference install failed\n");
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    int result = EXIT_SUCCESS;
+    for (int round = 0; round < rounds && result == EXIT_SUCCESS; round++) {
+        if (run_round(workers, round) != 0) {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    cleanup();
+    if (result == EXIT_SUCCESS) {
+        printf("%d rounds of %d concurrent installs: identical\n", rounds, workers);
+    }
+    return result;
+}
@@ -0,0 +1,279 @@
+// For mkdtemp, setenv and nftw
+#define _GNU_SOURCE
+
+// Checks git_stage_paths() against git itself. The same files are staged
+// with `git add` in one repository and with git_stage_paths() in another:
+//
+// - the trees `git write-tree` makes from both indexes must be identical,
+//   before and after a second round that changes and adds files;
+// - `git fsck --strict` must accept the objects and the index;
+// - `git diff --quiet` must see the work tree and the index agree;
+// - files git add would convert (core.autocrlf, text/eol attributes) must be
+//   refused, leaving the index untouched.
+//
+// Usage: git_stage GIT (exits 77, skipped, without a working git)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gitstage.h"
+
+static char work_dir[] = "/tmp/rpc-git-stage-XXXXXX";
+static const char *git = "git";
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+static void cleanup(void) {
+    nftw(work_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// Runs git in a repository of the work directory, quietly
+static int run_git(const char *repo, const char *args) {
+    char command[4096];
+    snprintf(command, sizeof(command), "'%s' -C '%s/%s' %s >/dev/null 2>&1", git, work_dir, repo, args);
+    int status = system(command);
+    return status == 0 ? 0 : -1;
+}
+
+// The first line git prints, e.g. the tree id from write-tree
+static int git_output(const char *repo, const char *args, char *out, size_t size) {
+    char command[4096];
+    snprintf(command, sizeof(command), "'%s' -C '%s/%s' %s 2>/dev/null", git, work_dir, repo, args);
+    FILE *p = popen(command, "r");
+    if (!p) return -1;
+    int ok = fgets(out, (int)size, p) != NULL;
+    int status = pclose(p);
+    out[strcspn(out, "\n")] = '\0';
+    return ok && status == 0 ? 0 : -1;
+}
+
+static int write_file(const char *repo, const char *name, const void *data, size_t size, mode_t mode) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s/%s", work_dir, repo, name);
+    for (char *p = strchr(path + strlen(work_dir) + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ok = fd >= 0 && write(fd, data, size) == (ssize_t)size && fchmod(fd, mode) == 0;
+    if (fd >= 0) close(fd);
+    return ok ? 0 : -1;
+}
+
+static int write_text(const char *repo, const char *name, const char *text) {
+    return write_file(repo, name, text, strlen(text), 0644);
+}
+
+static int make_repo(const char *repo) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", work_dir, repo);
+    if (mkdir(path, 0755) != 0 || run_git(repo, "init -q") != 0) {
+        return -1;
+    }
+    // One committed file, so staging replaces an entry as well as adding
+    if (write_text(repo, "kept.txt", "unchanged\n") != 0 || write_text(repo, "docs/old.md", "old\n") != 0 ||
+        run_git(repo, "add kept.txt docs/old.md") != 0 ||
+        run_git(repo, "-c user.name=t -c user.email=t@t commit -q -m base") != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes one round of files into both repositories and stages them, with
+// git add in "added" and git_stage_paths() in "staged"
+static int stage_round(int round, const char *const *names, size_t count) {
+    unsigned char binary[70000]; // more than one stored deflate block
+    for (size_t i = 0; i < sizeof(binary); i++) {
+        binary[i] = (unsigned char)(i * 7 + (size_t)round);
+    }
+    char text[256];
+    const char *repos[] = {"added", "staged"};
+    for (int r = 0; r < 2; r++) {
+        snprintf(text, sizeof(text), "# Title %d\r\n\r\nCRLF kept as is\r\n", round);
+        if (write_text(repos[r], "docs/old.md", text) != 0 ||
+            write_text(repos[r], ".github/prompts/a.prompt.md", round ? "changed\n" : "prompt\n") != 0 ||
+            write_file(repos[r], "tools/run.sh", "#!/bin/sh\n", 10, 0755) != 0 ||
+            write_file(repos[r], "data/blob.bin", binary, sizeof(binary), 0644) != 0 ||
+            write_text(repos[r], "empty", "") != 0) {
+            return -1;
+        }
+        if (round > 0 && write_text(repos[r], "a/b/c/deep.txt", "deep\n") != 0) {
+            return -1;
+        }
+    }
+
+    char args[4096] = "add --";
+    for (size_t i = 0; i < count; i++) {
+        strncat(args, " ", sizeof(args) - strlen(args) - 1);
+        strncat(args, names[i], sizeof(args) - strlen(args) - 1);
+    }
+    if (run_git("added", args) != 0) {
+        fprintf(stderr, "round %d: git add failed\n", round);
+        return -1;
+    }
+
+    char dir[4096];
+    char paths[16][4096];
+    const char *path_list[16];
+    snprintf(dir, sizeof(dir), "%s/staged", work_dir);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/staged/%s", work_dir, names[i]);
+        path_list[i] = paths[i];
+    }
+    git_stage_stats_t stats;
+    if (git_stage_paths(dir, path_list, count, &stats) != 0) {
+        fprintf(stderr, "round %d: git_stage_paths failed\n", round);
+        return -1;
+    }
+
+    char added_tree[128];
+    char staged_tree[128];
+    if (git_output("added", "write-tree", added_tree, sizeof(added_tree)) != 0 ||
+        git_output("staged", "write-tree", staged_tree, sizeof(staged_tree)) != 0) {
+        fprintf(stderr, "round %d: git write-tree failed\n", round);
+        return -1;
+    }
+    if (strcmp(added_tree, staged_tree) != 0) {
+        fprintf(stderr, "round %d: tree %s from git add, %s staged\n", round, added_tree, staged_tree);
+        return -1;
+    }
+    if (run_git("staged", "fsck --strict --no-dangling") != 0) {
+        fprintf(stderr, "round %d: git fsck rejects the staged repository\n", round);
+        return -1;
+    }
+    if (run_git("staged", "diff --quiet") != 0) {
+        fprintf(stderr, "round %d: the work tree differs from the staged index\n", round);
+        return -1;
+    }
+    printf("round %d: %zu staged, %zu unchanged, tree %s\n", round, stats.staged, stats.unchanged, staged_tree);
+    return 0;
+}
+
+static int read_index(const char *repo, char **data, size_t *size) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s/.git/index", work_dir, repo);
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    *data = malloc(1 << 20);
+    *size = *data ? fread(*data, 1, 1 << 20, f) : 0;
+    fclose(f);
+    return *data ? 0 : -1;
+}
+
+// git_stage_paths() must refuse, and the index must be byte-identical after
+static int expect_refused(const char *what, const char *name) {
+    char *before = NULL;
+    char *after = NULL;
+    size_t before_size = 0;
+    size_t after_size = 0;
+    char dir[4096];
+    char path[4096];
+    snprintf(dir, sizeof(dir), "%s/converted", work_dir);
+    snprintf(path, sizeof(path), "%s/converted/%s", work_dir, name);
+    const char *paths[] = {path};
+    git_stage_stats_t stats;
+
+    int result = read_index("converted", &before, &before_size);
+    if (result == 0 && git_stage_paths(dir, paths, 1, &stats) == 0) {
+        fprintf(stderr, "%s: staged a file git add would convert\n", what);
+        result = -1;
+    }
+    if (result == 0 && (read_index("converted", &after, &after_size) != 0 || after_size != before_size ||
+                        memcmp(before, after, before_size) != 0)) {
+        fprintf(stderr, "%s: the index changed\n", what);
+        result = -1;
+    }
+    free(before);
+    free(after);
+    if (result == 0) {
+        printf("%s: refused\n", what);
+    }
+    return result;
+}
+
+static int check_conversions(void) {
+    if (make_repo("converted") != 0 || write_text("converted", "notes.md", "a\r\nb\r\n") != 0 ||
+        write_text("converted", "plain.txt", "plain\n") != 0) {
+        return -1;
+    }
+
+    // A pattern in a subdirectory's attributes, then core.autocrlf
+    if (write_text("converted", "sub/.gitattributes", "*.md text eol=lf\n") != 0 ||
+        write_text("converted", "sub/x.md", "x\r\n") != 0 || expect_refused("sub/.gitattributes", "sub/x.md") != 0) {
+        return -1;
+    }
+    if (write_text("converted", ".gitattributes", "[attr]lf text eol=lf\n*.md lf\n") != 0 ||
+        expect_refused("attribute macro", "notes.md") != 0) {
+        return -1;
+    }
+    if (run_git("converted", "config core.autocrlf input") != 0 || expect_refused("core.autocrlf", "plain.txt") != 0) {
+        return -1;
+    }
+
+    // Unset conversions leave the bytes alone, so those files are staged
+    char dir[4096];
+    char path[4096];
+    snprintf(dir, sizeof(dir), "%s/converted", work_dir);
+    snprintf(path, sizeof(path), "%s/converted/notes.md", work_dir);
+    const char *paths[] = {path};
+    git_stage_stats_t stats;
+    if (run_git("converted", "config core.autocrlf false") != 0 ||
+        write_text("converted", ".gitattributes", "*.md -text\n*.bin binary\n") != 0 ||
+        git_stage_paths(dir, paths, 1, &stats) != 0 || stats.staged != 1) {
+        fprintf(stderr, "-text: not staged\n");
+        return -1;
+    }
+    printf("-text: staged\n");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        git = argv[1];
+    }
+    if (!mkdtemp(work_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    atexit(cleanup);
+
+    // Only this test's configuration, for git and for git_stage_paths()
+    setenv("HOME", work_dir, 1);
+    unsetenv("XDG_CONFIG_HOME");
+    unsetenv("GIT_CONFIG_GLOBAL");
+    setenv("GIT_CONFIG_NOSYSTEM", "1", 1);
+    char version[128];
+    snprintf(version, sizeof(version), "'%s' --version >/dev/null 2>&1", git);
+    if (system(version) != 0) {
+        printf("git not found; skipped\n");
+        return 77;
+    }
+
+    if (make_repo("added") != 0 || make_repo("staged") != 0) {
+        fprintf(stderr, "cannot create the test repositories\n");
+        return 1;
+    }
+    static const char *const first[] = {
+        "docs/old.md", ".github/prompts/a.prompt.md", "tools/run.sh", "data/blob.bin", "empty",
+    };
+    static const char *const second[] = {
+        "docs/old.md", ".github/prompts/a.prompt.md", "a/b/c/deep.txt", "tools/run.sh", "data/blob.bin",
+        "empty",
+    };
+    if (stage_round(0, first, sizeof(first) / sizeof(first[0])) != 0 ||
+        stage_round(1, second, sizeof(second) / sizeof(second[0])) != 0 || check_conversions() != 0) {
+        return 1;
+    }
+    printf("git_stage: ok\n");
+    return 0;
+}
@@ -0,0 +1,372 @@
+// For statx, fallocate, flock and mkdtemp
+#define _GNU_SOURCE
+
+// Syscall-budget regression test. The install paths are linked into this
+// driver with -Wl,--wrap for every libc entry point they use, so only calls
+// made by replica's own code are counted, deterministically and without
+// privileges. A scenario fails when any category exceeds its line in the
+// budget file.
+//
+// Usage: syscall_budget <budget-file> <scenario> [fixture-tree]
+// Scenarios: readme, all, tree; a "-pack" suffix only selects another budget
+// line (the test sets REPLICA_PACK to choose where templates come from).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/vfs.h>
+#include "copy.h"
+
+enum {
+    SC_OPEN,
+    SC_STAT,
+    SC_MKDIR,
+    SC_READ,
+    SC_WRITE,
+    SC_OTHER,
+    SC_COUNT
+};
+
+static const char *const category_names[SC_COUNT] = {"open", "stat", "mkdir", "read", "write", "other"};
+
+static unsigned long counts[SC_COUNT];
+static int counting;
+
+// Copies may run on the worker pool
+#define COUNT(category)                                                   \
+    do {                                                                  \
+        if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {              \
+            __atomic_fetch_add(&counts[category], 1, __ATOMIC_RELAXED);  \
+        }                                                                 \
+    } while (0)
+
+int __real_open(const char *path, int flags, ...);
+int __real_openat(int dirfd, const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_stat(const char *path, struct stat *st);
+int __real_fstat(int fd, struct stat *st);
+int __real_fstatat(int dirfd, const char *path, struct stat *st, int flags);
+int __real_statx(int dirfd, const char *path, int flags, unsigned mask, struct statx *stx);
+int __real_fstatfs(int fd, struct statfs *sfs);
+ssize_t __real_readlink(const char *path, char *buf, size_t size);
+int __real_mkdir(const char *path, mode_t mode);
+int __real_mkdirat(int dirfd, const char *path, mode_t mode);
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+off_t __real_lseek(int fd, off_t offset, int whence);
+int __real_ftruncate(int fd, off_t length);
+int __real_fchmod(int fd, mode_t mode);
+int __real_chmod(const char *path, mode_t mode);
+int __real_fallocate(int fd, int mode, off_t offset, off_t len);
+int __real_fcntl(int fd, int cmd, ...);
+int __real_flock(int fd, int operation);
+void *__real_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int __real_munmap(void *addr, size_t length);
+int __real_madvise(void *addr, size_t length, int advice);
+int __real_ioctl(int fd, unsigned long request, ...);
+ssize_t __real_copy_file_range(int in, off_t *in_off, int out, off_t *out_off, size_t len, unsigned flags);
+ssize_t __real_sendfile(int out, int in, off_t *offset, size_t count);
+int __real_sync_file_range(int fd, off_t offset, off_t nbytes, unsigned flags);
+int __real_posix_fadvise(int fd, off_t offset, off_t len, int advice);
+long __real_syscall(long number, ...);
+
+int __wrap_open(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = (mode_t)va_arg(ap, int);
+        va_end(ap);
+    }
+    COUNT(SC_OPEN);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_openat(int dirfd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = (mode_t)va_arg(ap, int);
+        va_end(ap);
+    }
+    COUNT(SC_OPEN);
+    return __real_openat(dirfd, path, flags, mode);
+}
+
+int __wrap_stat(const char *path, struct stat *st) {
+    COUNT(SC_STAT);
+    return __real_stat(path, st);
+}
+
+int __wrap_fstat(int fd, struct stat *st) {
+    COUNT(SC_STAT);
+    return __real_fstat(fd, st);
+}
+
+int __wrap_fstatat(int dirfd, const char *path, struct stat *st, int flags) {
+    COUNT(SC_STAT);
+    return __real_fstatat(dirfd, path, st, flags);
+}
+
+int __wrap_statx(int dirfd, const char *path, int flags, unsigned mask, struct statx *stx) {
+    COUNT(SC_STAT);
+    return __real_statx(dirfd, path, flags, mask, stx);
+}
+
+int __wrap_fstatfs(int fd, struct statfs *sfs) {
+    COUNT(SC_STAT);
+    return __real_fstatfs(fd, sfs);
+}
+
+ssize_t __wrap_readlink(const char *path, char *buf, size_t size) {
+    COUNT(SC_STAT);
+    return __real_readlink(path, buf, size);
+}
+
+int __wrap_mkdir(const char *path, mode_t mode) {
+    COUNT(SC_MKDIR);
+    return __real_mkdir(path, mode);
+}
+
+int __wrap_mkdirat(int dirfd, const char *path, mode_t mode) {
+    COUNT(SC_MKDIR);
+    return __real_mkdirat(dirfd, path, mode);
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t count) {
+    COUNT(SC_READ);
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t count, off_t offset) {
+    COUNT(SC_READ);
+    return __real_pread(fd, buf, count, offset);
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t count) {
+    COUNT(SC_WRITE);
+    return __real_write(fd, buf, count);
+}
+
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    COUNT(SC_WRITE);
+    return __real_pwrite(fd, buf, count, offset);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt) {
+    COUNT(SC_WRITE);
+    return __real_writev(fd, iov, iovcnt);
+}
+
+int __wrap_close(int fd) {
+    COUNT(SC_OTHER);
+    return __real_close(fd);
+}
+
+off_t __wrap_lseek(int fd, off_t offset, int whence) {
+    COUNT(SC_OTHER);
+    return __real_lseek(fd, offset, whence);
+}
+
+int __wrap_ftruncate(int fd, off_t length) {
+    COUNT(SC_OTHER);
+    return __real_ftruncate(fd, length);
+}
+
+int __wrap_fchmod(int fd, mode_t mode) {
+    COUNT(SC_OTHER);
+    return __real_fchmod(fd, mode);
+}
+
+int __wrap_chmod(const char *path, mode_t mode) {
+    COUNT(SC_OTHER);
+    return __real_chmod(path, mode);
+}
+
+int __wrap_fallocate(int fd, int mode, off_t offset, off_t len) {
+    COUNT(SC_OTHER);
+    return __real_fallocate(fd, mode, offset, len);
+}
+
+int __wrap_fcntl(int fd, int cmd, ...) {
+    va_list ap;
+    va_start(ap, cmd);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    COUNT(SC_OTHER);
+    return __real_fcntl(fd, cmd, arg);
+}
+
+int __wrap_flock(int fd, int operation) {
+    COUNT(SC_OTHER);
+    return __real_flock(fd, operation);
+}
+
+void *__wrap_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    COUNT(SC_OTHER);
+    return __real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+int __wrap_munmap(void *addr, size_t length) {
+    COUNT(SC_OTHER);
+    return __real_munmap(addr, length);
+}
+
+int __wrap_madvise(void *addr, size_t length, int advice) {
+    COUNT(SC_OTHER);
+    return __real_madvise(addr, length, advice);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...) {
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    COUNT(SC_OTHER);
+    return __real_ioctl(fd, request, arg);
+}
+
+// In-kernel copies move data without a read, so they count as writes
+ssize_t __wrap_copy_file_range(int in, off_t *in_off, int out, off_t *out_off, size_t len, unsigned flags) {
+    COUNT(SC_WRITE);
+    return __real_copy_file_range(in, in_off, out, out_off, len, flags);
+}
+
+ssize_t __wrap_sendfile(int out, int in, off_t *offset, size_t count) {
+    COUNT(SC_WRITE);
+    return __real_sendfile(out, in, offset, count);
+}
+
+int __wrap_sync_file_range(int fd, off_t offset, off_t nbytes, unsigned flags) {
+    COUNT(SC_OTHER);
+    return __real_sync_file_range(fd, offset, nbytes, flags);
+}
+
+int __wrap_posix_fadvise(int fd, off_t offset, off_t len, int advice) {
+    COUNT(SC_OTHER);
+    return __real_posix_fadvise(fd, offset, len, advice);
+}
+
+// Raw syscalls (getdents64 in the tree walker) take up to six word-sized
+// arguments; getdents64 counts as a read
+long __wrap_syscall(long number, ...) {
+    va_list ap;
+    long args[6];
+    va_start(ap, number);
+    for (int i = 0; i < 6; i++) {
+        args[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+
+    COUNT(number == SYS_getdents64 ? SC_READ : SC_OTHER);
+    return __real_syscall(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+// Reads "<scenario> <open> <stat> <mkdir> <read> <write> <other>" from the
+// budget file; '#' starts a comment
+static int load_budget(const char *path, const char *scenario, unsigned long budget[SC_COUNT]) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("Error opening budget file");
+        return -1;
+    }
+
+    char line[256];
+    int found = -1;
+    while (found != 0 && fgets(line, sizeof(line), file)) {
+        char name[64];
+        if (line[0] == '#' ||
+            sscanf(line, "%63s %lu %lu %lu %lu %lu %lu", name, &budget[SC_OPEN], &budget[SC_STAT],
+                   &budget[SC_MKDIR], &budget[SC_READ], &budget[SC_WRITE], &budget[SC_OTHER]) != 7) {
+            continue;
+        }
+        if (strcmp(name, scenario) == 0) {
+            found = 0;
+        }
+    }
+    fclose(file);
+
+    if (found != 0) {
+        fprintf(stderr, "No budget for scenario '%s' in %s\n", scenario, path);
+    }
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <budget-file> <scenario> [fixture-tree]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *budget_path = argv[1];
+    const char *scenario = argv[2];
+    size_t op_len = strcspn(scenario, "-");
+
+    unsigned long budget[SC_COUNT];
+    if (load_budget(budget_path, scenario, budget) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Install into a fixed relative path so mkdir -p depth doesn't depend on
+    // where the temporary directory lives
+    char work_dir[] = "/tmp/rpc-budget-XXXXXX";
+    if (!mkdtemp(work_dir) || chdir(work_dir) != 0) {
+        perror("Error creating work directory");
+        return EXIT_FAILURE;
+    }
+
+    copy_options_t options = {0};
+    copy_set_options(&options);
+
+    int result;
+    __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+    if (strncmp(scenario, "readme", op_len) == 0 && op_len == 6) {
+        result = copy_readme("out");
+    } else if (strncmp(scenario, "all", op_len) == 0 && op_len == 3) {
+        result = copy_all_templates("out");
+    } else if (strncmp(scenario, "tree", op_len) == 0 && op_len == 4 && argc > 3) {
+        result = copy_directory(argv[3], "out");
+    } else {
+        fprintf(stderr, "Unknown scenario '%s'\n", scenario);
+        result = -1;
+    }
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+
+    if (chdir("/") != 0 || nftw(work_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS) != 0) {
+        perror("Error removing work directory");
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "Scenario '%s' failed\n", scenario);
+        return EXIT_FAILURE;
+    }
+
+    int over = 0;
+    printf("\n%-8s %8s %8s\n", "syscall", "count", "budget");
+    for (int i = 0; i < SC_COUNT; i++) {
+        int exceeded = counts[i] > budget[i];
+        printf("%-8s %8lu %8lu%s\n", category_names[i], counts[i], budget[i], exceeded ? "  OVER BUDGET" : "");
+        over |= exceeded;
+    }
+    return over ? EXIT_FAILURE : EXIT_SUCCESS;
+}
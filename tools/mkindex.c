@@ -0,0 +1,183 @@
+// Build-time tool: builds the 'rpc search' inverted index over the template
+// options listed by 'rpc help' and writes it as C source (see src/search.h).
+//
+// Usage: rpc-mkindex <output.c> <root>
+// Template bodies are read from the .github trees under <root>.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/print_utils.h"
+#include "../src/search.h"
+#include "../src/templates.h"
+
+// Where a term was seen
+enum { IN_FLAG, IN_DESCRIPTION, IN_BODY };
+
+typedef struct {
+    char term[SEARCH_TERM_MAX];
+    int doc;
+    int field;
+} occurrence_t;
+
+static occurrence_t *occurrences;
+static size_t occurrence_count;
+static size_t occurrence_cap;
+
+static int add_text(int doc, int field, const char *text, size_t size) {
+    const char *p = text;
+    char term[SEARCH_TERM_MAX];
+    while (search_next_term(&p, text + size, term)) {
+        if (occurrence_count == occurrence_cap) {
+            occurrence_cap = occurrence_cap ? occurrence_cap * 2 : 4096;
+            occurrences = realloc(occurrences, occurrence_cap * sizeof(occurrence_t));
+            if (!occurrences) {
+                fprintf(stderr, "rpc-mkindex: out of memory\n");
+                return -1;
+            }
+        }
+        occurrence_t *o = &occurrences[occurrence_count++];
+        memcpy(o->term, term, sizeof(term));
+        o->doc = doc;
+        o->field = field;
+    }
+    return 0;
+}
+
+static int add_file(int doc, const char *root, const char *subdir, const char *name) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s/%s", root, subdir, name);
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(len > 0 ? (size_t)len : 1);
+    if (!data || fread(data, 1, (size_t)len, f) != (size_t)len) {
+        perror(path);
+        fclose(f);
+        free(data);
+        return -1;
+    }
+    fclose(f);
+    int result = add_text(doc, IN_BODY, data, (size_t)len);
+    free(data);
+    return result;
+}
+
+static int compare_occurrences(const void *a, const void *b) {
+    const occurrence_t *x = a;
+    const occurrence_t *y = b;
+    int c = strcmp(x->term, y->term);
+    return c != 0 ? c : x->doc - y->doc;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <output.c> <root>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (help_template_count > 255) {
+        fprintf(stderr, "rpc-mkindex: postings hold document numbers in one byte\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int doc = 0; doc < help_template_count; doc++) {
+        const template_info_t *info = &help_templates[doc];
+        const char *flag = info->flag + 2;
+        if (add_text(doc, IN_FLAG, flag, strlen(flag)) != 0 ||
+            add_text(doc, IN_FLAG, info->name, strlen(info->name)) != 0 ||
+            add_text(doc, IN_DESCRIPTION, info->description, strlen(info->description)) != 0) {
+            return EXIT_FAILURE;
+        }
+
+        // "--all" has no files of its own
+        const template_set_t *set = template_set_find(flag);
+        if (set && (add_file(doc, argv[2], TEMPLATE_PROMPTS_DIR, set->prompt) != 0 ||
+                    add_file(doc, argv[2], TEMPLATE_INSTRUCTIONS_DIR, set->instructions) != 0)) {
+            return EXIT_FAILURE;
+        }
+    }
+    qsort(occurrences, occurrence_count, sizeof(occurrence_t), compare_occurrences);
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "// Generated by rpc-mkindex; do not edit\n#include \"search.h\"\n\n");
+
+    // Terms, one per line. Spelled out as characters, since a single string
+    // literal this long is beyond what ISO C compilers must accept.
+    fprintf(out, "static const char terms[] = {\n");
+    size_t term_count = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < occurrence_count; i++) {
+        if (i == 0 || strcmp(occurrences[i].term, occurrences[i - 1].term) != 0) {
+            fprintf(out, "   ");
+            for (const char *c = occurrences[i].term; *c; c++) {
+                fprintf(out, " '%c',", *c);
+            }
+            fprintf(out, " 0,\n");
+            term_count++;
+        }
+    }
+    fprintf(out, "};\n\nstatic const search_term_t table[] = {\n");
+
+    // One posting per (term, document) run of the sorted occurrences
+    size_t posting_count = 0;
+    size_t first = 0;
+    size_t term_postings = 0;
+    for (size_t i = 0; i < occurrence_count; i++) {
+        int new_term = i == 0 || strcmp(occurrences[i].term, occurrences[i - 1].term) != 0;
+        if (new_term && i > 0) {
+            fprintf(out, "    {%zu, %zu, %zu},\n", offset, first, term_postings);
+            offset += strlen(occurrences[i - 1].term) + 1;
+        }
+        if (new_term) {
+            first = posting_count;
+            term_postings = 0;
+        }
+        if (new_term || occurrences[i].doc != occurrences[i - 1].doc) {
+            posting_count++;
+            term_postings++;
+        }
+    }
+    if (occurrence_count > 0) {
+        fprintf(out, "    {%zu, %zu, %zu},\n", offset, first, term_postings);
+    }
+    fprintf(out, "};\n\nstatic const unsigned char postings[] = {\n");
+
+    for (size_t i = 0; i < occurrence_count;) {
+        int in_flag = 0;
+        int in_description = 0;
+        int body = 0;
+        size_t j = i;
+        for (; j < occurrence_count && occurrences[j].doc == occurrences[i].doc &&
+               strcmp(occurrences[j].term, occurrences[i].term) == 0; j++) {
+            in_flag |= occurrences[j].field == IN_FLAG;
+            in_description |= occurrences[j].field == IN_DESCRIPTION;
+            body += occurrences[j].field == IN_BODY;
+        }
+        int weight = (in_flag ? SEARCH_WEIGHT_FLAG : 0) + (in_description ? SEARCH_WEIGHT_DESCRIPTION : 0) +
+                     (body < SEARCH_WEIGHT_BODY_MAX ? body : SEARCH_WEIGHT_BODY_MAX);
+        fprintf(out, "    %d, %d,\n", occurrences[i].doc, weight);
+        i = j;
+    }
+    fprintf(out, "};\n\nconst search_index_t search_index = {\n"
+                 "    .terms = terms,\n    .table = table,\n    .term_count = %zu,\n"
+                 "    .postings = postings,\n    .doc_count = %d,\n};\n",
+            term_count, help_template_count);
+
+    if (ferror(out) || fclose(out) != 0) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf("rpc-mkindex: %zu terms, %zu postings over %d templates\n", term_count, posting_count,
+           help_template_count);
+    return EXIT_SUCCESS;
+}
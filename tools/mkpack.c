@@ -0,0 +1,221 @@
+// Build-time tool: trains a zstd dictionary over the template corpus and
+// writes a templates.pack (see src/pack.h for the format).
+//
+// Usage: rpc-mkpack <output> <root> <file>...
+// Entry names are the file paths relative to <root>, e.g.
+// "/.github/prompts/ROADMAP.prompt.md".
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <zstd.h>
+#include <zdict.h>
+#include "../src/pack.h"
+#include "../src/render.h"
+
+#define DICT_CAPACITY (4 * 1024)
+#define COMPRESSION_LEVEL 19
+
+typedef struct {
+    char *name;
+    unsigned char *data;
+    size_t size;
+    unsigned char *frame;
+    size_t frame_size;
+} input_t;
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static int read_whole_file(const char *path, unsigned char **data, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    *data = malloc(len > 0 ? (size_t)len : 1);
+    *size = len > 0 ? (size_t)len : 0;
+    if (!*data || fread(*data, 1, *size, f) != *size) {
+        perror(path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int compare_inputs(const void *a, const void *b) {
+    return strcmp(((const input_t *)a)->name, ((const input_t *)b)->name);
+}
+
+static size_t train_dictionary(input_t *inputs, int count, unsigned char *dict) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += inputs[i].size;
+
+    unsigned char *samples = malloc(total ? total : 1);
+    size_t *sizes = malloc(sizeof(size_t) * (size_t)count);
+    if (!samples || !sizes) {
+        free(samples);
+        free(sizes);
+        return 0;
+    }
+
+    size_t off = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(samples + off, inputs[i].data, inputs[i].size);
+        sizes[i] = inputs[i].size;
+        off += inputs[i].size;
+    }
+
+    size_t dict_size = ZDICT_trainFromBuffer(dict, DICT_CAPACITY, samples, sizes, (unsigned)count);
+    if (ZDICT_isError(dict_size)) {
+        // Too few samples for the trainer: fall back to a raw-content
+        // dictionary made of the corpus itself, which zstd accepts as-is
+        fprintf(stderr, "rpc-mkpack: dictionary training failed (%s), using raw content dictionary\n",
+                ZDICT_getErrorName(dict_size));
+        dict_size = total < DICT_CAPACITY ? total : DICT_CAPACITY;
+        memcpy(dict, samples + (total - dict_size), dict_size);
+    }
+
+    free(samples);
+    free(sizes);
+    return dict_size;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <output> <root> <file>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char root[PATH_MAX];
+    if (!realpath(argv[2], root)) {
+        perror(argv[2]);
+        return EXIT_FAILURE;
+    }
+    size_t root_len = strlen(root);
+
+    int count = argc - 3;
+    input_t *inputs = calloc((size_t)count, sizeof(input_t));
+    if (!inputs) return EXIT_FAILURE;
+
+    for (int i = 0; i < count; i++) {
+        char path[PATH_MAX];
+        if (!realpath(argv[i + 3], path)) {
+            perror(argv[i + 3]);
+            return EXIT_FAILURE;
+        }
+        if (strncmp(path, root, root_len) != 0 || path[root_len] != '/') {
+            fprintf(stderr, "rpc-mkpack: %s is outside %s\n", path, root);
+            return EXIT_FAILURE;
+        }
+        inputs[i].name = strdup(path + root_len);
+        if (read_whole_file(path, &inputs[i].data, &inputs[i].size) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    qsort(inputs, (size_t)count, sizeof(input_t), compare_inputs);
+
+    unsigned char dict[DICT_CAPACITY];
+    size_t dict_size = train_dictionary(inputs, count, dict);
+
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_CDict *cdict = ZSTD_createCDict(dict, dict_size, COMPRESSION_LEVEL);
+    if (!cctx || !cdict) {
+        fprintf(stderr, "rpc-mkpack: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t names_size = 0;
+    for (int i = 0; i < count; i++) {
+        size_t bound = ZSTD_compressBound(inputs[i].size);
+        inputs[i].frame = malloc(bound);
+        if (!inputs[i].frame) return EXIT_FAILURE;
+
+        size_t n = ZSTD_compress_usingCDict(cctx, inputs[i].frame, bound,
+                                            inputs[i].data, inputs[i].size, cdict);
+        if (ZSTD_isError(n)) {
+            fprintf(stderr, "rpc-mkpack: %s: %s\n", inputs[i].name, ZSTD_getErrorName(n));
+            return EXIT_FAILURE;
+        }
+        inputs[i].frame_size = n;
+        names_size += strlen(inputs[i].name) + 1;
+    }
+
+    size_t entries_off = PACK_HEADER_SIZE + dict_size;
+    size_t names_off = entries_off + (size_t)count * PACK_ENTRY_SIZE;
+    size_t frames_off = names_off + names_size;
+
+    FILE *out = fopen(argv[1], "wb");
+    if (!out) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned char header[PACK_HEADER_SIZE];
+    memcpy(header, PACK_MAGIC, 8);
+    put_u32(header + 8, PACK_VERSION);
+    put_u32(header + 12, (uint32_t)count);
+    put_u32(header + 16, (uint32_t)dict_size);
+    put_u32(header + 20, (uint32_t)names_size);
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(dict, 1, dict_size, out);
+
+    size_t name_cursor = 0;
+    size_t frame_cursor = frames_off;
+    for (int i = 0; i < count; i++) {
+        unsigned char entry[PACK_ENTRY_SIZE];
+        put_u32(entry, (uint32_t)name_cursor);
+        // Precomputed so rpc can skip the renderer for plain templates
+        uint32_t flags = PACK_F_NONE;
+        if (render_has_placeholders((const char *)inputs[i].data, inputs[i].size)) {
+            flags |= PACK_F_PLACEHOLDERS;
+        }
+        put_u32(entry + 4, flags);
+        put_u64(entry + 8, frame_cursor);
+        put_u64(entry + 16, inputs[i].frame_size);
+        put_u64(entry + 24, inputs[i].size);
+        fwrite(entry, 1, sizeof(entry), out);
+
+        name_cursor += strlen(inputs[i].name) + 1;
+        frame_cursor += inputs[i].frame_size;
+    }
+
+    for (int i = 0; i < count; i++) {
+        fwrite(inputs[i].name, 1, strlen(inputs[i].name) + 1, out);
+    }
+
+    size_t raw_total = 0;
+    for (int i = 0; i < count; i++) {
+        fwrite(inputs[i].frame, 1, inputs[i].frame_size, out);
+        raw_total += inputs[i].size;
+    }
+
+    if (ferror(out) || fclose(out) != 0) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("rpc-mkpack: %d templates, %zu bytes -> %zu bytes (dictionary %zu bytes)\n",
+           count, raw_total, frame_cursor, dict_size);
+
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeCCtx(cctx);
+    return EXIT_SUCCESS;
+}